@@ -3,6 +3,7 @@
 #include "UIManager.h"
 #include "DetectSIMD.h"
 #include "Script\CodaVM.h"
+#include "Script\MUP Implementation\CodaMUPExpressionParser.h"
 #include <Tools\VersionInfo.h>
 
 namespace bgsee
@@ -694,6 +695,11 @@ namespace bgsee
 
 		script::CodaScriptBackgrounder::RegisterINISettings(Params.INISettings);
 		script::CodaScriptExecutive::RegisterINISettings(Params.INISettings);
+		script::CodaScriptAsyncExecutive::RegisterINISettings(Params.INISettings);
+		script::CodaScriptCompiler::RegisterINISettings(Params.INISettings);
+		script::CodaScriptProgramImageCache::RegisterINISettings(Params.INISettings);
+		script::CodaScriptProgramCache::RegisterINISettings(Params.INISettings);
+		script::mup::CodaScriptMUPExpressionParser::RegisterINISettings(Params.INISettings);
 		Console::RegisterINISettings(Params.INISettings);
 		WindowColorThemer::RegisterINISettings(Params.INISettings);
 
@@ -96,7 +96,8 @@ namespace bgsee
 				(*Itr)->Accept(Visitor);
 		}
 
-		int						ICodaScriptExecutableCode::GIC = 0;
+		std::atomic<int>		ICodaScriptExecutableCode::GIC(0);
+		thread_local int		ICodaScriptExecutableCode::ThreadGIC = 0;
 
 		const char*				ICodaScriptExecutableCode::kTypeIDs[] =
 		{
@@ -114,11 +115,13 @@ namespace bgsee
 			Type(kCodeType_Default_INVALID), Line(0), Source(""), ByteCode(nullptr)
 		{
 			GIC++;
+			ThreadGIC++;
 		}
 
 		ICodaScriptExecutableCode::~ICodaScriptExecutableCode()
 		{
 			GIC--;
+			ThreadGIC--;
 			SME_ASSERT(GIC >= 0);
 
 			SAFEDELETE(ByteCode);
@@ -330,7 +333,7 @@ namespace bgsee
 		}
 
 		CodaScriptFOREACHBlock::CodaScriptFOREACHBlock(CodaScriptSourceCodeT& Source, UInt32 Line) :
-			ICodaScriptLoopBlock(), IteratorName("")
+			ICodaScriptLoopBlock(), IteratorName(""), IteratorSlot(-1)
 		{
 			this->Type = kCodeType_Loop_FOREACH;
 			this->Line = Line;
@@ -364,6 +367,11 @@ namespace bgsee
 			return IteratorName;
 		}
 
+		int CodaScriptFOREACHBlock::GetIteratorSlot() const
+		{
+			return IteratorSlot;
+		}
+
 		CodaScriptAbstractSyntaxTree::CodaScriptAbstractSyntaxTree(CodaScriptBEGINBlock* Root, ICodaScriptExecutableCode::ArrayT& VarIniters) :
 			VariableInitalizers(VarIniters),
 			Root(Root)
@@ -387,6 +395,11 @@ namespace bgsee
 			Root->Accept(Visitor);
 		}
 
+		CodaScriptBEGINBlock* CodaScriptAbstractSyntaxTree::GetRoot() const
+		{
+			return Root;
+		}
+
 		ICodaScriptSyntaxTreeEvaluator::ICodaScriptSyntaxTreeEvaluator(ICodaScriptVirtualMachine* VM,
 																	   ICodaScriptExpressionParser* Parser,
 																	   ICodaScriptExecutionContext* Context) :
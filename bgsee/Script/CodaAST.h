@@ -36,7 +36,8 @@ namespace bgsee
 			friend class CodaScriptSyntaxTreeCompileVisitor;
 
 			static const char*						kTypeIDs[];
-			static int								GIC;
+			static std::atomic<int>					GIC;
+			static thread_local int					ThreadGIC;		// instances created minus destroyed on the calling thread
 		protected:
 			UInt8									Type;
 
@@ -71,7 +72,7 @@ namespace bgsee
 			virtual const CodaScriptSourceCodeT&			GetSourceCode() const;
 			virtual ICodaScriptExpressionByteCode*			GetByteCode() const;
 
-			static const int&								GetGIC() { return GIC; }
+			static const int&								GetGIC() { return ThreadGIC; }		// per-thread, syntax trees can be built concurrently
 
 			typedef std::vector<ICodaScriptExecutableCode*>		ArrayT;
 			typedef std::stack<ICodaScriptExecutableCode*>		StackT;
@@ -177,6 +178,7 @@ namespace bgsee
 			friend class CodaScriptSyntaxTreeCompileVisitor;
 		protected:
 			CodaScriptSourceCodeT							IteratorName;
+			int												IteratorSlot;		// resolved by the compiler
 		public:
 			CodaScriptFOREACHBlock(CodaScriptSourceCodeT& Source, UInt32 Line);
 			inline virtual ~CodaScriptFOREACHBlock() = default;
@@ -184,6 +186,7 @@ namespace bgsee
 			virtual void									Accept(ICodaScriptSyntaxTreeVisitor* Visitor) override;
 
 			const CodaScriptSourceCodeT&					GetIteratorName() const;
+			int												GetIteratorSlot() const;
 		};
 
 		class CodaScriptAbstractSyntaxTree
@@ -195,6 +198,7 @@ namespace bgsee
 			~CodaScriptAbstractSyntaxTree();
 
 			void											Accept(ICodaScriptSyntaxTreeEvaluator* Visitor) noexcept;
+			CodaScriptBEGINBlock*							GetRoot() const;
 		};
 
 		class ICodaScriptSyntaxTreeVisitor
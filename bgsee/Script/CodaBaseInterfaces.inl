@@ -115,6 +115,8 @@ namespace bgsee
 														ICodaScriptSyntaxTreeEvaluator* ExecutionAgent,
 														ICodaScriptExpressionByteCode* ByteCode) = 0;
 																				// return false to skip result validation
+			virtual bool						IsThreadSafe(void) = 0;			// thread-safe commands don't touch editor or shared interpreter state
+																				// and can be called by scripts executing on worker threads
 
 			typedef std::vector<ICodaScriptCommand*>		ListT;
 		};
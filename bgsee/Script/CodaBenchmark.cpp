@@ -0,0 +1,1100 @@
+#include "CodaBenchmark.h"
+#include "CodaCompiler.h"
+#include "CodaVM.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		CodaScriptSyntheticScriptGenerator::Parameters::Parameters() :
+			Seed(0xC0DA),
+			Variables(16),
+			Statements(400),
+			MaxNesting(4),
+			ExpressionTerms(12),
+			CallMacros(true)
+		{
+			;//
+		}
+
+		CodaScriptSyntheticScriptGenerator::CodaScriptSyntheticScriptGenerator(const Parameters& Params) :
+			Params(Params),
+			Generator(Params.Seed),
+			Source(),
+			Lines(0)
+		{
+			;//
+		}
+
+		UInt32 CodaScriptSyntheticScriptGenerator::Random(UInt32 Bound)
+		{
+			return Generator() % Bound;
+		}
+
+		void CodaScriptSyntheticScriptGenerator::EmitLine(UInt32 Depth, const std::string& Code)
+		{
+			Source.append(Depth, '\t');
+			Source += Code;
+			Source += '\n';
+			Lines++;
+		}
+
+		std::string CodaScriptSyntheticScriptGenerator::Variable()
+		{
+			return "v" + std::to_string(Random(Params.Variables));
+		}
+
+		std::string CodaScriptSyntheticScriptGenerator::Expression(UInt32 Terms, bool AllowGrouping)
+		{
+			static const char* kOperators[] = { " + ", " - ", " * " };
+
+			std::string Out;
+			for (UInt32 i = 0; i < Terms; i++)
+			{
+				if (i)
+					Out += kOperators[Random(3)];
+
+				switch (Random(6))
+				{
+				case 0:
+					Out += std::to_string(Random(100));
+					break;
+				case 1:
+					if (AllowGrouping && Terms > 2)
+					{
+						Out += "(" + Expression(2 + Random(3), false) + ")";
+						break;
+					}
+				default:
+					Out += Variable();
+					break;
+				}
+			}
+
+			return Out;
+		}
+
+		std::string CodaScriptSyntheticScriptGenerator::Condition()
+		{
+			std::string Out(Expression(1 + Random(3)) + (Random(2) ? " < " : " > ") + Expression(1 + Random(3)));
+			if (Random(3) == 0)
+				Out += " && " + Variable() + " != 0";
+
+			return Out;
+		}
+
+		void CodaScriptSyntheticScriptGenerator::Statement(UInt32 Depth)
+		{
+			if (Params.CallMacros && Random(8) == 0)
+				EmitLine(Depth, Variable() + " = @benchmark.callee" + std::to_string(Random(4)) + "(" + Variable() + ", " + Expression(2) + ")");
+			else
+				EmitLine(Depth, Variable() + " = " + Expression(1 + Random(Params.ExpressionTerms)));
+		}
+
+		void CodaScriptSyntheticScriptGenerator::Block(UInt32 Depth, UInt32 Statements)
+		{
+			while (Statements)
+			{
+				Statements--;
+
+				UInt32 Nested = 0;
+				if (Depth < Params.MaxNesting && Statements)
+				{
+					Nested = 1 + Random(6);
+					if (Nested > Statements)
+						Nested = Statements;
+				}
+
+				std::string Counter(std::to_string(Depth));
+				switch (Nested ? Random(6) : 3)
+				{
+				case 0:
+					EmitLine(Depth, "if " + Condition());
+					Block(Depth + 1, Nested);
+					if (Random(2))
+					{
+						EmitLine(Depth, "elseif " + Condition());
+						Statement(Depth + 1);
+					}
+
+					if (Random(2))
+					{
+						EmitLine(Depth, "else");
+						Statement(Depth + 1);
+					}
+
+					EmitLine(Depth, "endif");
+					Statements -= Nested;
+					break;
+				case 1:
+					EmitLine(Depth, "w" + Counter + " = 0");
+					EmitLine(Depth, "while w" + Counter + " < 3");
+					Block(Depth + 1, Nested);
+					EmitLine(Depth + 1, "w" + Counter + " = w" + Counter + " + 1");
+					EmitLine(Depth, "loop");
+					Statements -= Nested;
+					break;
+				case 2:
+					EmitLine(Depth, "foreach e" + Counter + " <- ArCreate(" + std::to_string(Random(4)) + ")");
+					Block(Depth + 1, Nested);
+					EmitLine(Depth, "loop");
+					Statements -= Nested;
+					break;
+				default:
+					Statement(Depth);
+					break;
+				}
+			}
+		}
+
+		UInt32 CodaScriptSyntheticScriptGenerator::Generate(const char* Name, const Parameters& Params, std::string& OutSource)
+		{
+			SME_ASSERT(Params.Variables);
+
+			CodaScriptSyntheticScriptGenerator Generator(Params);
+			Generator.EmitLine(0, std::string("CODA(") + Name + ")");
+			Generator.EmitLine(0, "");
+
+			for (UInt32 i = 0; i < Params.Variables; i++)
+				Generator.EmitLine(0, "var v" + std::to_string(i) + " = " + std::to_string(i));
+
+			// loop counters and iterators, one of each per nesting level
+			for (UInt32 i = 0; i <= Params.MaxNesting; i++)
+			{
+				Generator.EmitLine(0, "var w" + std::to_string(i));
+				Generator.EmitLine(0, "var e" + std::to_string(i));
+			}
+
+			Generator.EmitLine(0, "");
+			Generator.EmitLine(0, "begin");
+			Generator.Block(1, Params.Statements);
+			Generator.EmitLine(0, "end");
+
+			OutSource.swap(Generator.Source);
+			return Generator.Lines;
+		}
+
+		std::atomic<size_t>							CodaScriptBenchmarks::PhaseProbe::Allocations(0);
+		std::atomic<size_t>							CodaScriptBenchmarks::PhaseProbe::AllocatedBytes(0);
+
+		int __cdecl CodaScriptBenchmarks::PhaseProbe::CountingAllocHook(int AllocType, void* UserData, size_t Size, int BlockType,
+																		 long RequestNumber, const unsigned char* Filename, int LineNumber)
+		{
+			if (AllocType != _HOOK_FREE && BlockType != _CRT_BLOCK)
+			{
+				Allocations++;
+				AllocatedBytes += Size;
+			}
+
+			return TRUE;
+		}
+
+		CodaScriptBenchmarks::PhaseProbe::PhaseProbe() :
+			Timer(),
+			PreviousHook(nullptr),
+			StartAllocations(0),
+			StartAllocatedBytes(0),
+			StartCommit(0),
+			StartPeakCommit(0),
+			Time(0),
+			HeapAllocations(0),
+			HeapBytes(0),
+			RetainedCommit(0),
+			PeakCommitGrowth(0),
+			PeakExact(false)
+		{
+			;//
+		}
+
+		void CodaScriptBenchmarks::PhaseProbe::Begin()
+		{
+			PROCESS_MEMORY_COUNTERS Counters = { 0 };
+			GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+
+			StartCommit = Counters.PagefileUsage;
+			StartPeakCommit = Counters.PeakPagefileUsage;
+			StartAllocations = Allocations;
+			StartAllocatedBytes = AllocatedBytes;
+
+			PreviousHook = _CrtSetAllocHook(CountingAllocHook);
+			Timer.Update();
+		}
+
+		void CodaScriptBenchmarks::PhaseProbe::End()
+		{
+			Timer.Update();
+			Time = Timer.GetTimePassed();
+			_CrtSetAllocHook(PreviousHook);
+
+			PROCESS_MEMORY_COUNTERS Counters = { 0 };
+			GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+
+			HeapAllocations = Allocations - StartAllocations;
+			HeapBytes = AllocatedBytes - StartAllocatedBytes;
+			RetainedCommit = static_cast<SSIZE_T>(Counters.PagefileUsage) - static_cast<SSIZE_T>(StartCommit);
+			PeakExact = Counters.PeakPagefileUsage > StartPeakCommit;
+			if (PeakExact)
+				PeakCommitGrowth = static_cast<SSIZE_T>(Counters.PeakPagefileUsage) - static_cast<SSIZE_T>(StartCommit);
+			else
+				PeakCommitGrowth = RetainedCommit > 0 ? RetainedCommit : 0;
+		}
+
+		void CodaScriptBenchmarks::PhaseProbe::Log(CodaScriptMessageHandler* MessageHandler, const char* Phase, UInt32 Lines) const
+		{
+			MessageHandler->Log("%-12s %10.3f ms %12.0f lines/s | %s%d KB peak, %d KB retained",
+								Phase, Time, Time > 0 ? Lines * 1000.0 / Time : 0.0,
+								PeakExact ? "" : ">=", PeakCommitGrowth / 1024, RetainedCommit / 1024);
+#ifdef _DEBUG
+			MessageHandler->Log("%-12s %10d allocations, %d KB", "", HeapAllocations, HeapBytes / 1024);
+#endif
+		}
+
+		const CodaScriptBenchmarks::SuiteInfo		CodaScriptBenchmarks::kSuites[] =
+		{
+			{ "keywords", "Classifies the first token of a synthetic corpus of script lines (scale = thousands of lines)", CodaScriptBenchmarks::KeywordClassification, 1000 },
+			{ "compiler", "Compiles a corpus of synthetic scripts, phase by phase (scale = number of scripts)", CodaScriptBenchmarks::CompilerThroughput, 100 },
+			{ "interpreter", "Executes the regression scripts and reports the cost of each operation (scale = thousands of iterations)", CodaScriptBenchmarks::InterpreterThroughput, 100 },
+			{ "concatenation", "Builds a string in a loop, copying and appending in place (scale = KB of output)", CodaScriptBenchmarks::StringConcatenation, 1024 },
+			{ "backgrounder", "Schedules background scripts against virtual and monotonic clocks, reports polling accuracy (scale = number of scripts)", CodaScriptBenchmarks::BackgroundScheduling, 1000 },
+			{ "concurrency", "Executes a single program on the main thread and the async workers at once, then as a batch, verifies the results against a serial run (scale = executions per pass)", CodaScriptBenchmarks::ConcurrentExecution, 256 },
+		};
+
+		const UInt32								CodaScriptBenchmarks::kPasses = 5;
+		const char*									CodaScriptBenchmarks::kScratchDirectory = "CodaBenchmark";
+
+		const CodaScriptBenchmarks::RegressionScript	CodaScriptBenchmarks::kRegressionScripts[] =
+		{
+			{
+				"Baseline", "loop iteration",
+				"CODA(Baseline)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"end\n"
+			},
+			{
+				"Expression", "arithmetic expression",
+				"CODA(Expression)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"var a = 3\n"
+				"var b = 7\n"
+				"var c = 0.5\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\tx = (a * 3 + b) / 2 - c * c + x * 0.5\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x)\n"
+				"end\n"
+			},
+			{
+				"Branch", "if/else",
+				"CODA(Branch)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\tif i > x\n"
+				"\t\t\tx = x + 2\n"
+				"\t\telse\n"
+				"\t\t\tx = x - 1\n"
+				"\t\tendif\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x)\n"
+				"end\n"
+			},
+			{
+				"Call", "script call",
+				"CODA(Call)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\tx = @CodaBenchmark.Callee(i)\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x)\n"
+				"end\n"
+			},
+			{
+				"Callee", nullptr,
+				"CODA(Callee)\n"
+				"var p = 0\n"
+				"begin p\n"
+				"\treturn(p + 1)\n"
+				"end\n"
+			},
+			{
+				"Array", "array append + size",
+				"CODA(Array)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"var arr = ArCreate(0)\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\tArAppend(arr, i)\n"
+				"\t\tx = x + ArSize(arr)\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x)\n"
+				"end\n"
+			},
+			{
+				"String", "string concatenation + length",
+				"CODA(String)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"var s = \"coda\"\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\tx = x + StrLen(s // \"benchmark\")\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x)\n"
+				"end\n"
+			},
+		};
+
+		// each iteration appends 16 characters, the scripts return the length of the final string
+		const CodaScriptBenchmarks::RegressionScript	CodaScriptBenchmarks::kConcatenationScripts[] =
+		{
+			{
+				"ConcatCopy", "s = \"\" // s // c",
+				"CODA(ConcatCopy)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var s = \"\"\n"
+				"var c = \"0123456789abcdef\"\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\ts = \"\" // s // c\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(StrLen(s))\n"
+				"end\n"
+			},
+			{
+				"ConcatVariable", "s = s // c",
+				"CODA(ConcatVariable)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var s = \"\"\n"
+				"var c = \"0123456789abcdef\"\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\ts = s // c\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(StrLen(s))\n"
+				"end\n"
+			},
+			{
+				"ConcatConstant", "s = s // \"...\"",
+				"CODA(ConcatConstant)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var s = \"\"\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\ts = s // \"0123456789abcdef\"\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(StrLen(s))\n"
+				"end\n"
+			},
+			{
+				"ConcatAssign", "s += c",
+				"CODA(ConcatAssign)\n"
+				"var n = 0\n"
+				"var i = 0\n"
+				"var s = \"\"\n"
+				"var c = \"0123456789abcdef\"\n"
+				"begin n\n"
+				"\twhile i < n\n"
+				"\t\ts += c\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(StrLen(s))\n"
+				"end\n"
+			},
+		};
+
+		const CodaScriptBenchmarks::RegressionScript	CodaScriptBenchmarks::kBackgroundScripts[] =
+		{
+			{
+				"Poll10", "10 ms",
+				"CODA(Poll10, \"0.01\")\n"
+				"var n = 0\n"
+				"begin\n"
+				"\tn = n + 1\n"
+				"end\n"
+			},
+			{
+				"Poll50", "50 ms",
+				"CODA(Poll50, \"0.05\")\n"
+				"var n = 0\n"
+				"begin\n"
+				"\tn = n + 1\n"
+				"end\n"
+			},
+			{
+				"Poll250", "250 ms",
+				"CODA(Poll250, \"0.25\")\n"
+				"var n = 0\n"
+				"begin\n"
+				"\tn = n + 1\n"
+				"end\n"
+			},
+			{
+				"Poll1000", "1000 ms",
+				"CODA(Poll1000, \"1\")\n"
+				"var n = 0\n"
+				"begin\n"
+				"\tn = n + 1\n"
+				"end\n"
+			},
+		};
+
+		const CodaScriptBenchmarks::RegressionScript	CodaScriptBenchmarks::kReentrantScripts[] =
+		{
+			{
+				"Reentrant", "arithmetic + string + array",
+				"CODA(Reentrant)\n"
+				"var p = 0\n"
+				"var i = 0\n"
+				"var x = 0\n"
+				"var s = \"\"\n"
+				"var arr = ArCreate(0)\n"
+				"begin p\n"
+				"\twhile i < 1000\n"
+				"\t\tx = x * 0.5 + p + i\n"
+				"\t\ts = s // \"c\"\n"
+				"\t\tArAppend(arr, x)\n"
+				"\t\ti = i + 1\n"
+				"\tloop\n"
+				"\treturn(x + StrLen(s) + ArSize(arr))\n"
+				"end\n"
+			},
+		};
+
+		bool CodaScriptBenchmarks::WriteScratchScripts(CodaScriptVM* VM, const RegressionScript* Scripts, UInt32 Count)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+
+			if (VM->GetExecutor()->IsBusy() || VM->GetBackgroundDaemon()->IsBackgrounding())
+			{
+				MessageHandler->Log("Cannot run the interpreter benchmarks while scripts are executing");
+				return false;
+			}
+
+			// the scripts are executed from disk so that calls between them resolve like they would for any other script
+			ResourceLocation Directory(VM->GetScriptRepository().GetRelativePath() + "\\" + kScratchDirectory);
+			if (CreateDirectory(Directory.GetFullPath().c_str(), nullptr) == FALSE && GetLastError() != ERROR_ALREADY_EXISTS)
+			{
+				MessageHandler->Log("Couldn't create scratch directory @ %s", Directory.GetFullPath().c_str());
+				return false;
+			}
+
+			for (UInt32 i = 0; i < Count; i++)
+			{
+				std::fstream Out((Directory.GetFullPath() + "\\" + Scripts[i].Name + VM->GetScriptFileExtension()).c_str(),
+								 std::iostream::out | std::iostream::trunc);
+				Out << Scripts[i].Source;
+			}
+
+			return true;
+		}
+
+		void CodaScriptBenchmarks::DeleteScratchScripts(CodaScriptVM* VM, const RegressionScript* Scripts, UInt32 Count)
+		{
+			CodaScriptProgramCache* Cache = dynamic_cast<CodaScriptProgramCache*>(VM->GetProgramCache());
+			ResourceLocation Directory(VM->GetScriptRepository().GetRelativePath() + "\\" + kScratchDirectory);
+			SME_ASSERT(Cache);
+
+			for (UInt32 i = 0; i < Count; i++)
+			{
+				ResourceLocation Path(Directory.GetRelativePath() + "\\" + Scripts[i].Name + VM->GetScriptFileExtension());
+
+				Cache->Remove(Path());
+				Cache->Stamps.erase(Path());
+				Cache->Images.Purge(Path);
+				DeleteFile(Path().c_str());
+			}
+
+			RemoveDirectory(Directory.GetFullPath().c_str());
+		}
+
+		bool CodaScriptBenchmarks::RunScratchScript(CodaScriptVM* VM, const RegressionScript& Script, CodaScriptNumericDataTypeT Parameter,
+													double& OutTime, CodaScriptNumericDataTypeT* OutResult)
+		{
+			ICodaScriptVirtualMachine::ExecuteParams Input;
+			ICodaScriptVirtualMachine::ExecuteResult Output;
+			CodaScriptElapsedTimeCounterT Timer;
+
+			Input.Filepath = std::string(kScratchDirectory) + "\\" + Script.Name;
+			Input.Parameters.push_back(CodaScriptBackingStore(Parameter));
+
+			Timer.Update();
+			VM->RunScript(Input, Output);
+			Timer.Update();
+
+			OutTime = Timer.GetTimePassed();
+			if (OutResult && Output.HasResult() && Output.Result->GetType() == ICodaScriptDataStore::kDataType_Numeric)
+				*OutResult = Output.Result->GetNumber();
+
+			return Output.Success;
+		}
+
+		void CodaScriptBenchmarks::DriveBackgrounder(CodaScriptVM* VM, const std::vector<ICodaScriptProgram*>& Programs, UInt32 Scripts,
+													 ICodaScriptTickSource* TickSource, const std::function<UInt32()>& Driver, double Duration)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			CodaScriptBackgrounder* Daemon = dynamic_cast<CodaScriptBackgrounder*>(VM->GetBackgroundDaemon());
+			SME_ASSERT(Daemon);
+
+			// a private backgrounder keeps the simulated scripts apart from the user's
+			CodaScriptBackgrounder Simulation(VM, Daemon->SourceDepot, Daemon->INISettingGetter, Daemon->INISettingSetter, TickSource);
+			bool Enabled = Simulation.IsEnabled();
+			std::vector<ICodaScriptExecutionContext*> Contexts;
+
+			Simulation.Resume();
+			for (UInt32 i = 0; i < Scripts; i++)
+			{
+				Contexts.push_back(new CodaScriptExecutionContext(VM, Programs[i % Programs.size()]));
+				Simulation.Queue(Contexts.back());
+			}
+
+			CodaScriptElapsedTimeCounterT Timer;
+			UInt32 Ticks = 0;
+
+			// output is collected rather than logged, the scripts don't print anything unless they fail
+			CodaScriptMessageHandler::Transcript Diagnostics;
+			MessageHandler->BeginTranscript(&Diagnostics);
+
+			Simulation.ResetTimer(true);
+			Timer.Update();
+			Ticks = Driver();
+			Timer.Update();
+			Simulation.ResetTimer();
+
+			MessageHandler->EndTranscript();
+
+			double WallTime = Timer.GetTimePassed();
+			UInt32 UpdatePeriod = CodaScriptBackgrounder::kINI_UpdatePeriod().i;
+			UInt32 Halted = 0;
+
+			MessageHandler->Log("%d ticks in %.3f ms (%d expected), %.3f ms/tick, %.2f ns per script per tick",
+								Ticks, WallTime, UpdatePeriod ? (UInt32)(Duration / UpdatePeriod) : 0,
+								Ticks ? WallTime / Ticks : 0.0, Ticks ? WallTime * 1000000.0 / Ticks / Scripts : 0.0);
+
+			for (UInt32 i = 0; i < Programs.size(); i++)
+			{
+				double Interval = Programs[i]->GetPollingInteval() * 1000.0;
+				UInt32 Count = 0, Executions = 0;
+
+				for (UInt32 j = i; j < Contexts.size(); j += Programs.size())
+				{
+					// halted scripts have already been released by the backgrounder
+					if (Simulation.IsContextBackgrounding(Contexts[j]) == false)
+					{
+						Halted++;
+						continue;
+					}
+
+					CodaScriptVariable* Counter = Contexts[j]->GetVariable("n");
+					SME_ASSERT(Counter);
+
+					Count++;
+					Executions += (UInt32)Counter->GetStoreOwner()->GetDataStore()->GetNumber();
+				}
+
+				UInt32 Expected = Interval > 0 ? Count * (UInt32)(Duration / Interval) : 0;
+				MessageHandler->Log("%-16s %6d scripts %10d runs (%10d expected) %10.3f ms effective interval",
+									Programs[i]->GetName().c_str(), Count, Executions, Expected,
+									Executions ? Duration * Count / Executions : 0.0);
+			}
+
+			if (Halted)
+			{
+				MessageHandler->Log("%d scripts halted, diagnostics:", Halted);
+				MessageHandler->Indent();
+				MessageHandler->Replay(Diagnostics);
+				MessageHandler->Outdent();
+			}
+
+			if (Enabled == false)
+				Simulation.Suspend();
+		}
+
+		void CodaScriptBenchmarks::KeywordClassification(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			const UInt32 LineCount = Scale * 1000;
+
+			// the reference implementation, a linear case-insensitive scan over the keyword names
+			auto LinearLookup = [](const CodaScriptSourceCodeT& Token) -> CodaScriptKeywordT
+			{
+				for (CodaScriptKeywordT i = CodaScriptTokenizer::kTokenType_Variable; i <= CodaScriptTokenizer::kTokenType_Break; i <<= 1)
+				{
+					if (!_stricmp(Token.c_str(), CodaScriptTokenizer::GetKeywordName(i).c_str()))
+						return i;
+				}
+
+				return CodaScriptTokenizer::kTokenType_Invalid;
+			};
+
+			// roughly mirrors the makeup of real scripts, where most lines open with an identifier
+			static const char* kIdentifiers[] =
+			{
+				"Counter", "i", "RefList", "SetBaseForm", "Result", "x", "EditorID", "ArrayIndex", "Begin2", "Var_",
+				"Endless", "Iffy", "Elsewhere", "Loopback", "ReturnValue", "Breaker", "Caller", "Continued", "Coda_Helper", "WhileLoopCounter"
+			};
+
+			std::mt19937 Generator(0xC0DA);
+			std::vector<CodaScriptSourceCodeT> Corpus;
+			Corpus.reserve(LineCount);
+
+			for (UInt32 i = 0; i < LineCount; i++)
+			{
+				CodaScriptSourceCodeT Token;
+				if (Generator() % 5 < 2)
+				{
+					CodaScriptKeywordT Keyword = 1 << (1 + Generator() % 15);
+					Token = CodaScriptTokenizer::GetKeywordName(Keyword);
+				}
+				else
+					Token = kIdentifiers[Generator() % (sizeof(kIdentifiers) / sizeof(kIdentifiers[0]))];
+
+				for (auto& Itr : Token)
+				{
+					if (Generator() % 2)
+						Itr = tolower(Itr);
+				}
+
+				Corpus.push_back(Token);
+			}
+
+			UInt32 Mismatches = 0;
+			for (auto& Itr : Corpus)
+			{
+				if (LinearLookup(Itr) != CodaScriptTokenizer::GetKeywordType(Itr.c_str(), Itr.length()))
+					Mismatches++;
+			}
+
+			CodaScriptElapsedTimeCounterT Timer;
+			double BestLinear = -1, BestHashed = -1;
+			UInt32 Checksum = 0;
+
+			for (UInt32 i = 0; i < kPasses; i++)
+			{
+				Timer.Update();
+				for (auto& Itr : Corpus)
+					Checksum += LinearLookup(Itr);
+				Timer.Update();
+
+				if (BestLinear < 0 || Timer.GetTimePassed() < BestLinear)
+					BestLinear = Timer.GetTimePassed();
+
+				Timer.Update();
+				for (auto& Itr : Corpus)
+					Checksum += CodaScriptTokenizer::GetKeywordType(Itr.c_str(), Itr.length());
+				Timer.Update();
+
+				if (BestHashed < 0 || Timer.GetTimePassed() < BestHashed)
+					BestHashed = Timer.GetTimePassed();
+			}
+
+			MessageHandler->Log("Corpus: %d lines, %d mismatches, checksum %08X", LineCount, Mismatches, Checksum);
+			MessageHandler->Log("Linear scan: %.3f ms (%.2f ns/line)", BestLinear, BestLinear * 1000000.0 / LineCount);
+			MessageHandler->Log("Perfect hash: %.3f ms (%.2f ns/line)", BestHashed, BestHashed * 1000000.0 / LineCount);
+			if (BestHashed > 0)
+				MessageHandler->Log("Speedup: %.2fx", BestLinear / BestHashed);
+		}
+
+		void CodaScriptBenchmarks::CompilerThroughput(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			CodaScriptCompiler& Compiler = CodaScriptCompiler::Instance;
+			ResourceLocation Filepath(VM->GetScriptRepository().GetRelativePath() + "\\benchmark" + VM->GetScriptFileExtension());
+
+			std::vector<std::string> Sources(Scale);
+			UInt32 LineCount = 0;
+			for (UInt32 i = 0; i < Scale; i++)
+			{
+				CodaScriptSyntheticScriptGenerator::Parameters Params;
+				Params.Seed += i;
+
+				LineCount += CodaScriptSyntheticScriptGenerator::Generate(("Benchmark" + std::to_string(i)).c_str(), Params, Sources[i]);
+			}
+
+			PhaseProbe Tokenize, Preprocess, FrontEnd, BackEnd;
+			std::vector<CodaScriptCompiler::SourceData> Preprocessed(Scale);
+			std::vector<std::unique_ptr<CodaScriptProgram>> Programs;
+			CodaScriptMessageHandler::Transcript Diagnostics;
+			UInt32 TokenCount = 0;
+
+			Tokenize.Begin();
+			{
+				CodaScriptTokenizer Tokenizer;
+				for (auto& Itr : Sources)
+				{
+					const char* Current = Itr.c_str();
+					const char* End = Current + Itr.length();
+
+					while (Current < End)
+					{
+						const char* LineEnd = static_cast<const char*>(memchr(Current, '\n', End - Current));
+						if (LineEnd == nullptr)
+							LineEnd = End;
+
+						if (Tokenizer.Tokenize(Current, LineEnd - Current, false, true))
+							TokenCount += Tokenizer.Views.size();
+
+						Current = LineEnd + 1;
+					}
+				}
+			}
+			Tokenize.End();
+
+			Preprocess.Begin();
+			for (UInt32 i = 0; i < Scale; i++)
+				Compiler.Preprocess(Sources[i].c_str(), Sources[i].length(), Preprocessed[i]);
+			Preprocess.End();
+
+			// diagnostics are collected rather than logged, so that they don't skew the timings
+			MessageHandler->BeginTranscript(&Diagnostics);
+
+			FrontEnd.Begin();
+			for (UInt32 i = 0; i < Scale; i++)
+			{
+				Programs.push_back(std::unique_ptr<CodaScriptProgram>(new CodaScriptProgram(VM, Filepath)));
+				Compiler.GenerateProgram(VM, Programs.back().get(), Preprocessed[i]);
+			}
+			FrontEnd.End();
+
+			BackEnd.Begin();
+			for (auto& Itr : Programs)
+				Compiler.GenerateByteCode(VM, Itr.get());
+			BackEnd.End();
+
+			MessageHandler->EndTranscript();
+
+			UInt32 Failed = 0;
+			for (auto& Itr : Programs)
+			{
+				if (Itr->IsValid() == false)
+					Failed++;
+			}
+
+			MessageHandler->Log("Corpus: %d scripts, %d lines, %d tokens, %d failed to compile", Scale, LineCount, TokenCount, Failed);
+			Tokenize.Log(MessageHandler, "Tokenizer", LineCount);
+			Preprocess.Log(MessageHandler, "Preprocessor", LineCount);
+			FrontEnd.Log(MessageHandler, "Front end", LineCount);
+			BackEnd.Log(MessageHandler, "Back end", LineCount);
+
+			if (Failed)
+			{
+				MessageHandler->Log("Diagnostics:");
+				MessageHandler->Indent();
+				MessageHandler->Replay(Diagnostics);
+				MessageHandler->Outdent();
+			}
+		}
+
+		void CodaScriptBenchmarks::InterpreterThroughput(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			const UInt32 ScriptCount = sizeof(kRegressionScripts) / sizeof(kRegressionScripts[0]);
+			const UInt32 Iterations = Scale * 1000;
+
+			if (WriteScratchScripts(VM, kRegressionScripts, ScriptCount) == false)
+				return;
+
+			double Baseline = -1;
+			for (auto& Itr : kRegressionScripts)
+			{
+				if (Itr.Operation == nullptr)
+					continue;
+
+				double Best = -1, Time = 0;
+				bool Failed = false;
+
+				// the first run compiles the script (and its callees) and is discarded
+				for (UInt32 i = 0; i <= kPasses && Failed == false; i++)
+				{
+					if (RunScratchScript(VM, Itr, Iterations, Time) == false)
+						Failed = true;
+					else if (i && (Best < 0 || Time < Best))
+						Best = Time;
+				}
+
+				if (Failed)
+					MessageHandler->Log("%-32s failed to execute", Itr.Operation);
+				else if (Baseline < 0)
+				{
+					Baseline = Best;
+					MessageHandler->Log("%-32s %10.3f ms %10.2f ns/op", Itr.Operation, Best, Best * 1000000.0 / Iterations);
+				}
+				else
+					MessageHandler->Log("%-32s %10.3f ms %10.2f ns/op", Itr.Operation, Best, (Best - Baseline) * 1000000.0 / Iterations);
+			}
+
+			DeleteScratchScripts(VM, kRegressionScripts, ScriptCount);
+
+			MessageHandler->Log("%d iterations per script, costs are net of the loop iteration", Iterations);
+		}
+
+		void CodaScriptBenchmarks::StringConcatenation(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			const UInt32 ScriptCount = sizeof(kConcatenationScripts) / sizeof(kConcatenationScripts[0]);
+			const UInt32 Iterations = Scale * 1024 / 16;
+
+			if (WriteScratchScripts(VM, kConcatenationScripts, ScriptCount) == false)
+				return;
+
+			double Copying = -1;
+			for (auto& Itr : kConcatenationScripts)
+			{
+				double Best = -1, Time = 0;
+				CodaScriptNumericDataTypeT Length = 0;
+
+				// compile with an empty loop, the copying variant is quadratic and is only timed once
+				bool Failed = RunScratchScript(VM, Itr, 0, Time) == false;
+				UInt32 Passes = Copying < 0 ? 1 : kPasses;
+
+				for (UInt32 i = 0; i < Passes && Failed == false; i++)
+				{
+					if (RunScratchScript(VM, Itr, Iterations, Time, &Length) == false || Length != Iterations * 16)
+						Failed = true;
+					else if (Best < 0 || Time < Best)
+						Best = Time;
+				}
+
+				if (Failed)
+					MessageHandler->Log("%-32s failed to execute", Itr.Operation);
+				else if (Copying < 0)
+				{
+					Copying = Best;
+					MessageHandler->Log("%-32s %10.3f ms", Itr.Operation, Best);
+				}
+				else
+					MessageHandler->Log("%-32s %10.3f ms %8.2fx", Itr.Operation, Best, Best > 0 ? Copying / Best : 0.0);
+			}
+
+			DeleteScratchScripts(VM, kConcatenationScripts, ScriptCount);
+
+			MessageHandler->Log("%d appends of 16 characters per script, speedups are relative to the copying concatenation", Iterations);
+		}
+
+		void CodaScriptBenchmarks::BackgroundScheduling(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			const UInt32 ScriptCount = sizeof(kBackgroundScripts) / sizeof(kBackgroundScripts[0]);
+			const double VirtualDuration = 10000.0, RealDuration = 1000.0;
+
+			if (WriteScratchScripts(VM, kBackgroundScripts, ScriptCount) == false)
+				return;
+
+			std::vector<ICodaScriptProgram*> Programs;
+			for (auto& Itr : kBackgroundScripts)
+			{
+				ResourceLocation Path(VM->GetScriptRepository().GetRelativePath() + "\\" + kScratchDirectory + "\\" + Itr.Name + VM->GetScriptFileExtension());
+				ICodaScriptProgram* Program = VM->GetProgramCache()->Get(Path);
+				if (Program == nullptr)
+				{
+					MessageHandler->Log("%-32s failed to compile", Itr.Name);
+					break;
+				}
+
+				Programs.push_back(Program);
+			}
+
+			if (Programs.size() == ScriptCount)
+			{
+				// the virtual clock only measures the cost of the scheduler and the scripts, ticks are never late
+				MessageHandler->Log("Virtual clock, %.0f ms:", VirtualDuration);
+				MessageHandler->Indent();
+				{
+					CodaScriptVirtualTickSource* TickSource = new CodaScriptVirtualTickSource();
+					DriveBackgrounder(VM, Programs, Scale, TickSource, [TickSource, VirtualDuration]() { return TickSource->Advance(VirtualDuration); }, VirtualDuration);
+				}
+				MessageHandler->Outdent();
+
+				MessageHandler->Log("Monotonic clock, %.0f ms:", RealDuration);
+				MessageHandler->Indent();
+				{
+					CodaScriptMonotonicTickSource* TickSource = new CodaScriptMonotonicTickSource();
+					DriveBackgrounder(VM, Programs, Scale, TickSource, [TickSource, RealDuration]() { return TickSource->Run(RealDuration); }, RealDuration);
+				}
+				MessageHandler->Outdent();
+			}
+
+			DeleteScratchScripts(VM, kBackgroundScripts, ScriptCount);
+
+			MessageHandler->Log("%d scripts, %d ms update period, %d ms budget per update",
+								Scale, CodaScriptBackgrounder::kINI_UpdatePeriod().i, CodaScriptBackgrounder::kINI_TickBudget().i);
+		}
+
+		void CodaScriptBenchmarks::ConcurrentExecution(CodaScriptVM* VM, UInt32 Scale)
+		{
+			CodaScriptMessageHandler* MessageHandler = VM->GetMessageHandler();
+			const UInt32 ScriptCount = sizeof(kReentrantScripts) / sizeof(kReentrantScripts[0]);
+			const RegressionScript& Script = kReentrantScripts[0];
+
+			if (WriteScratchScripts(VM, kReentrantScripts, ScriptCount) == false)
+				return;
+
+			ResourceLocation Path(VM->GetScriptRepository().GetRelativePath() + "\\" + kScratchDirectory + "\\" + Script.Name + VM->GetScriptFileExtension());
+			ICodaScriptProgram* Program = VM->GetProgramCache()->Get(Path);
+			std::vector<CodaScriptNumericDataTypeT> Expected(Scale, 0);
+			double Serial = 0, Concurrent = -1, Batched = -1, Time = 0;
+			UInt32 Failures = 0, Mismatches = 0;
+
+			auto Verify = [&Expected, &Failures, &Mismatches](const ICodaScriptVirtualMachine::ExecuteResult& Output, UInt32 Index) {
+				if (Output.Success == false)
+					Failures++;
+				else if (Output.HasResult() == false || Output.Result->GetType() != ICodaScriptDataStore::kDataType_Numeric ||
+						 Output.Result->GetNumber() != Expected[Index])
+				{
+					Mismatches++;
+				}
+			};
+
+			if (Program == nullptr || Program->IsValid() == false)
+				MessageHandler->Log("%-32s failed to compile", Script.Name);
+			else if (Program->IsThreadSafe() == false)
+				MessageHandler->Log("%-32s isn't thread-safe - %s", Script.Name, Program->GetCompilerMetadata()->GetThreadSafetyViolation());
+			else
+			{
+				// the serial results are the reference for the concurrent executions
+				for (UInt32 i = 0; i < Scale; i++)
+				{
+					if (RunScratchScript(VM, Script, i, Time, &Expected[i]) == false)
+						Failures++;
+
+					Serial += Time;
+				}
+
+				CodaScriptElapsedTimeCounterT Timer;
+				for (UInt32 Pass = 0; Pass < kPasses && Failures == 0; Pass++)
+				{
+					std::vector<ICodaScriptAsyncResult::PtrT> Results(Scale);
+
+					Timer.Update();
+					for (UInt32 i = 0; i < Scale; i++)
+					{
+						ICodaScriptVirtualMachine::ExecuteParams Input;
+						Input.Program = Program;
+						Input.Parameters.push_back(CodaScriptBackingStore((CodaScriptNumericDataTypeT)i));
+
+						Results[i] = VM->RunScriptAsync(Input);
+						if (Results[i] == nullptr)
+							Failures++;
+					}
+
+					// the main thread evaluates the same program while the workers are still busy with it, in the opposite order
+					// so that the executions overlap for as long as possible
+					for (UInt32 i = Scale; i > 0; i--)
+					{
+						CodaScriptNumericDataTypeT Result = 0;
+						if (RunScratchScript(VM, Script, i - 1, Time, &Result) == false)
+							Failures++;
+						else if (Result != Expected[i - 1])
+							Mismatches++;
+					}
+
+					for (auto& Itr : Results)
+					{
+						if (Itr)
+							Itr->Wait();
+					}
+					Timer.Update();
+
+					if (Concurrent < 0 || Timer.GetTimePassed() < Concurrent)
+						Concurrent = Timer.GetTimePassed();
+
+					for (UInt32 i = 0; i < Scale; i++)
+					{
+						if (Results[i])
+							Verify(Results[i]->Get(), i);
+					}
+				}
+
+				// the batch executes the inputs with one context per worker thread
+				ICodaScriptVirtualMachine::BatchParameterArrayT Inputs(Scale);
+				for (UInt32 i = 0; i < Scale; i++)
+					Inputs[i].push_back(CodaScriptBackingStore((CodaScriptNumericDataTypeT)i));
+
+				for (UInt32 Pass = 0; Pass < kPasses && Failures == 0; Pass++)
+				{
+					ICodaScriptVirtualMachine::BatchResultArrayT Outputs;
+
+					Timer.Update();
+					VM->RunBatch(Program, Inputs, Outputs);
+					Timer.Update();
+
+					if (Batched < 0 || Timer.GetTimePassed() < Batched)
+						Batched = Timer.GetTimePassed();
+
+					for (UInt32 i = 0; i < Scale; i++)
+						Verify(Outputs[i], i);
+				}
+
+				if (Failures)
+					MessageHandler->Log("%d executions failed", Failures);
+				else
+				{
+					// every pass executes the workload twice, once on the main thread and once on the workers
+					MessageHandler->Log("%-32s %10.3f ms", "serial", Serial);
+					MessageHandler->Log("%-32s %10.3f ms %8.2fx", "concurrent", Concurrent, Concurrent > 0 ? Serial * 2 / Concurrent : 0.0);
+					MessageHandler->Log("%-32s %10.3f ms %8.2fx", "batch", Batched, Batched > 0 ? Serial / Batched : 0.0);
+					MessageHandler->Log("%d mismatched results", Mismatches);
+				}
+			}
+
+			DeleteScratchScripts(VM, kReentrantScripts, ScriptCount);
+
+			MessageHandler->Log("%d executions per pass, %d passes. the concurrent pass executes each input on the main thread and a worker thread", Scale, kPasses);
+		}
+
+		void CodaScriptBenchmarks::ListSuites(CodaScriptVM* VM)
+		{
+			VM->GetMessageHandler()->Log("Available benchmark suites:");
+			VM->GetMessageHandler()->Indent();
+
+			for (auto& Itr : kSuites)
+				VM->GetMessageHandler()->Log("%s - %s", Itr.Name, Itr.Description);
+
+			VM->GetMessageHandler()->Outdent();
+		}
+
+		bool CodaScriptBenchmarks::Run(CodaScriptVM* VM, const char* Suite, UInt32 Scale)
+		{
+			for (auto& Itr : kSuites)
+			{
+				if (_stricmp(Itr.Name, Suite))
+					continue;
+
+				VM->GetMessageHandler()->Log("Running benchmark suite '%s'...", Itr.Name);
+				VM->GetMessageHandler()->Indent();
+				Itr.Handler(VM, Scale ? Scale : Itr.DefaultScale);
+				VM->GetMessageHandler()->Outdent();
+
+				return true;
+			}
+
+			return false;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "CodaUtilities.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		class CodaScriptVM;
+		class ICodaScriptProgram;
+		class ICodaScriptTickSource;
+
+		// deterministic generator of well-formed scripts, identical parameters always produce identical source
+		// loops are bounded by dedicated counters, so the output is safe to execute as well as compile
+		class CodaScriptSyntheticScriptGenerator
+		{
+		public:
+			struct Parameters
+			{
+				UInt32					Seed;
+				UInt32					Variables;
+				UInt32					Statements;			// inside the Begin block, nested statements included
+				UInt32					MaxNesting;
+				UInt32					ExpressionTerms;	// upper bound on the operands of an expression
+				bool					CallMacros;			// emit @ call macros, which reference scripts that don't exist
+
+				Parameters();
+			};
+		private:
+			const Parameters&			Params;
+			std::mt19937				Generator;
+			std::string					Source;
+			UInt32						Lines;
+
+			CodaScriptSyntheticScriptGenerator(const Parameters& Params);
+
+			UInt32						Random(UInt32 Bound);
+			void						EmitLine(UInt32 Depth, const std::string& Code);
+			std::string					Variable();
+			std::string					Expression(UInt32 Terms, bool AllowGrouping = true);
+			std::string					Condition();
+			void						Statement(UInt32 Depth);
+			void						Block(UInt32 Depth, UInt32 Statements);
+		public:
+			static UInt32				Generate(const char* Name, const Parameters& Params, std::string& OutSource);		// returns the line count
+		};
+
+		// synthetic workloads that time the hot paths of the script compiler and interpreter
+		// invoked through the CodaBenchmark console command
+		class CodaScriptBenchmarks
+		{
+			typedef void (*SuiteHandlerT)(CodaScriptVM* VM, UInt32 Scale);
+
+			struct SuiteInfo
+			{
+				const char*				Name;
+				const char*				Description;
+				SuiteHandlerT			Handler;
+				UInt32					DefaultScale;
+			};
+
+			// samples the time, heap traffic and memory consumption of a stretch of code
+			// allocations are only counted when running against the debug CRT
+			class PhaseProbe
+			{
+				static std::atomic<size_t>		Allocations;
+				static std::atomic<size_t>		AllocatedBytes;
+
+				static int __cdecl				CountingAllocHook(int AllocType, void* UserData, size_t Size, int BlockType,
+																  long RequestNumber, const unsigned char* Filename, int LineNumber);
+
+				CodaScriptElapsedTimeCounterT	Timer;
+				_CRT_ALLOC_HOOK					PreviousHook;
+				size_t							StartAllocations;
+				size_t							StartAllocatedBytes;
+				SIZE_T							StartCommit;
+				SIZE_T							StartPeakCommit;
+			public:
+				double							Time;				// in ms
+				size_t							HeapAllocations;
+				size_t							HeapBytes;
+				SSIZE_T							RetainedCommit;
+				SSIZE_T							PeakCommitGrowth;
+				bool							PeakExact;			// false if the process peak predates the phase, in which case the growth is a lower bound
+
+				PhaseProbe();
+
+				void							Begin();
+				void							End();
+				void							Log(CodaScriptMessageHandler* MessageHandler, const char* Phase, UInt32 Lines) const;
+			};
+
+			// fixed scripts that each isolate an operation inside a loop, timed against a loop with an empty body
+			struct RegressionScript
+			{
+				const char*				Name;
+				const char*				Operation;			// nullptr for helper scripts that aren't timed
+				const char*				Source;				// the iteration count is passed as the first parameter
+			};
+
+			static const SuiteInfo			kSuites[];
+			static const UInt32				kPasses;			// best-of-n timing
+			static const RegressionScript	kRegressionScripts[];
+			static const RegressionScript	kConcatenationScripts[];
+			static const RegressionScript	kBackgroundScripts[];		// one per polling interval
+			static const RegressionScript	kReentrantScripts[];		// thread-safe, the result only depends on the parameter
+			static const char*				kScratchDirectory;	// relative to the script repository
+
+			static bool					WriteScratchScripts(CodaScriptVM* VM, const RegressionScript* Scripts, UInt32 Count);		// returns false if the scripts can't be run
+			static void					DeleteScratchScripts(CodaScriptVM* VM, const RegressionScript* Scripts, UInt32 Count);
+			static bool					RunScratchScript(CodaScriptVM* VM, const RegressionScript& Script, CodaScriptNumericDataTypeT Parameter,
+														 double& OutTime, CodaScriptNumericDataTypeT* OutResult = nullptr);		// returns false if the script failed
+			static void					DriveBackgrounder(CodaScriptVM* VM, const std::vector<ICodaScriptProgram*>& Programs, UInt32 Scripts,
+														  ICodaScriptTickSource* TickSource, const std::function<UInt32()>& Driver, double Duration);	// takes ownership of the tick source
+
+			static void					KeywordClassification(CodaScriptVM* VM, UInt32 Scale);
+			static void					CompilerThroughput(CodaScriptVM* VM, UInt32 Scale);
+			static void					InterpreterThroughput(CodaScriptVM* VM, UInt32 Scale);
+			static void					StringConcatenation(CodaScriptVM* VM, UInt32 Scale);
+			static void					BackgroundScheduling(CodaScriptVM* VM, UInt32 Scale);
+			static void					ConcurrentExecution(CodaScriptVM* VM, UInt32 Scale);
+		public:
+			static void					ListSuites(CodaScriptVM* VM);
+			static bool					Run(CodaScriptVM* VM, const char* Suite, UInt32 Scale = 0);		// a scale of zero selects the suite's default
+		};
+	}
+}
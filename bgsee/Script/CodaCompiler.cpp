@@ -32,7 +32,7 @@ namespace bgsee
 		{
 			if (GetVariable(Name) == nullptr)
 			{
-				VariableInfo Addend(Name, Initalizer, Line);
+				VariableInfo Addend(Name, Initalizer, Line, Variables.size());
 				Variables.push_back(Addend);
 			}
 		}
@@ -77,10 +77,12 @@ namespace bgsee
 			Parameters(),
 			PollingInterval(0.0),
 			AST(),
-			Flags(NULL),
+			Flags(0),
 			VM(VM),
 			Parser(nullptr),
-			Metadata()
+			Metadata(),
+			Dependencies(),
+			ContextPool()
 		{
 			SME_ASSERT(VM);
 
@@ -90,6 +92,7 @@ namespace bgsee
 
 		CodaScriptProgram::~CodaScriptProgram()
 		{
+			ContextPool.clear();
 			Parser->DeregisterProgram(this);
 
 			SME_ASSERT(VM->IsProgramExecuting(this) == false);
@@ -97,16 +100,22 @@ namespace bgsee
 
 		bool CodaScriptProgram::IsValid() const
 		{
-			if (Flags & kFlag_Uncompiled)
+			UInt8 Current = Flags;
+			if (Current & kFlag_Uncompiled)
 				return false;
-			else if (Flags & kFlag_CompileError)
+			else if (Current & kFlag_CompileError)
 				return false;
-			else if (Flags & kFlag_InvalidBytecode)
+			else if (Current & kFlag_InvalidBytecode)
 				return false;
 			else
 				return true;
 		}
 
+		bool CodaScriptProgram::IsThreadSafe() const
+		{
+			return IsValid() && Metadata && Metadata->GetThreadSafetyViolation() == nullptr;
+		}
+
 		void CodaScriptProgram::InvalidateBytecode()
 		{
 			Flags |= kFlag_InvalidBytecode;
@@ -123,6 +132,34 @@ namespace bgsee
 			return Filepath;
 		}
 
+		ICodaScriptExecutionContext* CodaScriptProgram::AcquireContext()
+		{
+			if (ContextPool.empty())
+				return nullptr;
+
+			ICodaScriptExecutionContext* Out = ContextPool.back().release();
+			ContextPool.pop_back();
+			return Out;
+		}
+
+		void CodaScriptProgram::ReleaseContext(ICodaScriptExecutionContext* Context)
+		{
+			SME_ASSERT(Context && Context->GetProgram() == this);
+
+			std::unique_ptr<ICodaScriptExecutionContext> Released(Context);
+			if (ContextPool.size() >= kMaxPooledContexts)
+				return;
+
+			// contexts are reset on release, so that pooled contexts don't hold on to the values of their variables
+			Released->ResetState(true);
+			ContextPool.push_back(std::move(Released));
+		}
+
+		const CodaScriptProgram::DependencyArrayT& CodaScriptProgram::GetDependencies() const
+		{
+			return Dependencies;
+		}
+
 		const CodaScriptSourceCodeT& CodaScriptProgram::GetName() const
 		{
 			return Name;
@@ -149,6 +186,15 @@ namespace bgsee
 			return GetVariable(Name) != nullptr;
 		}
 
+		int CodaScriptProgram::GetVariableSlot(const CodaScriptSourceCodeT& Name) const
+		{
+			const VariableInfo* Var = GetVariable(Name);
+			if (Var == nullptr)
+				return -1;
+			else
+				return Var->Slot;
+		}
+
 		const CodaScriptVariableNameArrayT& CodaScriptProgram::GetParameters(CodaScriptVariableNameArrayT& OutNames) const
 		{
 			OutNames.clear();
@@ -165,6 +211,14 @@ namespace bgsee
 			return Parameters.size();
 		}
 
+		int CodaScriptProgram::GetParameterSlot(UInt32 Index) const
+		{
+			if (Index >= Parameters.size())
+				return -1;
+			else
+				return Parameters[Index].BoundVariable->Slot;
+		}
+
 		double CodaScriptProgram::GetPollingInteval() const
 		{
 			return PollingInterval;
@@ -260,7 +314,8 @@ namespace bgsee
 
 			if (Node->IteratorName.empty())
 				throw CodaScriptException(Node, "Invalid expression - No iterator specified");
-			else if (GetProgram()->HasVariable(Node->GetIteratorName()) == false)
+			Node->IteratorSlot = GetProgram()->GetVariableSlot(Node->GetIteratorName());
+			if (Node->IteratorSlot == -1)
 				throw CodaScriptException(Node, "Invalid iterator variable '%s'", Node->GetIteratorName().c_str());
 
 			Parser->Compile(this, Node, &Node->ByteCode);
@@ -288,6 +343,110 @@ namespace bgsee
 			return Failed;
 		}
 
+#define CODASCRIPTCOMPILER_INISECTION					"CodaCompiler"
+		SME::INI::INISetting									CodaScriptProgramImageCache::kINI_Enabled("CacheCompiledPrograms", CODASCRIPTCOMPILER_INISECTION,
+																										 "Persist compiled programs to disk and reuse them until their source changes",
+																										 (SInt32)1);
+
+		const char*												CodaScriptProgramImageCache::kImageDirectory = "Coda Cache";
+		const char*												CodaScriptProgramImageCache::kImageExtension = ".cdi";
+
+		std::string CodaScriptProgramImageCache::GetImagePath(const ResourceLocation& Source) const
+		{
+			// relative paths are already normalized to lowercase
+			char Buffer[0x10] = {0};
+			_snprintf_s(Buffer, sizeof(Buffer), _TRUNCATE, "%08X", CodaScriptHash::Compute(Source.GetRelativePath()));
+
+			return ResourceLocation(kImageDirectory).GetFullPath() + "\\" + Buffer + kImageExtension;
+		}
+
+		CodaScriptProgramImageCache::CodaScriptProgramImageCache(ICodaScriptVirtualMachine* VM) :
+			VM(VM)
+		{
+			SME_ASSERT(VM);
+		}
+
+		CodaScriptProgramImageCache::~CodaScriptProgramImageCache()
+		{
+			;//
+		}
+
+		bool CodaScriptProgramImageCache::IsEnabled() const
+		{
+			return kINI_Enabled().i != 0;
+		}
+
+		CodaScriptProgramImageCache::ImageHeader CodaScriptProgramImageCache::GetHeader(const std::string& SourceCode) const
+		{
+			ImageHeader Out = {};
+			Out.Signature = kImageSignature;
+			Out.FormatVersion = kImageFormatVersion;
+			Out.SourceHash = CodaScriptHash::Compute(SourceCode);
+			Out.SourceSize = SourceCode.length();
+			Out.CommandTableVersion = VM->GetParser()->GetCommandTableVersion();
+			Out.BytecodeVersion = VM->GetParser()->GetBytecodeVersion();
+
+			return Out;
+		}
+
+		CodaScriptMappedFile::PtrT CodaScriptProgramImageCache::Load(const ResourceLocation& Source, const ImageHeader& Header) const
+		{
+			CodaScriptMappedFile::PtrT Image(new CodaScriptMappedFile(GetImagePath(Source).c_str()));
+			if (Image->IsValid() == false || Image->GetSize() < sizeof(ImageHeader))
+				return nullptr;
+			else if (memcmp(Image->GetData(), &Header, sizeof(ImageHeader)))
+				return nullptr;
+
+			return Image;
+		}
+
+		bool CodaScriptProgramImageCache::Save(const ResourceLocation& Source, const ImageHeader& Header, const CodaScriptBinaryWriter& Image) const
+		{
+			std::string Directory(ResourceLocation(kImageDirectory).GetFullPath());
+			if (CreateDirectory(Directory.c_str(), nullptr) == FALSE && GetLastError() != ERROR_ALREADY_EXISTS)
+				return false;
+
+			// write to a temporary file first to never leave a partially written image behind
+			std::string ImagePath(GetImagePath(Source));
+			std::string TempPath(ImagePath + ".tmp");
+			{
+				std::fstream Out(TempPath.c_str(), std::iostream::out | std::iostream::binary | std::iostream::trunc);
+				if (Out.fail())
+					return false;
+
+				Out.write(reinterpret_cast<const char*>(&Header), sizeof(ImageHeader));
+				Out.write(Image.GetBuffer().c_str(), Image.GetBuffer().length());
+				if (Out.fail())
+				{
+					Out.close();
+					DeleteFile(TempPath.c_str());
+					return false;
+				}
+			}
+
+			if (MoveFileEx(TempPath.c_str(), ImagePath.c_str(), MOVEFILE_REPLACE_EXISTING) == FALSE)
+			{
+				DeleteFile(TempPath.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+		void CodaScriptProgramImageCache::Purge(const ResourceLocation& Source) const
+		{
+			DeleteFile(GetImagePath(Source).c_str());
+		}
+
+		void CodaScriptProgramImageCache::RegisterINISettings(INISettingDepotT& Depot)
+		{
+			Depot.push_back(&kINI_Enabled);
+		}
+
+		SME::INI::INISetting									CodaScriptCompiler::kINI_WorkerThreads("WorkerThreads", CODASCRIPTCOMPILER_INISECTION,
+																							   "Number of threads used to parse scripts in bulk. 0 = one per hardware thread",
+																							   (SInt32)0);
+
 		CodaScriptCompiler			CodaScriptCompiler::Instance;
 
 		bool CodaScriptCompiler::GetKeywordInStack(CodaScriptKeywordStackT& Stack, CodaScriptKeywordT Keyword) const
@@ -324,152 +483,156 @@ namespace bgsee
 			return true;
 		}
 
-		void CodaScriptCompiler::Preprocess(std::fstream& SourceCode, CodaScriptCompiler::SourceData& OutPreprocessedCode)
+		bool CodaScriptCompiler::ReadSource(const ResourceLocation& Filepath, std::string& OutSourceCode) const
+		{
+			std::ifstream InputStream(Filepath(), std::iostream::in | std::iostream::binary);
+			if (InputStream.fail())
+				return false;
+
+			InputStream.seekg(0, std::iostream::end);
+			std::streamoff Size = InputStream.tellg();
+			InputStream.seekg(0, std::iostream::beg);
+
+			if (Size < 0)
+				return false;
+
+			OutSourceCode.resize(static_cast<size_t>(Size));
+			if (Size)
+				InputStream.read(&OutSourceCode[0], Size);
+
+			return InputStream.fail() == false;
+		}
+
+		void CodaScriptCompiler::Preprocess(const char* SourceCode, UInt32 Length, CodaScriptCompiler::SourceData& OutPreprocessedCode)
 		{
 			// Call macro: @<script_path>(<args>)
 			// use '.' instead of '\' in the path
 			static const char kCallMacro_StartSymbol = '@';
 			static const char kLineAppendSymbol = '\\';
 
-
-			class Reader
-			{
-				std::fstream&		Stream;
-				char				Buffer[0x1000];
-				int					Line;
-			public:
-				Reader(std::fstream& In) : Stream(In), Buffer{}, Line(0) {}
-
-				bool IsEOF() { return Stream.eof(); }
-				bool ReadLine(CodaScriptSourceCodeT& Out)
-				{
-					if (IsEOF())
-						return false;
-					else
-					{
-						Line++;
-						Stream.getline(Buffer, sizeof(Buffer));
-						Out = Buffer;
-						return true;
-					}
-				}
-				int GetLineNumber() { return Line; }
-			};
-
-			Reader SourceReader(SourceCode);
+			const char* const SourceEnd = SourceCode + Length;
+			const char* LineStart = SourceCode;
+			int CurrentLine = 0;
 			bool AppendLine = false;
 			int SavedLine = -1;
-			int CurrentLine = -1;
-			CodaScriptSourceCodeT LineAccum;
+			CodaScriptSourceCodeT LineAccum, LineBuffer, Sanitized, Processed, CurrentScriptCall, CurrentDependency;
 			CodaScriptTokenizer Tokenizer;
 
-			while (true)
-			{
-				CodaScriptSourceCodeT LineBuffer, Sanitized;
-				bool StopAppend = false;
-				if (SourceReader.ReadLine(LineBuffer))
-				{
-					CurrentLine = SourceReader.GetLineNumber();
-					Tokenizer.Sanitize(LineBuffer, Sanitized,
-									   CodaScriptTokenizer::kSanitizeOps_StripComments);
+			auto EmitLine = [&](const CodaScriptSourceCodeT& Line, int LineNumber) {
+				if (Line.empty())
+					return;
 
-					if (Sanitized.empty() == false)
+				bool ProcessCall = false;
+				Processed.clear();
+
+				int Index = -1;
+				for (auto& Itr : Line)
+				{
+					Index++;
+					if (ProcessCall)
 					{
-						if (Sanitized.back() == kLineAppendSymbol)
+						// process until the opening parenthesis
+						if (Itr == '(')
 						{
-							if (AppendLine == false)
-							{
-								// begin appending
-								AppendLine = true;
-								LineAccum = Sanitized.substr(0, Sanitized.length() - 1);
-								SavedLine = CurrentLine;
-								continue;
-							}
+							ProcessCall = false;
+							if (Line.length() > Index + 1 && Line[Index + 1] != ')')
+								CurrentScriptCall += "\", ";
 							else
-							{
-								// strip leading whitespace and continue appending
-								LineBuffer = Sanitized;
-								Tokenizer.Sanitize(LineBuffer, Sanitized,
-												   CodaScriptTokenizer::kSanitizeOps_StripLeadingWhitespace);
-								LineAccum.append(Sanitized.substr(0, Sanitized.length() - 1));
-								continue;
-							}
+								CurrentScriptCall += "\"";
+
+							Processed += CurrentScriptCall;
+
+							auto& Dependencies = OutPreprocessedCode.Dependencies;
+							if (std::find(Dependencies.begin(), Dependencies.end(), CurrentDependency) == Dependencies.end())
+								Dependencies.push_back(CurrentDependency);
 						}
-						else if (AppendLine)
+						else if (Itr == '.')
 						{
-							// stop appending
-							StopAppend = true;
+							CurrentScriptCall += "\\\\";
+							CurrentDependency += '\\';
 						}
+						else
+						{
+							CurrentScriptCall += Itr;
+							CurrentDependency += Itr;
+						}
+
+						continue;
 					}
-				}
-				else
-					StopAppend = true;
 
-				if (StopAppend)
-				{
-					// stop appending
-					AppendLine = false;
-					LineBuffer = Sanitized;
-					Tokenizer.Sanitize(LineBuffer, Sanitized,
-									   CodaScriptTokenizer::kSanitizeOps_StripLeadingWhitespace);
-					LineAccum.append(Sanitized);
-					Sanitized = LineAccum;
-					CurrentLine = SavedLine;
+					if (Itr == kCallMacro_StartSymbol)
+					{
+						SME_ASSERT(ProcessCall == false);
+						ProcessCall = true;
+
+						CurrentScriptCall = "call(\"";
+						CurrentDependency.clear();
+						continue;
+					}
+					else
+						Processed += Itr;
 				}
 
-				if (Sanitized.empty() == false)
-				{
-					CodaScriptSourceCodeT Processed;
-					bool ProcessCall = false;
-					CodaScriptSourceCodeT CurrentScriptCall;
+				// append the unprocessed line if we couldn't find the opening parenthesis
+				if (ProcessCall)
+					Processed = Line;
 
-					int Index = -1;
-					for (auto& Itr : Sanitized)
-					{
-						Index++;
-						if (ProcessCall)
-						{
-							// process until the opening parenthesis
-							if (Itr == '(')
-							{
-								ProcessCall = false;
-								if (Sanitized.length() > Index + 1 && Sanitized[Index + 1] != ')')
-									CurrentScriptCall += "\", ";
-								else
-									CurrentScriptCall += "\"";
+				OutPreprocessedCode.Lines.push_back(SourceData::LineRecord(LineNumber, Processed));
+			};
 
-								Processed += CurrentScriptCall;
-							}
-							else if (Itr == '.')
-								CurrentScriptCall += "\\\\";
-							else
-								CurrentScriptCall += Itr;
+			while (LineStart < SourceEnd)
+			{
+				// lines are sliced straight out of the source buffer
+				const char* LineEnd = static_cast<const char*>(memchr(LineStart, '\n', SourceEnd - LineStart));
+				if (LineEnd == nullptr)
+					LineEnd = SourceEnd;
 
-							continue;
-						}
+				const char* NextLine = LineEnd == SourceEnd ? SourceEnd : LineEnd + 1;
+				if (LineEnd != LineStart && LineEnd[-1] == '\r')
+					LineEnd--;
 
-						if (Itr == kCallMacro_StartSymbol)
-						{
-							SME_ASSERT(ProcessCall == false);
-							ProcessCall = true;
+				CurrentLine++;
+				Tokenizer.Sanitize(LineStart, LineEnd - LineStart, Sanitized,
+								   CodaScriptTokenizer::kSanitizeOps_StripComments);
+				LineStart = NextLine;
 
-							CurrentScriptCall = "call(\"";
-							continue;
-						}
-						else
-							Processed += Itr;
-					}
+				// empty lines don't terminate line continuations
+				if (Sanitized.empty())
+					continue;
 
-					// append the unprocessed line if we couldn't find the opening parenthesis
-					if (ProcessCall)
-						Processed = Sanitized;
-
-					OutPreprocessedCode.Lines.insert(std::make_pair(CurrentLine, Processed));
+				if (Sanitized.back() == kLineAppendSymbol)
+				{
+					if (AppendLine == false)
+					{
+						// begin appending
+						AppendLine = true;
+						LineAccum.assign(Sanitized, 0, Sanitized.length() - 1);
+						SavedLine = CurrentLine;
+					}
+					else
+					{
+						// strip leading whitespace and continue appending
+						Tokenizer.Sanitize(Sanitized.c_str(), Sanitized.length() - 1, LineBuffer,
+										   CodaScriptTokenizer::kSanitizeOps_StripLeadingWhitespace);
+						LineAccum.append(LineBuffer);
+					}
 				}
-
-				if (SourceReader.IsEOF())
-					break;
+				else if (AppendLine)
+				{
+					// stop appending
+					AppendLine = false;
+					Tokenizer.Sanitize(Sanitized, LineBuffer,
+									   CodaScriptTokenizer::kSanitizeOps_StripLeadingWhitespace);
+					LineAccum.append(LineBuffer);
+					EmitLine(LineAccum, SavedLine);
+				}
+				else
+					EmitLine(Sanitized, CurrentLine);
 			}
+
+			// the last line continuation runs up to the end of the file
+			if (AppendLine)
+				EmitLine(LineAccum, SavedLine);
 		}
 
 		CodaScriptProgram* CodaScriptCompiler::GenerateProgram(ICodaScriptVirtualMachine* VirtualMachine,
@@ -478,7 +641,6 @@ namespace bgsee
 		{
 			CodaScriptProgram* Out = Instance;
 
-			CodaScriptSourceCodeT SourceLine;
 			UInt32 LineNo = 1;
 			bool Result = true;
 			CodaScriptSourceCodeT LineAccum;
@@ -494,8 +656,8 @@ namespace bgsee
 
 			for (auto& Itr : SourceCode.Lines)
 			{
-				LineNo = Itr.first;
-				SourceLine = Itr.second;
+				LineNo = Itr.Line;
+				const CodaScriptSourceCodeT& SourceLine = Itr.Code;
 
 				if (Tokenizer.Tokenize(SourceLine, false))
 				{
@@ -877,32 +1039,39 @@ namespace bgsee
 				SME_ASSERT(BlockStack.size() == 1 && BlockStack.top() == CodaScriptTokenizer::kTokenType_Invalid);
 				SME_ASSERT(CodeStack.size() == 1 && CodeStack.top() == nullptr);
 
-				// generate code for initializers
-				ICodaScriptExecutableCode::ArrayT Initers;
-				for (auto& Itr : Out->Variables)
+				AttachSyntaxTree(Out, Root.release());
+			}
+
+			return Out;
+		}
+
+		void CodaScriptCompiler::AttachSyntaxTree(CodaScriptProgram* Instance, CodaScriptBEGINBlock* Root)
+		{
+			// generate code for initializers
+			ICodaScriptExecutableCode::ArrayT Initers;
+			for (auto& Itr : Instance->Variables)
+			{
+				// don't bother if the variable is bound to a parameter
+				if (Instance->IsParameter(&Itr) == false && Itr.Initalizer.empty() == false)
 				{
-					// don't bother if the variable is bound to a parameter
-					if (Out->IsParameter(&Itr) == false && Itr.Initalizer.empty() == false)
-					{
-						CodaScriptExpression* Initer = new CodaScriptExpression(Itr.Initalizer, Itr.Line);
-						Initers.push_back(Initer);
-					}
+					CodaScriptExpression* Initer = new CodaScriptExpression(Itr.Initalizer, Itr.Line);
+					Initers.push_back(Initer);
 				}
-
-				CodaScriptProgram::ScopedASTPointerT Temp(new CodaScriptAbstractSyntaxTree(Root.release(), Initers));
-				Out->AST = std::move(Temp);
 			}
 
-			return Out;
+			CodaScriptProgram::ScopedASTPointerT Temp(new CodaScriptAbstractSyntaxTree(Root, Initers));
+			Instance->AST = std::move(Temp);
 		}
 
 		CodaScriptProgram* CodaScriptCompiler::GenerateByteCode(ICodaScriptVirtualMachine* VirtualMachine,
-																CodaScriptProgram* In)
+																CodaScriptProgram* In,
+																CodaScriptBinaryReader* CachedImage,
+																CodaScriptBinaryWriter* ImageRecorder)
 		{
 			if (In->IsValid() == false)
 				return In;
 
-			ICodaScriptExpressionParser::CompileData CompilerInput(VirtualMachine->GetGlobals());
+			ICodaScriptExpressionParser::CompileData CompilerInput(VirtualMachine->GetGlobals(), CachedImage, ImageRecorder);
 			ICodaScriptCompilerMetadata* CompilerMetadata = nullptr;
 
 			try
@@ -932,29 +1101,346 @@ namespace bgsee
 			return In;
 		}
 
-		CodaScriptProgram* CodaScriptCompiler::Compile(ICodaScriptVirtualMachine* VirtualMachine,
-													   const ResourceLocation& Filepath)
+		void CodaScriptCompiler::SerializeCode(ICodaScriptExecutableCode* Code, CodaScriptBinaryWriter& Out) const
 		{
-			std::unique_ptr<CodaScriptProgram> Out(new CodaScriptProgram(VirtualMachine, Filepath));
-			std::fstream InputStream(Filepath(), std::iostream::in);
+			Out.WriteUInt8(Code->Type);
+			Out.WriteUInt32(Code->Line);
+			Out.WriteString(Code->Source);
 
-			if (InputStream.fail() == false)
+			if (Code->Type == ICodaScriptExecutableCode::kCodeType_Block_IF)
 			{
-				SourceData Data;
+				CodaScriptIFBlock* IFBlock = dynamic_cast<CodaScriptIFBlock*>(Code);
+				SME_ASSERT(IFBlock);
+
+				Out.WriteUInt32(IFBlock->BranchELSEIF.size());
+				for (auto Itr : IFBlock->BranchELSEIF)
+					SerializeCode(Itr, Out);
 
-				VirtualMachine->GetMessageHandler()->Indent();
-				Preprocess(InputStream, Data);
-				GenerateProgram(VirtualMachine, Out.get(), Data);
-				GenerateByteCode(VirtualMachine, Out.get());
-				VirtualMachine->GetMessageHandler()->Outdent();
+				Out.WriteUInt8(IFBlock->BranchELSE != nullptr);
+				if (IFBlock->BranchELSE)
+					SerializeCode(IFBlock->BranchELSE, Out);
 			}
-			else
+
+			Out.WriteUInt32(Code->Children.size());
+			for (auto Itr : Code->Children)
 			{
-				VirtualMachine->GetMessageHandler()->Log("Couldn't read Coda script @ %s", Filepath().c_str());
-				Out->Flags |= CodaScriptProgram::kFlag_Uncompiled;
+				ICodaScriptExecutableCode* Child = dynamic_cast<ICodaScriptExecutableCode*>(Itr);
+				SME_ASSERT(Child);
+
+				SerializeCode(Child, Out);
+			}
+		}
+
+		ICodaScriptExecutableCode* CodaScriptCompiler::DeserializeCode(CodaScriptBinaryReader& In) const
+		{
+			UInt8 Type = In.ReadUInt8();
+			UInt32 Line = In.ReadUInt32();
+			CodaScriptSourceCodeT Source(In.ReadString());
+
+			// the nodes are reconstructed from their (sanitized) source lines, same as when they were first compiled
+			std::unique_ptr<ICodaScriptExecutableCode> Out;
+			switch (Type)
+			{
+			case ICodaScriptExecutableCode::kCodeType_Line_EXPRESSION:
+				Out.reset(new CodaScriptExpression(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Block_BEGIN:
+				Out.reset(new CodaScriptBEGINBlock(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Block_IF:
+				Out.reset(new CodaScriptIFBlock(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Block_ELSEIF:
+				Out.reset(new CodaScriptELSEIFBlock(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Block_ELSE:
+				Out.reset(new CodaScriptELSEBlock(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Loop_WHILE:
+				Out.reset(new CodaScriptWHILEBlock(Source, Line));
+				break;
+			case ICodaScriptExecutableCode::kCodeType_Loop_FOREACH:
+				Out.reset(new CodaScriptFOREACHBlock(Source, Line));
+				break;
+			default:
+				throw CodaScriptException("Invalid code type %d @ line %d", Type, Line);
+			}
+
+			if (Type == ICodaScriptExecutableCode::kCodeType_Block_IF)
+			{
+				CodaScriptIFBlock* IFBlock = dynamic_cast<CodaScriptIFBlock*>(Out.get());
+
+				for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+				{
+					std::unique_ptr<ICodaScriptExecutableCode> Branch(DeserializeCode(In));
+					if (Branch->Type != ICodaScriptExecutableCode::kCodeType_Block_ELSEIF)
+						throw CodaScriptException("Invalid ELSEIF block @ line %d", Branch->Line);
+
+					IFBlock->BranchELSEIF.push_back(dynamic_cast<CodaScriptELSEIFBlock*>(Branch.release()));
+				}
+
+				if (In.ReadUInt8())
+				{
+					std::unique_ptr<ICodaScriptExecutableCode> Branch(DeserializeCode(In));
+					if (Branch->Type != ICodaScriptExecutableCode::kCodeType_Block_ELSE)
+						throw CodaScriptException("Invalid ELSE block @ line %d", Branch->Line);
+
+					IFBlock->BranchELSE = dynamic_cast<CodaScriptELSEBlock*>(Branch.release());
+				}
+			}
+
+			for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+			{
+				ICodaScriptExecutableCode* Child = DeserializeCode(In);
+				Child->Attach(Out.get());
 			}
 
 			return Out.release();
 		}
+
+		void CodaScriptCompiler::SerializeProgram(CodaScriptProgram* Program, CodaScriptBinaryWriter& Out) const
+		{
+			Out.WriteString(Program->Name);
+			Out.WriteDouble(Program->PollingInterval);
+
+			Out.WriteUInt32(Program->Variables.size());
+			for (auto& Itr : Program->Variables)
+			{
+				Out.WriteString(Itr.Name);
+				Out.WriteString(Itr.Initalizer);
+				Out.WriteUInt32(Itr.Line);
+			}
+
+			Out.WriteUInt32(Program->Parameters.size());
+			for (auto& Itr : Program->Parameters)
+				Out.WriteUInt32(Itr.BoundVariable->Slot);
+
+			Out.WriteUInt32(Program->Dependencies.size());
+			for (auto& Itr : Program->Dependencies)
+				Out.WriteString(Itr);
+
+			SME_ASSERT(Program->AST);
+			SerializeCode(Program->AST->GetRoot(), Out);
+		}
+
+		void CodaScriptCompiler::DeserializeProgram(CodaScriptProgram* Instance, CodaScriptBinaryReader& In)
+		{
+			Instance->Name = In.ReadString();
+			Instance->PollingInterval = In.ReadDouble();
+
+			for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+			{
+				CodaScriptSourceCodeT Name(In.ReadString());
+				CodaScriptSourceCodeT Initalizer(In.ReadString());
+				UInt32 Line = In.ReadUInt32();
+
+				Instance->AddVariable(Name, Initalizer, Line);
+			}
+
+			// parameters hold pointers into the variable array, so they must only be added after all the variables
+			for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+			{
+				UInt32 Slot = In.ReadUInt32();
+				if (Slot >= Instance->Variables.size())
+					throw CodaScriptException("Invalid parameter slot %d", Slot);
+
+				Instance->AddParameter(&Instance->Variables[Slot]);
+			}
+
+			for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+				Instance->Dependencies.push_back(In.ReadString());
+
+			std::unique_ptr<ICodaScriptExecutableCode> Root(DeserializeCode(In));
+			if (Root->GetType() != ICodaScriptExecutableCode::kCodeType_Block_BEGIN)
+				throw CodaScriptException("Invalid root block");
+
+			AttachSyntaxTree(Instance, dynamic_cast<CodaScriptBEGINBlock*>(Root.release()));
+		}
+
+		CodaScriptCompiler::CompilationUnit::CompilationUnit(ICodaScriptVirtualMachine* VirtualMachine,
+															 const ResourceLocation& Filepath,
+															 const CodaScriptProgramImageCache* ImageCache) :
+			Program(new CodaScriptProgram(VirtualMachine, Filepath)),
+			Filepath(Filepath),
+			ImageCache(ImageCache),
+			UseImage(ImageCache && ImageCache->IsEnabled()),
+			RestoreImage(UseImage),
+			ImageRejected(false),
+			ImageKey(),
+			Image(),
+			ImageReader(),
+			Log()
+		{
+			;//
+		}
+
+		void CodaScriptCompiler::CompileFrontEnd(ICodaScriptVirtualMachine* VirtualMachine, CompilationUnit& Unit)
+		{
+			CodaScriptProgram* Out = Unit.Program.get();
+			std::string SourceCode;
+
+			if (ReadSource(Unit.Filepath, SourceCode) == false)
+			{
+				VirtualMachine->GetMessageHandler()->Log("Couldn't read Coda script @ %s", Unit.Filepath().c_str());
+				Out->Flags |= CodaScriptProgram::kFlag_Uncompiled;
+				return;
+			}
+
+			if (Unit.UseImage)
+			{
+				Unit.ImageKey = Unit.ImageCache->GetHeader(SourceCode);
+
+				if (Unit.RestoreImage)
+					Unit.Image = Unit.ImageCache->Load(Unit.Filepath, Unit.ImageKey);
+
+				if (Unit.Image)
+				{
+					Unit.ImageReader.reset(new CodaScriptBinaryReader(Unit.Image->GetData(), Unit.Image->GetSize(),
+																	  sizeof(CodaScriptProgramImageCache::ImageHeader)));
+					try
+					{
+						DeserializeProgram(Out, *Unit.ImageReader);
+					}
+					catch (CodaScriptException& E)
+					{
+						// the program is left in an undefined state, the back end will start over
+						VirtualMachine->GetMessageHandler()->Log("Couldn't restore compiled image - %s", E.GetMessage());
+						Unit.ImageRejected = true;
+					}
+
+					return;
+				}
+			}
+
+			SourceData Data;
+			Preprocess(SourceCode.c_str(), SourceCode.length(), Data);
+			GenerateProgram(VirtualMachine, Out, Data);
+			Out->Dependencies = Data.Dependencies;
+		}
+
+		void CodaScriptCompiler::CompileBackEnd(ICodaScriptVirtualMachine* VirtualMachine, CompilationUnit& Unit)
+		{
+			if (Unit.Image && Unit.ImageRejected == false)
+			{
+				GenerateByteCode(VirtualMachine, Unit.Program.get(), Unit.ImageReader.get());
+				if (Unit.Program->IsValid() && Unit.ImageReader->IsEOF())
+					return;
+
+				Unit.ImageRejected = true;
+			}
+
+			if (Unit.ImageRejected)
+			{
+				VirtualMachine->GetMessageHandler()->Log("Discarding stale compiled image of Coda script @ %s", Unit.Filepath().c_str());
+				Unit.ImageReader.reset();
+				Unit.Image.reset();
+				Unit.ImageCache->Purge(Unit.Filepath);
+
+				Unit.Program.reset(new CodaScriptProgram(VirtualMachine, Unit.Filepath));
+				Unit.RestoreImage = false;
+				Unit.ImageRejected = false;
+
+				CompileFrontEnd(VirtualMachine, Unit);
+			}
+
+			CodaScriptProgram* Out = Unit.Program.get();
+			if (Unit.UseImage && Out->IsValid())
+			{
+				CodaScriptBinaryWriter Image;
+
+				SerializeProgram(Out, Image);
+				GenerateByteCode(VirtualMachine, Out, nullptr, &Image);
+
+				if (Out->IsValid() && Image.IsValid())
+					Unit.ImageCache->Save(Unit.Filepath, Unit.ImageKey, Image);
+			}
+			else
+				GenerateByteCode(VirtualMachine, Out);
+		}
+
+		CodaScriptProgram* CodaScriptCompiler::Compile(ICodaScriptVirtualMachine* VirtualMachine,
+													   const ResourceLocation& Filepath,
+													   const CodaScriptProgramImageCache* ImageCache)
+		{
+			CompilationUnit Unit(VirtualMachine, Filepath, ImageCache);
+
+			VirtualMachine->GetMessageHandler()->Indent();
+			CompileFrontEnd(VirtualMachine, Unit);
+			CompileBackEnd(VirtualMachine, Unit);
+			VirtualMachine->GetMessageHandler()->Outdent();
+
+			return Unit.Program.release();
+		}
+
+		void CodaScriptCompiler::Compile(ICodaScriptVirtualMachine* VirtualMachine,
+										 const std::vector<ResourceLocation>& Filepaths,
+										 std::vector<CodaScriptProgram*>& OutPrograms,
+										 const CodaScriptProgramImageCache* ImageCache,
+										 BatchStatistics* OutStatistics)
+		{
+			CodaScriptMessageHandler* MessageHandler = VirtualMachine->GetMessageHandler();
+			CodaScriptElapsedTimeCounterT Timer;
+			BatchStatistics Statistics;
+			CompilationUnit::ArrayT Units;
+
+			Timer.Update();
+
+			// programs are instantiated, and thereby registered with the parser, on the calling thread
+			for (auto& Itr : Filepaths)
+				Units.push_back(CompilationUnit::PtrT(new CompilationUnit(VirtualMachine, Itr, ImageCache)));
+
+			{
+				CodaScriptWorkerPool Workers(kINI_WorkerThreads().i > 0 ? kINI_WorkerThreads().i : 0);
+				Statistics.Threads = Workers.GetThreadCount();
+
+				for (auto& Itr : Units)
+				{
+					CompilationUnit* Unit = Itr.get();
+					Workers.Enqueue([this, VirtualMachine, MessageHandler, Unit]() {
+						MessageHandler->BeginTranscript(&Unit->Log);
+						try
+						{
+							CompileFrontEnd(VirtualMachine, *Unit);
+						}
+						catch (...)
+						{
+							MessageHandler->Log("Unknown Compiler Error [Script: %s]", Unit->Filepath().c_str());
+							Unit->Program->Flags |= CodaScriptProgram::kFlag_CompileError;
+						}
+						MessageHandler->EndTranscript();
+					});
+				}
+
+				Workers.Wait();
+			}
+
+			Timer.Update();
+			Statistics.FrontEndTime = Timer.GetTimePassed() / 1000.0;
+
+			for (auto& Itr : Units)
+			{
+				if (Itr->Log.IsEmpty() == false)
+					MessageHandler->Log("Compiling Coda script @ %s", Itr->Filepath().c_str());
+
+				MessageHandler->Indent();
+				MessageHandler->Replay(Itr->Log);
+				CompileBackEnd(VirtualMachine, *Itr);
+				MessageHandler->Outdent();
+
+				OutPrograms.push_back(Itr->Program.release());
+			}
+
+			Timer.Update();
+			Statistics.BackEndTime = Timer.GetTimePassed() / 1000.0;
+			Statistics.Programs = Units.size();
+
+			if (OutStatistics)
+				*OutStatistics = Statistics;
+		}
+
+		void CodaScriptCompiler::RegisterINISettings(INISettingDepotT& Depot)
+		{
+			Depot.push_back(&kINI_WorkerThreads);
+		}
 	}
 }
\ No newline at end of file
@@ -15,16 +15,22 @@ namespace bgsee
 			virtual const CodaScriptVariableNameArrayT&		GetVariables(CodaScriptVariableNameArrayT& OutNames) const = 0;
 			virtual UInt32									GetVariableCount() const = 0;
 			virtual bool									HasVariable(const CodaScriptSourceCodeT& Name) const = 0;
+			virtual int										GetVariableSlot(const CodaScriptSourceCodeT& Name) const = 0;		// returns the variable's index in GetVariables()'s output, -1 if not found
 			virtual const CodaScriptVariableNameArrayT&		GetParameters(CodaScriptVariableNameArrayT& OutNames) const = 0;		// returns the ordered list of parameter variables
 			virtual UInt32									GetParameterCount() const = 0;
+			virtual int										GetParameterSlot(UInt32 Index) const = 0;		// returns the variable slot bound to the parameter at the index
 			virtual double									GetPollingInteval() const = 0;
 			virtual ICodaScriptExpressionParser*			GetBoundParser() const = 0;
 			virtual ICodaScriptCompilerMetadata*			GetCompilerMetadata() const = 0;
 			virtual bool									IsValid() const = 0;
+			virtual bool									IsThreadSafe() const = 0;		// returns true if the program can be executed on a worker thread
 			virtual void									InvalidateBytecode() = 0;
 			virtual void									Accept(ICodaScriptSyntaxTreeEvaluator* Visitor) noexcept = 0;
 			virtual const ResourceLocation&					GetFilepath() const = 0;
 
+			virtual ICodaScriptExecutionContext*			AcquireContext() = 0;		// returns a previously released context, reset to its initial state. nullptr if there are none
+			virtual void									ReleaseContext(ICodaScriptExecutionContext* Context) = 0;		// takes ownership of the pointer
+
 			typedef std::unique_ptr<ICodaScriptProgram>		PtrT;
 		};
 
@@ -36,6 +42,8 @@ namespace bgsee
 
 			virtual ICodaScriptExpressionParser*			GetParentParser() const = 0;
 			virtual ICodaScriptProgram*						GetSourceProgram() const = 0;
+			virtual const char*								GetThreadSafetyViolation() const = 0;		// describes the first expression that prevents the program from being executed on a worker thread,
+																										// nullptr if there are none
 		};
 
 		class ICodaScriptExpressionByteCode
@@ -49,6 +57,16 @@ namespace bgsee
 			ICodaScriptExecutableCode*						GetSource(void) const;
 		};
 
+		// the parser's mutable evaluation state for a single execution context, e.g. value buffers and variable bindings
+		// kept apart from the compiled bytecode so that a program can be evaluated by multiple contexts at the same time
+		class ICodaScriptEvaluationState
+		{
+		public:
+			virtual ~ICodaScriptEvaluationState() = 0 {}
+
+			typedef std::unique_ptr<ICodaScriptEvaluationState>		PtrT;
+		};
+
 		// since the language syntax and feature set is predominantly based on the muParserX expression parser's,
 		// the interface expects all implementations to support at least as much as the former
 		class ICodaScriptExpressionParser
@@ -59,9 +77,11 @@ namespace bgsee
 			struct CompileData
 			{
 				const CodaScriptVariable::ArrayT&		GlobalVariables;
+				CodaScriptBinaryReader*					CachedImage;		// if set, the bytecode is restored from the image instead of being compiled from source
+				CodaScriptBinaryWriter*					ImageRecorder;		// if set, the compiled bytecode is serialized into the writer
 
-				CompileData(const CodaScriptVariable::ArrayT& Globals)
-					: GlobalVariables(Globals) {}
+				CompileData(const CodaScriptVariable::ArrayT& Globals, CodaScriptBinaryReader* CachedImage = nullptr, CodaScriptBinaryWriter* ImageRecorder = nullptr)
+					: GlobalVariables(Globals), CachedImage(CachedImage), ImageRecorder(ImageRecorder) {}
 			};
 
 			struct EvaluateData
@@ -94,6 +114,10 @@ namespace bgsee
 																	 CodaScriptBackingStore* Result = nullptr) = 0;
 			virtual void									EndEvaluation(ICodaScriptProgram* Program) = 0;
 
+			// serialized bytecode can only be restored by a parser that reports the same versions
+			virtual UInt32									GetCommandTableVersion() const = 0;		// changes when commands or constants are registered
+			virtual UInt32									GetBytecodeVersion() const = 0;
+
 			typedef std::unique_ptr<ICodaScriptExpressionParser>		PtrT;
 		};
 
@@ -101,6 +125,7 @@ namespace bgsee
 		{
 			friend class CodaScriptCompiler;
 			friend class CodaScriptSyntaxTreeCompileVisitor;
+			friend class CodaScriptBenchmarks;
 
 			enum
 			{
@@ -114,9 +139,10 @@ namespace bgsee
 				CodaScriptSourceCodeT			Name;
 				CodaScriptSourceCodeT			Initalizer;
 				UInt32							Line;
+				UInt32							Slot;			// dense index, resolved at compile time
 
-				VariableInfo(const CodaScriptSourceCodeT& Name, const CodaScriptSourceCodeT& Initalizer, UInt32 Line) :
-					Name(Name), Initalizer(Initalizer), Line(Line) {}
+				VariableInfo(const CodaScriptSourceCodeT& Name, const CodaScriptSourceCodeT& Initalizer, UInt32 Line, UInt32 Slot) :
+					Name(Name), Initalizer(Initalizer), Line(Line), Slot(Slot) {}
 			};
 
 			struct ParameterInfo
@@ -130,17 +156,24 @@ namespace bgsee
 			typedef std::vector<ParameterInfo>						ParameterInfoArrayT;
 			typedef std::unique_ptr<CodaScriptAbstractSyntaxTree>	ScopedASTPointerT;
 			typedef std::unique_ptr<ICodaScriptCompilerMetadata>	ScopedMetadataPointerT;
+			typedef std::vector<std::unique_ptr<ICodaScriptExecutionContext>>	ContextPoolT;
 
+			static const UInt32					kMaxPooledContexts = 8;
+		public:
+			typedef std::vector<std::string>						DependencyArrayT;
+		private:
 			ResourceLocation					Filepath;
 			CodaScriptSourceCodeT				Name;
 			VariableInfoArrayT					Variables;
 			ParameterInfoArrayT					Parameters;
 			double								PollingInterval;
 			ScopedASTPointerT					AST;
-			UInt8								Flags;
+			std::atomic<UInt8>					Flags;				// read by the worker threads executing the program, can be invalidated while they do
 			ICodaScriptVirtualMachine*			VM;
 			ICodaScriptExpressionParser*		Parser;
 			ScopedMetadataPointerT				Metadata;
+			DependencyArrayT					Dependencies;		// scripts invoked through call macros, relative to the script repository
+			ContextPoolT						ContextPool;		// contexts of finished (foreground) executions, saves reallocating the variables of frequently called scripts
 
 			void								AddVariable(const CodaScriptSourceCodeT& Name, const CodaScriptSourceCodeT& Initalizer, UInt32 Line);
 			const VariableInfo*					GetVariable(const CodaScriptSourceCodeT& Name) const;
@@ -156,15 +189,23 @@ namespace bgsee
 			virtual const CodaScriptVariableNameArrayT&	GetVariables(CodaScriptVariableNameArrayT& OutNames) const override;
 			virtual UInt32								GetVariableCount() const override;
 			virtual bool								HasVariable(const CodaScriptSourceCodeT& Name) const override;
+			virtual int									GetVariableSlot(const CodaScriptSourceCodeT& Name) const override;
 			virtual const CodaScriptVariableNameArrayT&	GetParameters(CodaScriptVariableNameArrayT& OutNames) const override;
 			virtual UInt32								GetParameterCount() const override;
+			virtual int									GetParameterSlot(UInt32 Index) const override;
 			virtual double								GetPollingInteval() const override;
 			virtual ICodaScriptExpressionParser*		GetBoundParser() const override;
 			virtual ICodaScriptCompilerMetadata*		GetCompilerMetadata() const override;
 			virtual bool								IsValid() const override;
+			virtual bool								IsThreadSafe() const override;
 			virtual void								InvalidateBytecode() override;
 			virtual void								Accept(ICodaScriptSyntaxTreeEvaluator* Visitor) noexcept override;
 			virtual const ResourceLocation&				GetFilepath() const override;
+
+			virtual ICodaScriptExecutionContext*		AcquireContext() override;
+			virtual void								ReleaseContext(ICodaScriptExecutionContext* Context) override;
+
+			const DependencyArrayT&						GetDependencies() const;
 		};
 
 
@@ -189,8 +230,50 @@ namespace bgsee
 			bool											HasFailed(void) const;
 		};
 
+		// persists compiled programs to disk so that they needn't be recompiled in subsequent sessions
+		// images are keyed by the source file's contents and the versions reported by the expression parser
+		class CodaScriptProgramImageCache
+		{
+			static INISetting					kINI_Enabled;
+
+			static const UInt32					kImageSignature = 'CDAI';
+			static const UInt32					kImageFormatVersion = 2;
+			static const char*					kImageDirectory;
+			static const char*					kImageExtension;
+
+			ICodaScriptVirtualMachine*			VM;
+
+			std::string							GetImagePath(const ResourceLocation& Source) const;
+		public:
+			struct ImageHeader
+			{
+				UInt32							Signature;
+				UInt32							FormatVersion;
+				UInt32							SourceHash;
+				UInt32							SourceSize;
+				UInt32							CommandTableVersion;
+				UInt32							BytecodeVersion;
+			};
+
+			CodaScriptProgramImageCache(ICodaScriptVirtualMachine* VM);
+			~CodaScriptProgramImageCache();
+
+			bool								IsEnabled() const;
+			ImageHeader							GetHeader(const std::string& SourceCode) const;
+
+			CodaScriptMappedFile::PtrT			Load(const ResourceLocation& Source, const ImageHeader& Header) const;		// returns nullptr if there's no image or if it's stale
+			bool								Save(const ResourceLocation& Source, const ImageHeader& Header, const CodaScriptBinaryWriter& Image) const;
+			void								Purge(const ResourceLocation& Source) const;
+
+			static void							RegisterINISettings(INISettingDepotT& Depot);
+		};
+
 		class CodaScriptCompiler
 		{
+			friend class CodaScriptBenchmarks;
+
+			static INISetting					kINI_WorkerThreads;
+
 			typedef std::stack<CodaScriptKeywordT>	CodaScriptKeywordStackT;
 
 			bool								GetKeywordInStack(CodaScriptKeywordStackT& Stack, CodaScriptKeywordT Keyword) const;
@@ -199,18 +282,78 @@ namespace bgsee
 
 			struct SourceData
 			{
-				std::map<int, CodaScriptSourceCodeT>		Lines;		// key = line no
+				struct LineRecord
+				{
+					int									Line;
+					CodaScriptSourceCodeT				Code;
+
+					LineRecord(int Line, const CodaScriptSourceCodeT& Code) : Line(Line), Code(Code) {}
+				};
+
+				std::vector<LineRecord>						Lines;		// in ascending order of line numbers
+				CodaScriptProgram::DependencyArrayT			Dependencies;
 			};
 
-			void								Preprocess(std::fstream& SourceCode, SourceData& OutPreprocessedCode);
+			bool								ReadSource(const ResourceLocation& Filepath, std::string& OutSourceCode) const;
+			void								Preprocess(const char* SourceCode, UInt32 Length, SourceData& OutPreprocessedCode);
+			void								AttachSyntaxTree(CodaScriptProgram* Instance, CodaScriptBEGINBlock* Root);
 			CodaScriptProgram*					GenerateProgram(ICodaScriptVirtualMachine* VirtualMachine,
 																CodaScriptProgram* Instance,
 																SourceData& SourceCode);
 			CodaScriptProgram*					GenerateByteCode(ICodaScriptVirtualMachine* VirtualMachine,
-																 CodaScriptProgram* In);
+																 CodaScriptProgram* In,
+																 CodaScriptBinaryReader* CachedImage = nullptr,
+																 CodaScriptBinaryWriter* ImageRecorder = nullptr);
+
+			void								SerializeCode(ICodaScriptExecutableCode* Code, CodaScriptBinaryWriter& Out) const;
+			ICodaScriptExecutableCode*			DeserializeCode(CodaScriptBinaryReader& In) const;
+			void								SerializeProgram(CodaScriptProgram* Program, CodaScriptBinaryWriter& Out) const;
+			void								DeserializeProgram(CodaScriptProgram* Instance, CodaScriptBinaryReader& In);
+
+			struct CompilationUnit
+			{
+				std::unique_ptr<CodaScriptProgram>				Program;
+				ResourceLocation								Filepath;
+				const CodaScriptProgramImageCache*				ImageCache;
+				bool											UseImage;			// record and save a program image after a full compile
+				bool											RestoreImage;		// attempt to restore the program from its image
+				bool											ImageRejected;
+				CodaScriptProgramImageCache::ImageHeader		ImageKey;
+				CodaScriptMappedFile::PtrT						Image;				// valid if the syntax tree was restored from the image
+				std::unique_ptr<CodaScriptBinaryReader>			ImageReader;		// positioned at the start of the bytecode
+				CodaScriptMessageHandler::Transcript			Log;
+
+				CompilationUnit(ICodaScriptVirtualMachine* VirtualMachine, const ResourceLocation& Filepath, const CodaScriptProgramImageCache* ImageCache);
+
+				typedef std::unique_ptr<CompilationUnit>		PtrT;
+				typedef std::vector<PtrT>						ArrayT;
+			};
+
+			// the front end only touches the unit's program and can run on any thread
+			// the back end generates bytecode through the shared expression parser and must run on the main thread
+			void								CompileFrontEnd(ICodaScriptVirtualMachine* VirtualMachine, CompilationUnit& Unit);
+			void								CompileBackEnd(ICodaScriptVirtualMachine* VirtualMachine, CompilationUnit& Unit);
 		public:
+			struct BatchStatistics
+			{
+				UInt32							Programs;
+				UInt32							Threads;
+				double							FrontEndTime;		// in seconds
+				double							BackEndTime;
+
+				BatchStatistics() : Programs(0), Threads(0), FrontEndTime(0), BackEndTime(0) {}
+			};
+
 			CodaScriptProgram*					Compile(ICodaScriptVirtualMachine* VirtualMachine,
-														const ResourceLocation& Filepath);
+														const ResourceLocation& Filepath,
+														const CodaScriptProgramImageCache* ImageCache = nullptr);
+			void								Compile(ICodaScriptVirtualMachine* VirtualMachine,
+														const std::vector<ResourceLocation>& Filepaths,
+														std::vector<CodaScriptProgram*>& OutPrograms,		// caller takes ownership, same order as the input
+														const CodaScriptProgramImageCache* ImageCache = nullptr,
+														BatchStatistics* OutStatistics = nullptr);
+
+			static void							RegisterINISettings(INISettingDepotT& Depot);
 
 			static CodaScriptCompiler			Instance;
 
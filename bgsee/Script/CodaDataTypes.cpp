@@ -4,20 +4,29 @@ namespace bgsee
 {
 	namespace script
 	{
-		int		CodaScriptBackingStore::GIC = 0;
+		std::atomic<int>		CodaScriptBackingStore::GIC(0);
 
 		void CodaScriptBackingStore::Reset( void )
 		{
 			switch (Type)
 			{
 			case kDataType_String:
-				SAFEDELETE_ARRAY(StringData);
+				if (HasHeapString())
+					delete [] StringData;
+
+				StringData = nullptr;
+				StringLength = StringCapacity = 0;
 				break;
 			}
 
 			Type = kDataType_Invalid;
 		}
 
+		bool CodaScriptBackingStore::HasHeapString() const
+		{
+			return Type == kDataType_String && StringData != InlineString;
+		}
+
 		void CodaScriptBackingStore::Copy( const CodaScriptBackingStore& Source )
 		{
 			switch (Source.Type)
@@ -28,7 +37,7 @@ namespace bgsee
 				SetArray(Source.GetArray());
 				break;
 			case kDataType_String:
-				SetString(Source.GetString());
+				SetString(Source.StringData, Source.StringLength);
 				break;
 			case kDataType_Reference:
 				SetFormID(Source.GetFormID());
@@ -39,6 +48,42 @@ namespace bgsee
 			}
 		}
 
+		void CodaScriptBackingStore::Move(CodaScriptBackingStore& Source)
+		{
+			if (this == &Source)
+				return;
+
+			switch (Source.Type)
+			{
+			case kDataType_Array:
+				Reset();
+				Type = kDataType_Array;
+				ArrayData = std::move(Source.ArrayData);
+
+				Source.Type = kDataType_Invalid;
+				break;
+			case kDataType_String:
+				if (Source.HasHeapString())
+				{
+					// steal the buffer, inline strings are copied below
+					Reset();
+					Type = kDataType_String;
+					StringData = Source.StringData;
+					StringLength = Source.StringLength;
+					StringCapacity = Source.StringCapacity;
+
+					Source.Type = kDataType_Invalid;
+					Source.StringData = nullptr;
+					Source.StringLength = Source.StringCapacity = 0;
+					break;
+				}
+			default:
+				Copy(Source);
+				Source.Reset();
+				break;
+			}
+		}
+
 		bool CodaScriptBackingStore::CompareString(CodaScriptStringParameterTypeT lhs, CodaScriptStringParameterTypeT rhs)
 		{
 			return _stricmp(lhs, rhs) == 0;
@@ -104,6 +149,12 @@ namespace bgsee
 			return StringData;
 		}
 
+		UInt32 CodaScriptBackingStore::GetStringLength() const
+		{
+			SME_ASSERT(IsString());
+			return StringLength;
+		}
+
 		ICodaScriptArrayDataType::SharedPtrT CodaScriptBackingStore::GetArray() const
 		{
 			SME_ASSERT(IsArray());
@@ -126,18 +177,77 @@ namespace bgsee
 
 		void CodaScriptBackingStore::SetString( CodaScriptStringParameterTypeT Data )
 		{
-			Reset();
-			Type = kDataType_String;
+			if (Data == nullptr)
+				Data = "";
 
+			SetString(Data, strlen(Data));
+		}
+
+		void CodaScriptBackingStore::SetString(CodaScriptStringParameterTypeT Data, UInt32 Length)
+		{
 			if (Data == nullptr)
+			{
 				Data = "";
+				Length = 0;
+			}
+
+			if (Type != kDataType_String)
+			{
+				Reset();
+				Type = kDataType_String;
+				StringData = InlineString;
+				StringCapacity = kInlineStringCapacity;
+			}
+
+			// the current buffer is retained if it's large enough
+			if (Length > StringCapacity)
+			{
+				// the source can't be a part of the current buffer as it's larger than the latter
+				CodaScriptStringDataTypeT Buffer = new CodaScriptCharDataTypeT[Length + 1];
+				memcpy(Buffer, Data, Length);
+
+				if (HasHeapString())
+					delete [] StringData;
+
+				StringData = Buffer;
+				StringCapacity = Length;
+			}
+			else if (Length)
+				memmove(StringData, Data, Length);		// the source could be a substring of the current value
+
+			StringData[Length] = '\0';
+			StringLength = Length;
+		}
+
+		void CodaScriptBackingStore::AppendString(CodaScriptStringParameterTypeT Data, UInt32 Length)
+		{
+			SME_ASSERT(Type == kDataType_String);
+
+			if (Data == nullptr || Length == 0)
+				return;
 
-			UInt32 Size = strlen(Data);
-			StringData = new CodaScriptCharDataTypeT[Size + 1];
+			UInt32 NewLength = StringLength + Length;
+			if (NewLength > StringCapacity)
+			{
+				// the capacity grows geometrically so that repeated appends take amortized linear time
+				UInt32 NewCapacity = max(NewLength, StringCapacity * 2);
+
+				// the source can be a part of the current value, so the old buffer is released last
+				CodaScriptStringDataTypeT Buffer = new CodaScriptCharDataTypeT[NewCapacity + 1];
+				memcpy(Buffer, StringData, StringLength);
+				memcpy(Buffer + StringLength, Data, Length);
+
+				if (HasHeapString())
+					delete [] StringData;
+
+				StringData = Buffer;
+				StringCapacity = NewCapacity;
+			}
+			else
+				memmove(StringData + StringLength, Data, Length);
 
-			StringData[Size] = '\0';
-			if (Size)
-				strcpy_s(StringData, Size + 1, Data);
+			StringData[NewLength] = '\0';
+			StringLength = NewLength;
 		}
 
 		void CodaScriptBackingStore::SetArray( ICodaScriptDataStore* Data )
@@ -205,7 +315,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore(CodaScriptBackingStore* Data)
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -213,7 +323,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore( CodaScriptNumericDataTypeT Num )
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -221,7 +331,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore( CodaScriptStringParameterTypeT Str )
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -229,7 +339,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore( CodaScriptReferenceDataTypeT Form )
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -237,7 +347,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore(ICodaScriptArrayDataType::SharedPtrT Array )
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -253,7 +363,7 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore( const CodaScriptBackingStore& rhs )
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 
@@ -261,17 +371,31 @@ namespace bgsee
 		}
 
 		CodaScriptBackingStore::CodaScriptBackingStore()
-			: ICodaScriptDataStore(), NumericData(0), ArrayData()
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
 		{
 			GIC++;
 		}
 
+		CodaScriptBackingStore::CodaScriptBackingStore(CodaScriptBackingStore&& rhs) noexcept
+			: ICodaScriptDataStore(), NumericData(0), ArrayData(), StringLength(0), StringCapacity(0), InlineString()
+		{
+			GIC++;
+
+			Move(rhs);
+		}
+
 		CodaScriptBackingStore& CodaScriptBackingStore::operator=( const CodaScriptBackingStore& rhs )
 		{
 			Copy(rhs);
 			return *this;
 		}
 
+		CodaScriptBackingStore& CodaScriptBackingStore::operator=(CodaScriptBackingStore&& rhs) noexcept
+		{
+			Move(rhs);
+			return *this;
+		}
+
 		ICodaScriptDataStore& CodaScriptBackingStore::operator=( const ICodaScriptDataStore& rhs )
 		{
 			SME_ASSERT(typeid(rhs) == typeid(CodaScriptBackingStore));
@@ -308,7 +432,7 @@ namespace bgsee
 					NumericData += rhs.NumericData;
 					break;
 				case kDataType_String:
-					SetString((std::string(std::string(StringData) + std::string(rhs.StringData))).c_str());
+					AppendString(rhs.StringData, rhs.StringLength);
 					break;
 				}
 			}
@@ -351,7 +475,7 @@ namespace bgsee
 			;//
 		}
 
-		int				CodaScriptVariable::GIC = 0;
+		std::atomic<int>				CodaScriptVariable::GIC(0);
 
 		CodaScriptVariable::CodaScriptVariable( CodaScriptSourceCodeT& Name, ICodaScriptDataStoreOwner* Storage ) :
 			Name(Name),
@@ -24,23 +24,33 @@ namespace bgsee
 			virtual void											Clear(void) = 0;
 
 			virtual bool											At(UInt32 Index, CodaScriptBackingStore& OutBuffer) const = 0;
+			virtual bool											At(UInt32 Index, ICodaScriptDataStoreOwner& OutValue) const = 0;		// assigns the element to the owner, cheaper than going through an intermediate store
+			virtual const CodaScriptBackingStore*					Peek(UInt32 Index) const = 0;		// returns a borrowed pointer to the element that's valid until the array is modified, nullptr if the index is out of bounds or the element is stored packed (use At() instead)
 			virtual UInt32											Size(void) const = 0;
+			virtual SharedPtrT										Clone(void) const = 0;		// shallow copy, nested arrays are shared with the source
 		};
 
 		class CodaScriptBackingStore : public ICodaScriptDataStore
 		{
-			static int								GIC;
+			static std::atomic<int>					GIC;
 		protected:
+			static const UInt32						kInlineStringCapacity = 23;		// excluding the terminator
+
 			union
 			{
 				CodaScriptNumericDataTypeT			NumericData;
 				CodaScriptReferenceDataTypeT		RefData;
-				CodaScriptStringDataTypeT			StringData;
+				CodaScriptStringDataTypeT			StringData;				// points to InlineString or a heap buffer
 			};
 			ICodaScriptArrayDataType::SharedPtrT	ArrayData;				// not a trivial data type, so can't be a part of the union
+			UInt32									StringLength;
+			UInt32									StringCapacity;			// excluding the terminator
+			CodaScriptCharDataTypeT					InlineString[kInlineStringCapacity + 1];
 
 			void									Reset(void);
 			void									Copy(const CodaScriptBackingStore& Source);
+			void									Move(CodaScriptBackingStore& Source);
+			bool									HasHeapString() const;
 
 			static bool								CompareString(CodaScriptStringParameterTypeT lhs, CodaScriptStringParameterTypeT rhs);
 			static bool								CompareNumber(const CodaScriptNumericDataTypeT& lhs, const CodaScriptNumericDataTypeT& rhs);
@@ -57,7 +67,9 @@ namespace bgsee
 			virtual ~CodaScriptBackingStore();
 
 			explicit CodaScriptBackingStore(const CodaScriptBackingStore& rhs);
+			CodaScriptBackingStore(CodaScriptBackingStore&& rhs) noexcept;
 			CodaScriptBackingStore& operator=(const CodaScriptBackingStore& rhs);
+			CodaScriptBackingStore& operator=(CodaScriptBackingStore&& rhs) noexcept;
 
 			CodaScriptBackingStore& operator+=(const CodaScriptBackingStore &rhs);
 			CodaScriptBackingStore& operator-=(const CodaScriptBackingStore &rhs);
@@ -68,11 +80,14 @@ namespace bgsee
 			virtual CodaScriptReferenceDataTypeT					GetFormID() const;
 			virtual CodaScriptNumericDataTypeT						GetNumber() const;
 			virtual CodaScriptStringParameterTypeT					GetString() const;
+			UInt32													GetStringLength() const;
 			ICodaScriptArrayDataType::SharedPtrT					GetArray() const;
 
 			virtual void											SetFormID(CodaScriptReferenceDataTypeT Data);
 			virtual void											SetNumber(CodaScriptNumericDataTypeT Data);
 			virtual void											SetString(CodaScriptStringParameterTypeT Data);
+			void													SetString(CodaScriptStringParameterTypeT Data, UInt32 Length);
+			void													AppendString(CodaScriptStringParameterTypeT Data, UInt32 Length);		// store must be a string
 			virtual void											SetArray(ICodaScriptDataStore* Data);					// ugly workaround for CRT state inconsistencies during runtime
 			void													SetArray(ICodaScriptArrayDataType::SharedPtrT Data);
 
@@ -82,7 +97,7 @@ namespace bgsee
 			virtual ICodaScriptDataStore&							operator=(CodaScriptReferenceDataTypeT Form);
 
 
-			static const int&										GetGIC() { return GIC; }
+			static int												GetGIC() { return GIC; }
 
 			virtual bool											operator ==(const ICodaScriptDataStore& rhs) const override;
 			virtual bool											operator ==(const CodaScriptNumericDataTypeT& rhs) const override;
@@ -94,7 +109,7 @@ namespace bgsee
 
 		class CodaScriptVariable
 		{
-			static int												GIC;
+			static std::atomic<int>									GIC;
 
 			CodaScriptVariable(const CodaScriptVariable& rhs);
 			CodaScriptVariable& operator=(const CodaScriptVariable& rhs);
@@ -109,7 +124,7 @@ namespace bgsee
 			void													SetName(CodaScriptSourceCodeT& Name);
 			ICodaScriptDataStoreOwner*								GetStoreOwner() const;
 
-			static const int&										GetGIC() { return GIC; }
+			static int												GetGIC() { return GIC; }
 
 			typedef std::vector<CodaScriptVariable*>				ArrayT;
 			typedef std::unique_ptr<CodaScriptVariable>				PtrT;
@@ -18,11 +18,13 @@ namespace bgsee
 		class CodaScriptAbstractSyntaxTree;
 		class ICodaScriptExpressionByteCode;
 		class ICodaScriptCompilerMetadata;
+		class ICodaScriptEvaluationState;
 		class ICodaScriptExecutionContext;
 		class ICodaScriptProgram;
 		class ICodaScriptBackgroundDaemon;
 		class ICodaScriptVirtualMachine;
 		class ICodaScriptExecutor;
+		class ICodaScriptAsyncResult;
 		class ICodaScriptProgramCache;
 
 		class CodaScriptVM;
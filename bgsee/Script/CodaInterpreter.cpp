@@ -22,10 +22,19 @@ namespace bgsee
 
 		CodaScriptVariable* CodaScriptExecutionContext::GetVariable(const char* Name) const
 		{
-			if (Variables.count(Name) == 0)
+			int Slot = Parent->GetVariableSlot(Name);
+			if (Slot == -1)
 				return nullptr;
 			else
-				return Variables.at(Name).get();
+				return GetVariableBySlot(Slot);
+		}
+
+		CodaScriptVariable* CodaScriptExecutionContext::GetVariableBySlot(UInt32 Slot) const
+		{
+			if (Slot >= Variables.size())
+				return nullptr;
+			else
+				return Variables[Slot].get();
 		}
 
 		CodaScriptExecutionContext::CodaScriptExecutionContext(ICodaScriptVirtualMachine* VM, ICodaScriptProgram* Parent) :
@@ -36,7 +45,15 @@ namespace bgsee
 			ElapsedTimeCounter(),
 			Result(),
 			HasReturned(false),
-			ExecutingLoops()
+			ExecutingLoops(),
+			HasTailCall(false),
+			TailCallParameters(),
+			TimeSlice(0.0),
+			TimeSliceUsed(0.0),
+			TimeSliceCounter(),
+			PreemptionChecks(0),
+			ResumePoints(),
+			EvaluationState()
 		{
 			SME_ASSERT(VM && Parent && Parent->IsValid());
 
@@ -46,10 +63,11 @@ namespace bgsee
 			CodaScriptVariableNameArrayT VarNames;
 			Parent->GetVariables(VarNames);
 
+			Variables.reserve(VarNames.size());
 			for (auto& Itr : VarNames)
 			{
 				CodaScriptVariable::PtrT Addend(new CodaScriptVariable(Itr, VM->BuildDataStoreOwner()));
-				Variables.insert(std::make_pair(Itr, std::move(Addend)));
+				Variables.push_back(std::move(Addend));
 			}
 		}
 
@@ -134,21 +152,44 @@ namespace bgsee
 				ExecutionState = kExecutionState_Break;
 		}
 
+		void CodaScriptExecutionContext::TailCall(CodaScriptBackingStore::NonPtrArrayT& Parameters)
+		{
+			if (Parameters.size() != Parent->GetParameterCount())
+				throw CodaScriptException("Incorrect number of parameters passed - Received %d, expected %d", Parameters.size(), Parent->GetParameterCount());
+
+			Return();
+
+			HasTailCall = true;
+			TailCallParameters = std::move(Parameters);
+		}
+
+		bool CodaScriptExecutionContext::RestartTailCall()
+		{
+			if (HasTailCall == false || ExecutionState != kExecutionState_Break)
+				return false;
+
+			CodaScriptBackingStore::NonPtrArrayT Parameters(std::move(TailCallParameters));
+			ResetState(true);
+			SetParameters(Parameters);
+
+			return true;
+		}
+
 		void CodaScriptExecutionContext::SetParameters(CodaScriptBackingStore::NonPtrArrayT& Parameters)
 		{
 			if (Parent->GetParameterCount() != Parameters.size())
 				throw CodaScriptException("Incorrect number of parameters passed - Received %d, expected %d", Parameters.size(), Parent->GetParameterCount());
 			else
 			{
-				CodaScriptVariableNameArrayT ParamNames;
-				Parent->GetParameters(ParamNames);
-
-				for (int i = 0; i < ParamNames.size(); i++)
+				for (int i = 0; i < Parameters.size(); i++)
 				{
-					CodaScriptSourceCodeT& Name = ParamNames.at(i);
-					CodaScriptVariable* ParamVar = GetVariable(Name);
+					CodaScriptVariable* ParamVar = nullptr;
+					int Slot = Parent->GetParameterSlot(i);
+					if (Slot != -1)
+						ParamVar = GetVariableBySlot(Slot);
+
 					if (ParamVar == nullptr)
-						throw CodaScriptException("Parameter variable '%s' not found", Name.c_str());
+						throw CodaScriptException("Parameter variable %d not found", i);
 
 					*ParamVar->GetStoreOwner() = Parameters.at(i);
 				}
@@ -241,14 +282,93 @@ namespace bgsee
 
 			ExecutionState = kExecutionState_Default;
 			PollingIntervalReminder = Parent->GetPollingInteval();
+			HasTailCall = false;
+			TailCallParameters.clear();
+			ResumePoints.clear();
 
 			if (ResetVars)
 			{
+				// a reset context is indistinguishable from a freshly created one
 				for (auto& Itr : Variables)
-					*Itr.second->GetStoreOwner() = Empty;
+					*Itr->GetStoreOwner() = Empty;
+
+				ElapsedTimeCounter.Update();
 			}
 		}
 
+		void CodaScriptExecutionContext::SetTimeSlice(double Milliseconds)
+		{
+			TimeSlice = Milliseconds;
+			TimeSliceUsed = 0.0;
+			TimeSliceCounter.Update();
+			PreemptionChecks = 0;
+		}
+
+		bool CodaScriptExecutionContext::Preempt()
+		{
+			if (TimeSlice <= 0.0 || ExecutionState != kExecutionState_Default)
+				return false;
+
+			// reading the clock costs more than most statements, the time passed in between is picked up by the next sample
+			if (++PreemptionChecks < kPreemptionSampleInterval)
+				return false;
+
+			PreemptionChecks = 0;
+			TimeSliceCounter.Update();
+			TimeSliceUsed += TimeSliceCounter.GetTimePassed();
+			if (TimeSliceUsed < TimeSlice)
+				return false;
+
+			SME_ASSERT(ResumePoints.empty());
+			ExecutionState = kExecutionState_Suspended;
+			return true;
+		}
+
+		bool CodaScriptExecutionContext::IsSuspended() const
+		{
+			return ExecutionState == kExecutionState_Suspended;
+		}
+
+		void CodaScriptExecutionContext::Resume()
+		{
+			SME_ASSERT(IsSuspended() && ResumePoints.size());
+			ExecutionState = kExecutionState_Default;
+		}
+
+		bool CodaScriptExecutionContext::IsResuming() const
+		{
+			return ExecutionState == kExecutionState_Default && ResumePoints.size();
+		}
+
+		void CodaScriptExecutionContext::SaveResumePoint(const CodaScriptResumePoint& Point)
+		{
+			SME_ASSERT(IsSuspended() && Point.Code);
+			ResumePoints.push_back(Point);
+		}
+
+		bool CodaScriptExecutionContext::RestoreResumePoint(ICodaScriptExecutableCode* Code, CodaScriptResumePoint& OutPoint)
+		{
+			SME_ASSERT(IsResuming());
+
+			// the outermost block was saved last
+			if (ResumePoints.back().Code != Code)
+				return false;
+
+			OutPoint = std::move(ResumePoints.back());
+			ResumePoints.pop_back();
+			return true;
+		}
+
+		ICodaScriptEvaluationState* CodaScriptExecutionContext::GetEvaluationState() const
+		{
+			return EvaluationState.get();
+		}
+
+		void CodaScriptExecutionContext::SetEvaluationState(ICodaScriptEvaluationState* State)
+		{
+			EvaluationState.reset(State);
+		}
+
 		bool CodaScriptSyntaxTreeExecuteVisitor::EvaluateCondition(ICodaScriptConditionalCodeBlock* Block)
 		{
 			CodaScriptBackingStore Result;
@@ -263,7 +383,8 @@ namespace bgsee
 		CodaScriptSyntaxTreeExecuteVisitor::CodaScriptSyntaxTreeExecuteVisitor(ICodaScriptVirtualMachine* VM,
 																			   ICodaScriptExecutionContext* Context) :
 			ICodaScriptSyntaxTreeEvaluator(VM, VM->GetParser(), Context),
-			CurrentCode()
+			CurrentCode(),
+			Profiler(nullptr)
 		{
 			SME_ASSERT(Context->GetProgram()->GetBoundParser() == Parser);
 		}
@@ -272,9 +393,17 @@ namespace bgsee
 #define CODASCRIPT_EXECUTEHNDLR_PROLOG										\
 			ScopedFunctor CodeSentinel([&Node, this](ScopedFunctor::Event e) {	\
 				if (e == ScopedFunctor::Event::Construction)				\
+				{															\
 					CurrentCode.push(Node);									\
+					if (Profiler)											\
+						Profiler->EnterCode(Node);							\
+				}															\
 				else														\
+				{															\
+					if (Profiler)											\
+						Profiler->LeaveCode();								\
 					CurrentCode.pop();										\
+				}															\
 				});															\
 			try																\
 			{																\
@@ -304,8 +433,19 @@ namespace bgsee
 
 		void CodaScriptSyntaxTreeExecuteVisitor::Visit( CodaScriptExpression* Node )
 		{
+			CodaScriptResumePoint Resumed;
+			if (Context->IsResuming() && Context->RestoreResumePoint(Node, Resumed) == false)
+				return;
+
 			CODASCRIPT_EXECUTEHNDLR_PROLOG
 
+			// statement boundary, the resumed statement always executes to guarantee progress
+			if (Resumed.Code == nullptr && Context->Preempt())
+			{
+				Context->SaveResumePoint(CodaScriptResumePoint(Node));
+				return;
+			}
+
 			Parser->Evaluate(this, Node->GetByteCode());
 
 			CODASCRIPT_EXECUTEHNDLR_EPILOG
@@ -320,28 +460,37 @@ namespace bgsee
 
 		void CodaScriptSyntaxTreeExecuteVisitor::Visit( CodaScriptIFBlock* Node )
 		{
+			CodaScriptResumePoint Resumed;
+			if (Context->IsResuming() && Context->RestoreResumePoint(Node, Resumed) == false)
+				return;
+
 			CODASCRIPT_EXECUTEHNDLR_PROLOG
 
-			if (EvaluateCondition(Node))
-			{
-				Node->Traverse(this);
-				return;
-			}
-			else
+			// 0 = IF, 1...n = ELSEIF, n + 1 = ELSE
+			const CodaScriptIFBlock::ElseIfBlockArrayT& ElseIfBlocks = Node->GetElseIfBlocks();
+			UInt32 Branch = 0;
+
+			if (Resumed.Code)
+				Branch = Resumed.Counter;
+			else if (EvaluateCondition(Node) == false)
 			{
-				for (auto Itr : Node->GetElseIfBlocks())
+				for (Branch = 1; Branch <= ElseIfBlocks.size(); Branch++)
 				{
-					if (EvaluateCondition(Itr))
-					{
-						Itr->Accept(this);
-						return;
-					}
+					if (EvaluateCondition(ElseIfBlocks[Branch - 1]))
+						break;
 				}
 			}
 
-			if (Node->HasElseBlock())
+			if (Branch == 0)
+				Node->Traverse(this);
+			else if (Branch <= ElseIfBlocks.size())
+				ElseIfBlocks[Branch - 1]->Accept(this);
+			else if (Node->HasElseBlock())
 				Node->GetElseBlock().Accept(this);
 
+			if (Context->IsSuspended())
+				Context->SaveResumePoint(CodaScriptResumePoint(Node, Branch));
+
 			CODASCRIPT_EXECUTEHNDLR_EPILOG
 
 			CODASCRIPT_EXECUTEERROR_CATCHER
@@ -359,6 +508,10 @@ namespace bgsee
 
 		void CodaScriptSyntaxTreeExecuteVisitor::Visit( CodaScriptWHILEBlock* Node )
 		{
+			CodaScriptResumePoint Resumed;
+			if (Context->IsResuming() && Context->RestoreResumePoint(Node, Resumed) == false)
+				return;
+
 			CODASCRIPT_EXECUTEHNDLR_PROLOG
 
 			ScopedFunctor LoopSentinel([Node, this](ScopedFunctor::Event e) {
@@ -367,17 +520,40 @@ namespace bgsee
 				else
 					Context->EndLoop(Node);
 			});
-			UInt32 IterationCounter = 0;
+			UInt32 IterationCounter = Resumed.Counter;
+			bool ResumeBody = Resumed.Code && Resumed.BackEdge == false;
 
-			while (EvaluateCondition(Node))
+			while (true)
 			{
-				IterationCounter++;
-				if (IterationCounter >= kLoopOverrunLimit)
-					throw CodaScriptException(Node, "Loop overrun - When will it ennnnnnd?!");
+				// a loop suspended inside its body picks up the same iteration without reevaluating the condition
+				if (ResumeBody)
+					ResumeBody = false;
+				else
+				{
+					if (EvaluateCondition(Node) == false)
+						break;
+
+					IterationCounter++;
+					if (IterationCounter >= kLoopOverrunLimit)
+						throw CodaScriptException(Node, "Loop overrun - When will it ennnnnnd?!");
+				}
 
 				Node->Traverse(this);
+				if (Context->IsSuspended())
+				{
+					Context->SaveResumePoint(CodaScriptResumePoint(Node, IterationCounter));
+					return;
+				}
+
 				if (Context->EvaluateLoop() == false)
 					break;
+
+				// back-edge
+				if (Context->Preempt())
+				{
+					Context->SaveResumePoint(CodaScriptResumePoint(Node, IterationCounter, true));
+					return;
+				}
 			}
 
 			CODASCRIPT_EXECUTEHNDLR_EPILOG
@@ -387,6 +563,10 @@ namespace bgsee
 
 		void CodaScriptSyntaxTreeExecuteVisitor::Visit( CodaScriptFOREACHBlock* Node )
 		{
+			CodaScriptResumePoint Resumed;
+			if (Context->IsResuming() && Context->RestoreResumePoint(Node, Resumed) == false)
+				return;
+
 			CODASCRIPT_EXECUTEHNDLR_PROLOG
 
 			ScopedFunctor LoopSentinel([Node, this](ScopedFunctor::Event e) {
@@ -395,32 +575,82 @@ namespace bgsee
 				else
 					Context->EndLoop(Node);
 			});
-			const CodaScriptSourceCodeT& IteratorName = Node->GetIteratorName();
-			CodaScriptVariable* Iterator = Context->GetVariable(IteratorName);
+			CodaScriptVariable* Iterator = Context->GetVariableBySlot(Node->GetIteratorSlot());
 			SME_ASSERT(Iterator);
 
-			CodaScriptBackingStore ArrayResult((CodaScriptNumericDataTypeT)0),
-								IteratorBuffer((CodaScriptNumericDataTypeT)0),
-								IteratorContents;
+			CodaScriptBackingStore IteratorContents;
+			ICodaScriptArrayDataType::SharedPtrT ArrayInstance;
+			int Start = 0;
+			bool ResumeBody = false;
+
+			if (Resumed.Code)
+			{
+				// the array expression isn't reevaluated, iteration continues over the same instance
+				ArrayInstance = Resumed.Collection;
+				IteratorContents = Resumed.Saved;
+				Start = Resumed.Counter;
+				ResumeBody = Resumed.BackEdge == false;
+			}
+			else
+			{
+				CodaScriptBackingStore ArrayResult((CodaScriptNumericDataTypeT)0);
+
+				IteratorContents = *Iterator->GetStoreOwner()->GetDataStore();
+				Parser->Evaluate(this, Node->GetByteCode(), &ArrayResult);
 
-			IteratorContents = *Iterator->GetStoreOwner()->GetDataStore();
-			Parser->Evaluate(this, Node->GetByteCode(), &ArrayResult);
+				if (ArrayResult.GetType() != ICodaScriptDataStore::kDataType_Array)
+					throw CodaScriptException(Node, "Invalid expression - Non-array result");
 
-			if (ArrayResult.GetType() != ICodaScriptDataStore::kDataType_Array)
-				throw CodaScriptException(Node, "Invalid expression - Non-array result");
+				ArrayInstance = ArrayResult.GetArray();
+			}
 
-			ICodaScriptArrayDataType::SharedPtrT ArrayInstance(ArrayResult.GetArray());
+			CodaScriptBackingStore PackedElement;
 
-			for (int i = 0, j = ArrayInstance->Size(); i < j; i++)
+			for (int i = Start, j = ArrayInstance->Size(); i < j; i++)
 			{
-				if (ArrayInstance->At(i, IteratorBuffer) == false)
-					throw CodaScriptException(Node, "Index operator error - I[%d] S[%d]", i, ArrayInstance->Size());
+				// a loop suspended inside its body resumes the same iteration, the iterator still holds its element
+				if (ResumeBody)
+					ResumeBody = false;
+				else
+				{
+					// the element is borrowed and copied straight into the iterator, whose buffers are reused between iterations
+					// packed numeric/reference elements have no backing store of their own and are unpacked into a scratch buffer instead
+					const CodaScriptBackingStore* Element = ArrayInstance->Peek(i);
+					if (Element == nullptr)
+					{
+						if (ArrayInstance->At(i, PackedElement) == false)
+							throw CodaScriptException(Node, "Index operator error - I[%d] S[%d]", i, ArrayInstance->Size());
 
-				*Iterator->GetStoreOwner() = IteratorBuffer;
+						Element = &PackedElement;
+					}
+
+					*Iterator->GetStoreOwner() = *Element;
+				}
 
 				Node->Traverse(this);
+				if (Context->IsSuspended())
+				{
+					CodaScriptResumePoint Suspended(Node, i);
+					Suspended.Collection = ArrayInstance;
+					Suspended.Saved = IteratorContents;
+
+					Context->SaveResumePoint(Suspended);
+					return;
+				}
+
 				if (Context->EvaluateLoop() == false)
 					break;
+
+				// back-edge
+				if (i + 1 < j && Context->Preempt())
+				{
+					CodaScriptResumePoint Suspended(Node, i + 1, true);
+					Suspended.Collection = ArrayInstance;
+					Suspended.Saved = IteratorContents;
+
+					Context->SaveResumePoint(Suspended);
+					return;
+				}
 			}
 
 			*Iterator->GetStoreOwner() = IteratorContents;
@@ -438,6 +668,11 @@ namespace bgsee
 				return CurrentCode.top();
 		}
 
+		void CodaScriptSyntaxTreeExecuteVisitor::SetProfiler(CodaScriptProfiler* Profiler)
+		{
+			this->Profiler = Profiler;
+		}
+
 		CodaScriptCommandHandlerUtilities::CodaScriptCommandHandlerUtilities(ICodaScriptVirtualMachine* VM) :
 			ICodaScriptCommandHandlerHelper(),
 			VM(VM),
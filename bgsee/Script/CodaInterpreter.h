@@ -36,6 +36,9 @@ namespace bgsee
 				bool HasResult() const { return Result != nullptr; }
 			};
 
+			typedef std::vector<CodaScriptBackingStore::NonPtrArrayT>		BatchParameterArrayT;		// one parameter set per execution
+			typedef std::vector<ExecuteResult>								BatchResultArrayT;			// index = parameter set
+
 			virtual const ResourceLocation&				GetScriptRepository() const = 0;
 			virtual const std::string&					GetScriptFileExtension() const = 0;
 
@@ -50,6 +53,13 @@ namespace bgsee
 
 			virtual bool								IsProgramExecuting(ICodaScriptProgram* Program) const = 0;
 			virtual void								RunScript(ExecuteParams& Input, ExecuteResult& Output) = 0;
+			virtual std::shared_ptr<ICodaScriptAsyncResult>	RunScriptAsync(ExecuteParams& Input) = 0;		// executes a thread-safe program on a worker thread, returns nullptr if it couldn't be queued
+																											// array parameters are copied, changes made to them by the script aren't visible to the caller
+			virtual void								RunBatch(ICodaScriptProgram* Program,
+																 BatchParameterArrayT& Parameters,
+																 BatchResultArrayT& OutResults) = 0;		// executes the program once per parameter set and blocks until all executions complete
+																											// thread-safe programs are spread across the worker threads. must be called on the main thread
+																											// array parameters are copied for every input, changes made to them by the script aren't visible to the caller or the other inputs
 		};
 
 		class ICodaScriptExecutor
@@ -67,6 +77,20 @@ namespace bgsee
 			typedef std::unique_ptr<ICodaScriptExecutor>		PtrT;
 		};
 
+		// handle to a script executing on a worker thread
+		class ICodaScriptAsyncResult
+		{
+		public:
+			virtual ~ICodaScriptAsyncResult() = 0 {}
+
+			virtual bool												IsReady() const = 0;
+			virtual bool												Wait(UInt32 Timeout = INFINITE) = 0;		// in milliseconds, returns true if the execution has completed
+			virtual const ICodaScriptVirtualMachine::ExecuteResult&		Get() = 0;		// blocks until the execution completes. the messages logged by the script are replayed on the first call,
+																						// so this must be called on the main thread
+
+			typedef std::shared_ptr<ICodaScriptAsyncResult>		PtrT;
+		};
+
 		class ICodaScriptBackgroundDaemon
 		{
 		public:
@@ -93,11 +117,27 @@ namespace bgsee
 			virtual ~ICodaScriptProgramCache() = 0 {}
 
 			virtual ICodaScriptProgram*			Get(const ResourceLocation& Filepath, bool Recompile = false) = 0;		// returns a nullptr if no valid script was found
+			virtual void						Get(const std::vector<ResourceLocation>& Filepaths,
+													std::vector<ICodaScriptProgram*>& OutPrograms,
+													bool Recompile = false) = 0;												// compiles the scripts concurrently, same order and semantics as above
 			virtual void						Invalidate() = 0;
 
 			typedef std::unique_ptr<ICodaScriptProgramCache>		PtrT;
 		};
 
+		// the state of a block (or statement) that was executing when its script was preempted
+		struct CodaScriptResumePoint
+		{
+			ICodaScriptExecutableCode*				Code;
+			UInt32									Counter;		// index of the taken branch for conditional blocks, current iteration for loops
+			bool									BackEdge;		// loops only, set if the execution was suspended between iterations
+			ICodaScriptArrayDataType::SharedPtrT	Collection;		// FOREACH only, the array being iterated
+			CodaScriptBackingStore					Saved;			// FOREACH only, the value of the iterator before the loop
+
+			CodaScriptResumePoint(ICodaScriptExecutableCode* Code = nullptr, UInt32 Counter = 0, bool BackEdge = false) :
+				Code(Code), Counter(Counter), BackEdge(BackEdge), Collection(), Saved() {}
+		};
+
 		class ICodaScriptExecutionContext
 		{
 		public:
@@ -115,11 +155,14 @@ namespace bgsee
 
 			virtual CodaScriptVariable*					GetVariable(const CodaScriptSourceCodeT& Name) const = 0;
 			virtual CodaScriptVariable*					GetVariable(const char* Name) const = 0;
+			virtual CodaScriptVariable*					GetVariableBySlot(UInt32 Slot) const = 0;		// slots are resolved by ICodaScriptProgram::GetVariableSlot()
 
 			virtual const CodaScriptBackingStore&		GetResult() const = 0;
 			virtual bool								HasResult() const = 0;
 
 			virtual void								Return(CodaScriptBackingStore* Result = nullptr, bool EOL = false) = 0;		// breaks execution
+			virtual void								TailCall(CodaScriptBackingStore::NonPtrArrayT& Parameters) = 0;			// breaks execution, the executor then restarts the program with the parameters
+			virtual bool								RestartTailCall() = 0;		// returns true if a tail call is pending, after resetting the context and binding the call's parameters
 
 			virtual void								SetParameters(CodaScriptBackingStore::NonPtrArrayT& Parameters) = 0;
 
@@ -131,6 +174,20 @@ namespace bgsee
 
 			virtual void								ResetState(bool ResetVars = false) = 0;		// resets the context's mutable state
 
+			// cooperative scheduling - executions with a time slice suspend themselves at a statement boundary or loop iteration shortly
+			// after the slice is used up (the clock is only sampled periodically). the next execution then skips ahead to the point of suspension
+			virtual void								SetTimeSlice(double Milliseconds) = 0;			// applies to the next execution, zero disables preemption
+			virtual bool								Preempt() = 0;									// suspends the execution and returns true if the time slice has been used up
+			virtual bool								IsSuspended() const = 0;
+			virtual void								Resume() = 0;									// clears the suspended state, the resume points are restored as execution reaches them
+			virtual bool								IsResuming() const = 0;							// returns true while execution is skipping ahead to the point of suspension
+			virtual void								SaveResumePoint(const CodaScriptResumePoint& Point) = 0;		// called innermost first, as the suspended execution unwinds
+			virtual bool								RestoreResumePoint(ICodaScriptExecutableCode* Code, CodaScriptResumePoint& OutPoint) = 0;		// returns false if the code isn't on the path to the point of suspension
+
+			// owned by the context and retained across executions, so that a context that's reused doesn't need to allocate it again
+			virtual ICodaScriptEvaluationState*			GetEvaluationState() const = 0;
+			virtual void								SetEvaluationState(ICodaScriptEvaluationState* State) = 0;		// takes ownership of the pointer
+
 			typedef std::unique_ptr<ICodaScriptExecutionContext>	PtrT;
 			typedef std::stack<ICodaScriptExecutionContext*>		StackT;
 		};
@@ -143,7 +200,8 @@ namespace bgsee
 				kExecutionState_Default = 0,				// normal execution
 				kExecutionState_Break,						// break execution without error; set by the return, break and continue commands
 				kExecutionState_Terminate,					// break execution with error
-				kExecutionState_End							// break execution without error; special case, signifies EOL
+				kExecutionState_End,						// break execution without error; special case, signifies EOL
+				kExecutionState_Suspended					// break execution without error; preempted by the scheduler, resumes from the same point in the next execution
 			};
 
 			struct LoopInfo
@@ -153,17 +211,27 @@ namespace bgsee
 			};
 
 			typedef std::stack<LoopInfo>		LoopStackT;
-			typedef std::unordered_map<CodaScriptSourceCodeT,
-				CodaScriptVariable::PtrT>		VarMapT;		// key = name, value = variable
+			typedef std::vector<CodaScriptVariable::PtrT>		VarSlotArrayT;		// index = variable slot
+			typedef std::vector<CodaScriptResumePoint>			ResumePointArrayT;	// innermost first
+
+			static const UInt32					kPreemptionSampleInterval = 32;		// number of preemption checks between reads of the clock
 
 			ICodaScriptProgram*					Parent;
-			VarMapT								Variables;
+			VarSlotArrayT						Variables;
 			UInt8								ExecutionState;
 			double								PollingIntervalReminder;
 			CodaScriptElapsedTimeCounterT		ElapsedTimeCounter;
 			CodaScriptBackingStore				Result;
 			bool								HasReturned;
 			LoopStackT							ExecutingLoops;
+			bool								HasTailCall;
+			CodaScriptBackingStore::NonPtrArrayT	TailCallParameters;
+			double								TimeSlice;
+			double								TimeSliceUsed;
+			CodaScriptElapsedTimeCounterT		TimeSliceCounter;
+			UInt32								PreemptionChecks;
+			ResumePointArrayT					ResumePoints;
+			ICodaScriptEvaluationState::PtrT	EvaluationState;
 		public:
 			CodaScriptExecutionContext(ICodaScriptVirtualMachine* VM, ICodaScriptProgram* Parent);
 			virtual ~CodaScriptExecutionContext();
@@ -183,9 +251,12 @@ namespace bgsee
 			virtual bool								HasResult() const override;
 
 			virtual void								Return(CodaScriptBackingStore* Result = nullptr, bool EOL = false) override;
+			virtual void								TailCall(CodaScriptBackingStore::NonPtrArrayT& Parameters) override;
+			virtual bool								RestartTailCall() override;
 
 			virtual CodaScriptVariable*					GetVariable(const CodaScriptSourceCodeT& Name) const override;
 			virtual CodaScriptVariable*					GetVariable(const char* Name) const override;
+			virtual CodaScriptVariable*					GetVariableBySlot(UInt32 Slot) const override;
 
 			virtual void								SetParameters(CodaScriptBackingStore::NonPtrArrayT& Parameters) override;
 
@@ -196,6 +267,17 @@ namespace bgsee
 			virtual void								EndLoop(ICodaScriptLoopBlock* Block) override;
 
 			virtual void								ResetState(bool ResetVars = false) override;
+
+			virtual void								SetTimeSlice(double Milliseconds) override;
+			virtual bool								Preempt() override;
+			virtual bool								IsSuspended() const override;
+			virtual void								Resume() override;
+			virtual bool								IsResuming() const override;
+			virtual void								SaveResumePoint(const CodaScriptResumePoint& Point) override;
+			virtual bool								RestoreResumePoint(ICodaScriptExecutableCode* Code, CodaScriptResumePoint& OutPoint) override;
+
+			virtual ICodaScriptEvaluationState*			GetEvaluationState() const override;
+			virtual void								SetEvaluationState(ICodaScriptEvaluationState* State) override;
 		};
 
 		class CodaScriptSyntaxTreeExecuteVisitor : public ICodaScriptSyntaxTreeEvaluator
@@ -203,6 +285,7 @@ namespace bgsee
 			static const UInt32					kLoopOverrunLimit = 0xFFFFFF;
 
 			ICodaScriptExecutableCode::StackT	CurrentCode;		// code being evaluated currently
+			CodaScriptProfiler*					Profiler;			// instruments each line of code if set
 
 			bool								EvaluateCondition(ICodaScriptConditionalCodeBlock* Block);
 		public:
@@ -218,6 +301,7 @@ namespace bgsee
 			virtual void						Visit(CodaScriptFOREACHBlock* Node) override;
 
 			ICodaScriptExecutableCode*			GetCurrentCode() const;
+			void								SetProfiler(CodaScriptProfiler* Profiler);
 		};
 
 
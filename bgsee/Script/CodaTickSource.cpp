@@ -0,0 +1,202 @@
+#include "CodaTickSource.h"
+#include "..\Main.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		VOID CALLBACK CodaScriptWin32TickSource::CallbackProc( HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime )
+		{
+			CodaScriptWin32TickSource* Source = (CodaScriptWin32TickSource*)idEvent;
+			Source->Handler();
+		}
+
+		CodaScriptWin32TickSource::CodaScriptWin32TickSource() :
+			TimerDummyWindow(NULL),
+			Handler(),
+			Running(false)
+		{
+			const char* ClassName = "BACKGROUNDER_TIMER_WINDOW";
+			WNDCLASSEX wx = {};
+			wx.cbSize = sizeof(WNDCLASSEX);
+			wx.lpfnWndProc = [](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) { return DefWindowProc(hWnd, uMsg, wParam, lParam); };
+			wx.hInstance = BGSEEMAIN->GetExtenderHandle();
+			wx.lpszClassName = ClassName;
+
+			// the class outlives its windows, so it's only registered by the first instance
+			if (RegisterClassEx(&wx) == 0)
+				SME_ASSERT(GetLastError() == ERROR_CLASS_ALREADY_EXISTS);
+
+			TimerDummyWindow = CreateWindowEx(0, ClassName, ClassName, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, NULL, NULL);
+			SME_ASSERT(TimerDummyWindow);
+		}
+
+		CodaScriptWin32TickSource::~CodaScriptWin32TickSource()
+		{
+			Stop();
+			DestroyWindow(TimerDummyWindow);
+		}
+
+		void CodaScriptWin32TickSource::Start(UInt32 Period, TickHandlerT Handler)
+		{
+			SME_ASSERT(Handler);
+
+			Stop();
+			this->Handler = Handler;
+
+			UINT_PTR Result = SetTimer(TimerDummyWindow, (UINT_PTR)this, Period, &CallbackProc);
+			SME_ASSERT(Result);
+			Running = true;
+		}
+
+		void CodaScriptWin32TickSource::Stop()
+		{
+			if (Running)
+				KillTimer(TimerDummyWindow, (UINT_PTR)this);
+
+			Running = false;
+		}
+
+		bool CodaScriptWin32TickSource::IsRunning() const
+		{
+			return Running;
+		}
+
+		double CodaScriptWin32TickSource::GetTime() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		CodaScriptMonotonicTickSource::CodaScriptMonotonicTickSource() :
+			Epoch(ClockT::now()),
+			Period(0),
+			Handler(),
+			NextTick(0),
+			Running(false)
+		{
+			;//
+		}
+
+		CodaScriptMonotonicTickSource::~CodaScriptMonotonicTickSource()
+		{
+			Stop();
+		}
+
+		void CodaScriptMonotonicTickSource::Start(UInt32 Period, TickHandlerT Handler)
+		{
+			SME_ASSERT(Handler);
+
+			this->Period = Period ? Period : 1;
+			this->Handler = Handler;
+			NextTick = GetTime() + this->Period;
+			Running = true;
+		}
+
+		void CodaScriptMonotonicTickSource::Stop()
+		{
+			Running = false;
+		}
+
+		bool CodaScriptMonotonicTickSource::IsRunning() const
+		{
+			return Running;
+		}
+
+		double CodaScriptMonotonicTickSource::GetTime() const
+		{
+			return std::chrono::duration<double, std::milli>(ClockT::now() - Epoch).count();
+		}
+
+		UInt32 CodaScriptMonotonicTickSource::Run(double Duration)
+		{
+			UInt32 Ticks = 0;
+			double End = GetTime() + Duration;
+
+			while (Running)
+			{
+				double Now = GetTime();
+				if (NextTick > End)
+					break;
+				else if (Now < NextTick)
+				{
+					// sleep through most of the wait, the scheduler's granularity makes it unsuitable for the last stretch
+					double Wait = NextTick - Now;
+					if (Wait > 2.0)
+						std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(Wait - 1.0));
+					else
+						std::this_thread::yield();
+
+					continue;
+				}
+
+				// ticks that were missed while the handler was busy are dropped, same as with a message loop timer
+				while (NextTick <= Now)
+					NextTick += Period;
+
+				Handler();
+				Ticks++;
+			}
+
+			return Ticks;
+		}
+
+		CodaScriptVirtualTickSource::CodaScriptVirtualTickSource() :
+			Now(0),
+			Period(0),
+			Handler(),
+			NextTick(0),
+			Running(false)
+		{
+			;//
+		}
+
+		CodaScriptVirtualTickSource::~CodaScriptVirtualTickSource()
+		{
+			Stop();
+		}
+
+		void CodaScriptVirtualTickSource::Start(UInt32 Period, TickHandlerT Handler)
+		{
+			SME_ASSERT(Handler);
+
+			this->Period = Period ? Period : 1;
+			this->Handler = Handler;
+			NextTick = Now + this->Period;
+			Running = true;
+		}
+
+		void CodaScriptVirtualTickSource::Stop()
+		{
+			Running = false;
+		}
+
+		bool CodaScriptVirtualTickSource::IsRunning() const
+		{
+			return Running;
+		}
+
+		double CodaScriptVirtualTickSource::GetTime() const
+		{
+			return Now;
+		}
+
+		UInt32 CodaScriptVirtualTickSource::Advance(double Duration)
+		{
+			UInt32 Ticks = 0;
+			double End = Now + Duration;
+
+			// the clock stops at each deadline, so the handler observes the exact period
+			while (Running && NextTick <= End)
+			{
+				Now = NextTick;
+				NextTick += Period;
+
+				Handler();
+				Ticks++;
+			}
+
+			Now = End;
+			return Ticks;
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "CodaUtilities.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		// drives the periodic updates of the backgrounder
+		class ICodaScriptTickSource
+		{
+		public:
+			typedef std::function<void()>		TickHandlerT;
+
+			virtual ~ICodaScriptTickSource() = 0 {}
+
+			virtual void					Start(UInt32 Period, TickHandlerT Handler) = 0;		// period in milliseconds, restarts the schedule if already running
+			virtual void					Stop() = 0;
+			virtual bool					IsRunning() const = 0;
+			virtual double					GetTime() const = 0;								// in milliseconds, monotonic
+
+			typedef std::unique_ptr<ICodaScriptTickSource>		PtrT;
+		};
+
+		// ticks from a Win32 timer, dispatched by the thread's message loop
+		class CodaScriptWin32TickSource : public ICodaScriptTickSource
+		{
+			static VOID CALLBACK			CallbackProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+
+			HWND							TimerDummyWindow;
+			TickHandlerT					Handler;
+			bool							Running;
+		public:
+			CodaScriptWin32TickSource();
+			virtual ~CodaScriptWin32TickSource();
+
+			virtual void					Start(UInt32 Period, TickHandlerT Handler) override;
+			virtual void					Stop() override;
+			virtual bool					IsRunning() const override;
+			virtual double					GetTime() const override;
+		};
+
+		// headless source that follows a high-resolution monotonic clock
+		// ticks are only fired from inside Run(), which blocks the calling thread
+		class CodaScriptMonotonicTickSource : public ICodaScriptTickSource
+		{
+			typedef std::chrono::steady_clock	ClockT;
+
+			ClockT::time_point				Epoch;
+			UInt32							Period;
+			TickHandlerT					Handler;
+			double							NextTick;
+			bool							Running;
+		public:
+			CodaScriptMonotonicTickSource();
+			virtual ~CodaScriptMonotonicTickSource();
+
+			virtual void					Start(UInt32 Period, TickHandlerT Handler) override;
+			virtual void					Stop() override;
+			virtual bool					IsRunning() const override;
+			virtual double					GetTime() const override;
+
+			UInt32							Run(double Duration);		// in milliseconds, returns the number of ticks fired. ticks that are missed are dropped
+		};
+
+		// headless source with a virtual clock that only moves when advanced, for deterministic simulations
+		class CodaScriptVirtualTickSource : public ICodaScriptTickSource
+		{
+			double							Now;
+			UInt32							Period;
+			TickHandlerT					Handler;
+			double							NextTick;
+			bool							Running;
+		public:
+			CodaScriptVirtualTickSource();
+			virtual ~CodaScriptVirtualTickSource();
+
+			virtual void					Start(UInt32 Period, TickHandlerT Handler) override;
+			virtual void					Stop() override;
+			virtual bool					IsRunning() const override;
+			virtual double					GetTime() const override;
+
+			UInt32							Advance(double Duration);	// in milliseconds, fires every tick that falls due on the way. returns the number of ticks fired
+		};
+	}
+}
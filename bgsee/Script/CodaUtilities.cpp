@@ -6,16 +6,16 @@ namespace bgsee
 {
 	namespace script
 	{
-		bool CodaScriptTokenizer::IsIndexStringLiteral(const CodaScriptSourceCodeT& Source, int Index)
+		bool CodaScriptTokenizer::IsIndexStringLiteral(const char* Source, UInt32 Length, int Index)
 		{
-			if (Index >= Source.length())
+			if (Index < 0 || static_cast<UInt32>(Index) >= Length)
 				return false;
 
 			int QuoteStack = 0;
 			int Idx = 0;
-			for (char Itr : Source)
+			for (const char* Itr = Source; Itr != Source + Length; ++Itr)
 			{
-				if (Itr == '"')
+				if (*Itr == '"')
 				{
 					if (QuoteStack == 0)
 						QuoteStack++;
@@ -37,8 +37,11 @@ namespace bgsee
 		const CodaScriptSourceCodeT				CodaScriptTokenizer::kWhitespace = " \t";
 		const CodaScriptSourceCodeT				CodaScriptTokenizer::kCommentDelimiter = ";";
 		const CodaScriptSourceCodeT				CodaScriptTokenizer::kValidDelimiters = kCommentDelimiter + kWhitespace + ".,(){}[]\n";
+		const CodaScriptTokenizer::CharacterClassTableT	CodaScriptTokenizer::kCharacterClasses = CodaScriptTokenizer::BuildCharacterClassTable();
 		const UInt32							CodaScriptTokenizer::kCodaKeywordCount = 15 + 1;
-		const CodaScriptSourceCodeT				CodaScriptTokenizer::kCodaKeywordArray[kCodaKeywordCount] =
+
+		// indexed by the keyword's bit position in CodaScriptKeywordT
+		static constexpr const char*			kCodaKeywordLiterals[] =
 		{
 			"<UNKNOWN>",
 			"VAR",
@@ -58,7 +61,114 @@ namespace bgsee
 			"BREAK"
 		};
 
-		CodaScriptTokenizer::CodaScriptTokenizer()
+		const CodaScriptSourceCodeT				CodaScriptTokenizer::kCodaKeywordArray[kCodaKeywordCount] =
+		{
+			kCodaKeywordLiterals[0],
+			kCodaKeywordLiterals[1],
+			kCodaKeywordLiterals[2],
+			kCodaKeywordLiterals[3],
+			kCodaKeywordLiterals[4],
+			kCodaKeywordLiterals[5],
+			kCodaKeywordLiterals[6],
+			kCodaKeywordLiterals[7],
+			kCodaKeywordLiterals[8],
+			kCodaKeywordLiterals[9],
+			kCodaKeywordLiterals[10],
+			kCodaKeywordLiterals[11],
+			kCodaKeywordLiterals[12],
+			kCodaKeywordLiterals[13],
+			kCodaKeywordLiterals[14],
+			kCodaKeywordLiterals[15]
+		};
+
+		// perfect hash over the keyword literals, built at compile time
+		// a token's slot is derived from its length and its (case-folded) last character, which is collision-free for the keyword set
+		class CodaScriptKeywordHashTable
+		{
+		public:
+			static constexpr UInt32				kSlotCount = 32;
+			static constexpr UInt32				kMaxKeywordLength = 8;
+		private:
+			UInt8								Slots[kSlotCount];		// index into the literal table, zero if unoccupied
+			UInt8								Lengths[kSlotCount];	// length of the literal in the slot
+			bool								Perfect;
+
+			static constexpr UInt32				Length(const char* Literal)
+			{
+				UInt32 Out = 0;
+				while (Literal[Out])
+					Out++;
+
+				return Out;
+			}
+		public:
+			static constexpr char				Fold(char Character)
+			{
+				return Character >= 'a' && Character <= 'z' ? Character - ('a' - 'A') : Character;
+			}
+
+			static constexpr UInt32				Hash(const char* Folded, UInt32 Length)
+			{
+				return (Length + 9 * static_cast<UInt8>(Folded[Length - 1])) % kSlotCount;
+			}
+
+			constexpr CodaScriptKeywordHashTable() :
+				Slots(),
+				Lengths(),
+				Perfect(true)
+			{
+				for (UInt32 i = 1; i < sizeof(kCodaKeywordLiterals) / sizeof(kCodaKeywordLiterals[0]); i++)
+				{
+					const char* Literal = kCodaKeywordLiterals[i];
+					UInt32 Slot = Hash(Literal, Length(Literal));
+
+					if (Slots[Slot] || Length(Literal) > kMaxKeywordLength)
+						Perfect = false;
+
+					Slots[Slot] = i;
+					Lengths[Slot] = Length(Literal);
+				}
+			}
+
+			constexpr bool						IsPerfect() const { return Perfect; }
+
+			// expects the token to be folded and no longer than kMaxKeywordLength, returns the literal index or zero
+			UInt32								Lookup(const char* Folded, UInt32 Length) const
+			{
+				UInt32 Slot = Hash(Folded, Length);
+				UInt32 Index = Slots[Slot];
+
+				// the lengths are compared first as the literal can be shorter than the token
+				if (Index == 0 || Lengths[Slot] != Length || memcmp(kCodaKeywordLiterals[Index], Folded, Length))
+					return 0;
+
+				return Index;
+			}
+		};
+
+		static constexpr CodaScriptKeywordHashTable	kCodaKeywordHashTable;
+
+		static_assert(sizeof(kCodaKeywordLiterals) / sizeof(kCodaKeywordLiterals[0]) == 15 + 1, "Keyword literal table is out of sync with kCodaKeywordCount");
+		static_assert(kCodaKeywordHashTable.IsPerfect(), "Keyword hash function has collisions - Update CodaScriptKeywordHashTable::Hash");
+
+		CodaScriptTokenizer::CharacterClassTableT CodaScriptTokenizer::BuildCharacterClassTable()
+		{
+			CharacterClassTableT Out = { 0 };
+
+			for (auto Itr : kWhitespace)
+				Out[static_cast<UInt8>(Itr)] |= kCharacterClass_Whitespace;
+
+			for (auto Itr : kValidDelimiters)
+				Out[static_cast<UInt8>(Itr)] |= kCharacterClass_Delimiter;
+
+			return Out;
+		}
+
+		CodaScriptTokenizer::CodaScriptTokenizer() :
+			Views(),
+			Tokens(),
+			Indices(),
+			Delimiters()
 		{
 			;//
 		}
@@ -68,113 +178,115 @@ namespace bgsee
 			ResetState();
 		}
 
-		bool CodaScriptTokenizer::Tokenize(CodaScriptSourceCodeT Source, bool CollectEmptyTokens)
+		void CodaScriptTokenizer::AddToken(const char* Source, UInt32 Offset, UInt32 Length, char Delimiter, bool ViewsOnly)
+		{
+			TokenView View = { Offset, Length };
+			Views.push_back(View);
+			Indices.push_back(Offset);
+			Delimiters.push_back(Delimiter);
+
+			if (ViewsOnly == false)
+				Tokens.push_back(CodaScriptSourceCodeT(Source + Offset, Length));
+		}
+
+		bool CodaScriptTokenizer::Tokenize(const CodaScriptSourceCodeT& Source, bool CollectEmptyTokens, bool ViewsOnly)
 		{
-			bool Result = false;
-			int StartPos = -1, LastPos = -1;
+			return Tokenize(Source.c_str(), Source.length(), CollectEmptyTokens, ViewsOnly);
+		}
 
+		bool CodaScriptTokenizer::Tokenize(const char* Source, UInt32 Length, bool CollectEmptyTokens, bool ViewsOnly)
+		{
 			ResetState();
-			SourceString = Source;
-			Source += "\n";
 
-			for (int i = 0; i < Source.length(); i++)
+			// the line is scanned as if it were terminated by a newline
+			const char* Line = Source;
+			const UInt32 LineLength = Length;
+			const UInt32 ScanLength = LineLength + 1;
+			auto CharAt = [Line, LineLength](UInt32 Index) -> char { return Index < LineLength ? Line[Index] : '\n'; };
+
+			UInt32 Position = 0;
+			while (Position < ScanLength && IsWhitespace(CharAt(Position)))
+				Position++;
+
+			while (Position < ScanLength)
 			{
-				char Itr = Source[i];
-				if (kWhitespace.find(Itr) == std::string::npos)
+				UInt32 End = Position;
+				if (CharAt(Position) == '\"')
 				{
-					StartPos = i;
-					break;
+					// string literals extend up to and including the closing quote, the character that follows it is consumed as the delimiter
+					const char* ClosingQuote = static_cast<const char*>(memchr(Line + Position + 1, '\"', LineLength - Position - 1));
+					End = ClosingQuote ? (ClosingQuote - Line) + 1 : ScanLength - 1;
+				}
+				else
+				{
+					while (IsDelimiter(CharAt(End)) == false)
+						End++;
 				}
-			}
-
-			if (StartPos != -1)
-			{
-				LastPos = StartPos;
 
-				std::string TokenString = Source.substr(StartPos);
-				std::string Token, Delimiter;
+				char Delimiter = CharAt(End);
+				UInt32 TokenLength = End - Position;
 
-				for (int Index = TokenString.find_first_of(kValidDelimiters); Index != std::string::npos; Index = TokenString.find_first_of(kValidDelimiters))
+				if (Delimiter == kCommentDelimiter[0])
 				{
-					if (TokenString[0] == '\"')
-					{
-						if (TokenString.find('\"', 1) != std::string::npos)
-							Index = TokenString.find('\"', 1) + 1;
-						else
-							Index = TokenString.length() - 1;
-					}
-
-					Token = TokenString.substr(0, Index);
-					Delimiter = TokenString.substr(Index, 1);
-
-					if (Delimiter != kCommentDelimiter)
-					{
-						TokenString = TokenString.erase(0, Index + 1);
-
-						if (Token == "" && !CollectEmptyTokens)
-						{
-							LastPos++;
-							continue;
-						}
-
-						Tokens.push_back(Token);
-						Indices.push_back(LastPos);
-						Delimiters.push_back(Delimiter[0]);
-						LastPos += Token.length() + 1;
-					}
-					else
-					{
-						if (Token != "")
-						{
-							Tokens.push_back(Token);
-							Indices.push_back(LastPos);
-							Delimiters.push_back(Delimiter[0]);
-						}
-						break;
-					}
+					if (TokenLength)
+						AddToken(Source, Position, TokenLength, Delimiter, ViewsOnly);
+
+					break;
 				}
 
-				if (Tokens.size() > 0)
-					Result = true;
+				if (TokenLength || CollectEmptyTokens)
+					AddToken(Source, Position, TokenLength, Delimiter, ViewsOnly);
+
+				Position = End + 1;
 			}
 
-			return Result;
+			return Views.empty() == false;
 		}
 
 		void CodaScriptTokenizer::ResetState()
 		{
+			Views.clear();
 			Tokens.clear();
 			Delimiters.clear();
 			Indices.clear();
-			SourceString.clear();
 		}
 
-		CodaScriptKeywordT CodaScriptTokenizer::GetKeywordType(CodaScriptSourceCodeT& Token)
+		CodaScriptKeywordT CodaScriptTokenizer::GetKeywordType(const CodaScriptSourceCodeT& Token)
 		{
-			CodaScriptKeywordT Result = kTokenType_Invalid;
+			return GetKeywordType(Token.c_str(), Token.length());
+		}
 
-			for (int i = 1; i < kCodaKeywordCount; i++)
-			{
-				if (!_stricmp(Token.c_str(), kCodaKeywordArray[i].c_str()))
-				{
-					Result = 1 << i;
-					break;
-				}
-			}
+		CodaScriptKeywordT CodaScriptTokenizer::GetKeywordType(const char* Token, UInt32 Length)
+		{
+			if (Length == 0 || Length > CodaScriptKeywordHashTable::kMaxKeywordLength)
+				return kTokenType_Invalid;
 
-			return Result;
+			char Folded[CodaScriptKeywordHashTable::kMaxKeywordLength];
+			for (UInt32 i = 0; i < Length; i++)
+				Folded[i] = CodaScriptKeywordHashTable::Fold(Token[i]);
+
+			UInt32 Index = kCodaKeywordHashTable.Lookup(Folded, Length);
+			if (Index == 0)
+				return kTokenType_Invalid;
+
+			return 1 << Index;
 		}
 
 		void CodaScriptTokenizer::Sanitize(const CodaScriptSourceCodeT& In, CodaScriptSourceCodeT& Out, UInt32 OperationMask)
+		{
+			Sanitize(In.c_str(), In.length(), Out, OperationMask);
+		}
+
+		void CodaScriptTokenizer::Sanitize(const char* In, UInt32 Length, CodaScriptSourceCodeT& Out, UInt32 OperationMask)
 		{
 			Out.clear();
 
-			if (Tokenize(In, true))
+			if (Tokenize(In, Length, true, true))
 			{
 				if ((OperationMask & kSanitizeOps_StripLeadingWhitespace))
-					Out = In.substr(Indices[0]);
+					Out.assign(In + Indices[0], Length - Indices[0]);
 				else
-					Out = In;
+					Out.assign(In, Length);
 
 				if ((OperationMask & kSanitizeOps_StripTabCharacters))
 					std::replace(Out.begin(), Out.end(), '\t', ' ');
@@ -182,7 +294,7 @@ namespace bgsee
 				if ((OperationMask & kSanitizeOps_StripComments))
 				{
 					int CommentDelimiter = Out.rfind(kCommentDelimiter);
-					if (CommentDelimiter != std::string::npos && IsIndexStringLiteral(SourceString, CommentDelimiter) == false)
+					if (CommentDelimiter != std::string::npos && IsIndexStringLiteral(In, Length, CommentDelimiter) == false)
 						Out.erase(CommentDelimiter, Out.length() - CommentDelimiter);
 				}
 			}
@@ -254,15 +366,93 @@ namespace bgsee
 			return ErrorMessage;
 		}
 
-		CodaScriptProfiler::CodaScriptProfiler() :
-			Counters()
+		LONGLONG CodaScriptProfiler::GetTicks()
 		{
-			;//
+			LARGE_INTEGER Ticks;
+			QueryPerformanceCounter(&Ticks);
+			return Ticks.QuadPart;
+		}
+
+		void CodaScriptProfiler::PushFrame(LineRecord* Record, const void* Key, const std::string* Script)
+		{
+			CallTreeNode* Parent = Frames.empty() ? &CallTree : Frames.back().Node;
+			std::unique_ptr<CallTreeNode>& Node = Parent->Children[Key];
+			if (Node == nullptr)
+			{
+				if (Record)
+				{
+					char Label[0x200] = {0};
+					_snprintf_s(Label, sizeof(Label), _TRUNCATE, "%s:%d", Record->Script.c_str(), Record->Line);
+					Node.reset(new CallTreeNode(Label));
+				}
+				else
+					Node.reset(new CallTreeNode(*Script));
+			}
+
+			Frame NewFrame = { Record, Node.get(), Script, 0, 0 };
+			Frames.push_back(NewFrame);
+			Frames.back().Start = GetTicks();
+		}
+
+		void CodaScriptProfiler::PopFrame()
+		{
+			LONGLONG End = GetTicks();
+			SME_ASSERT(Frames.size());
+
+			Frame& Current = Frames.back();
+			LONGLONG Inclusive = End - Current.Start;
+			LONGLONG Exclusive = Inclusive - Current.Children;
+
+			Current.Node->Exclusive += Exclusive;
+			if (Current.Record)
+			{
+				Current.Record->Exclusive += Exclusive;
+				if (--Current.Record->ActiveDepth == 0)
+					Current.Record->Inclusive += Inclusive;
+			}
+
+			Frames.pop_back();
+			if (Frames.empty() == false)
+				Frames.back().Children += Inclusive;
+		}
+
+		void CodaScriptProfiler::WriteCollapsedStacks(std::fstream& Out, const CallTreeNode* Node, std::string& Path) const
+		{
+			UInt32 PathLength = Path.length();
+			if (Node != &CallTree)
+			{
+				if (Path.empty() == false)
+					Path += ';';
+
+				Path += Node->Label;
+
+				LONGLONG Microseconds = Node->Exclusive * 1000000 / Frequency;
+				if (Microseconds > 0)
+					Out << Path << ' ' << Microseconds << '\n';
+			}
+
+			for (auto& Itr : Node->Children)
+				WriteCollapsedStacks(Out, Itr.second.get(), Path);
+
+			Path.resize(PathLength);
+		}
+
+		CodaScriptProfiler::CodaScriptProfiler() :
+			Counters(),
+			Lines(),
+			CallTree("<root>"),
+			Frames(),
+			Frequency(1)
+		{
+			LARGE_INTEGER Buffer;
+			if (QueryPerformanceFrequency(&Buffer) && Buffer.QuadPart)
+				Frequency = Buffer.QuadPart;
 		}
 
 		CodaScriptProfiler::~CodaScriptProfiler()
 		{
 			SME_ASSERT(Counters.size() == 0);
+			SME_ASSERT(Frames.empty());
 		}
 
 		void CodaScriptProfiler::BeginProfiling(void)
@@ -283,6 +473,283 @@ namespace bgsee
 			return ElapsedTime;
 		}
 
+		void CodaScriptProfiler::EnterScript(const ICodaScriptProgram* Program, const CodaScriptSourceCodeT& Name)
+		{
+			PushFrame(nullptr, Program, &Name);
+		}
+
+		void CodaScriptProfiler::LeaveScript()
+		{
+			SME_ASSERT(Frames.size() && Frames.back().Record == nullptr);
+			PopFrame();
+		}
+
+		void CodaScriptProfiler::EnterCode(const ICodaScriptExecutableCode* Code)
+		{
+			SME_ASSERT(Frames.size());
+
+			LineRecord& Record = Lines[Code];
+			if (Record.Hits == 0 || Record.Line != Code->GetLine())
+			{
+				// first hit, or the address was reused by a recompiled program
+				Record.Script = *Frames.back().Script;
+				Record.Line = Code->GetLine();
+				Record.Source = Code->GetSourceCode();
+				Record.Hits = 0;
+				Record.Inclusive = Record.Exclusive = 0;
+				Record.ActiveDepth = 0;
+			}
+
+			Record.Hits++;
+			Record.ActiveDepth++;
+
+			PushFrame(&Record, Code, Frames.back().Script);
+		}
+
+		void CodaScriptProfiler::LeaveCode()
+		{
+			SME_ASSERT(Frames.size() && Frames.back().Record);
+			PopFrame();
+		}
+
+		bool CodaScriptProfiler::IsInstrumenting() const
+		{
+			return Frames.empty() == false;
+		}
+
+		void CodaScriptProfiler::Reset()
+		{
+			SME_ASSERT(IsInstrumenting() == false);
+
+			Lines.clear();
+			CallTree.Children.clear();
+			CallTree.Exclusive = 0;
+		}
+
+		void CodaScriptProfiler::LogHotLines(CodaScriptMessageHandler* MessageHandler, UInt32 Count) const
+		{
+			std::vector<const LineRecord*> Sorted;
+			Sorted.reserve(Lines.size());
+			for (auto& Itr : Lines)
+				Sorted.push_back(&Itr.second);
+
+			std::sort(Sorted.begin(), Sorted.end(), [](const LineRecord* A, const LineRecord* B) { return A->Exclusive > B->Exclusive; });
+
+			MessageHandler->Log("%12s %12s %10s   %s", "Excl. (ms)", "Incl. (ms)", "Hits", "Location");
+			for (UInt32 i = 0; i < Sorted.size() && i < Count; i++)
+			{
+				const LineRecord* Itr = Sorted[i];
+				MessageHandler->Log("%12.3f %12.3f %10llu   %s:%d  %s",
+									Itr->Exclusive * 1000.0 / Frequency,
+									Itr->Inclusive * 1000.0 / Frequency,
+									Itr->Hits,
+									Itr->Script.c_str(), Itr->Line, Itr->Source.c_str());
+			}
+		}
+
+		bool CodaScriptProfiler::DumpCollapsedStacks(const char* Path) const
+		{
+			std::fstream Out(Path, std::iostream::out | std::iostream::trunc);
+			if (Out.fail())
+				return false;
+
+			std::string Stack;
+			WriteCollapsedStacks(Out, &CallTree, Stack);
+
+			return Out.fail() == false;
+		}
+
+		UInt32 CodaScriptHash::Compute(const void* Data, UInt32 Size, UInt32 Basis)
+		{
+			const UInt8* Bytes = static_cast<const UInt8*>(Data);
+			UInt32 Hash = Basis;
+
+			for (UInt32 i = 0; i < Size; i++)
+			{
+				Hash ^= Bytes[i];
+				Hash *= 16777619U;
+			}
+
+			return Hash;
+		}
+
+		UInt32 CodaScriptHash::Compute(const std::string& Data, UInt32 Basis)
+		{
+			return Compute(Data.c_str(), Data.length(), Basis);
+		}
+
+		CodaScriptBinaryWriter::CodaScriptBinaryWriter() :
+			Buffer(),
+			Valid(true)
+		{
+			;//
+		}
+
+		CodaScriptBinaryWriter::~CodaScriptBinaryWriter()
+		{
+			;//
+		}
+
+		void CodaScriptBinaryWriter::WriteBytes(const void* Data, UInt32 Size)
+		{
+			Buffer.append(static_cast<const char*>(Data), Size);
+		}
+
+		void CodaScriptBinaryWriter::WriteUInt8(UInt8 Data)
+		{
+			WriteBytes(&Data, sizeof(Data));
+		}
+
+		void CodaScriptBinaryWriter::WriteUInt32(UInt32 Data)
+		{
+			WriteBytes(&Data, sizeof(Data));
+		}
+
+		void CodaScriptBinaryWriter::WriteInt32(SInt32 Data)
+		{
+			WriteBytes(&Data, sizeof(Data));
+		}
+
+		void CodaScriptBinaryWriter::WriteDouble(double Data)
+		{
+			WriteBytes(&Data, sizeof(Data));
+		}
+
+		void CodaScriptBinaryWriter::WriteString(const std::string& Data)
+		{
+			WriteUInt32(Data.length());
+			WriteBytes(Data.c_str(), Data.length());
+		}
+
+		void CodaScriptBinaryWriter::Invalidate()
+		{
+			Valid = false;
+		}
+
+		bool CodaScriptBinaryWriter::IsValid() const
+		{
+			return Valid;
+		}
+
+		const std::string& CodaScriptBinaryWriter::GetBuffer() const
+		{
+			return Buffer;
+		}
+
+		CodaScriptBinaryReader::CodaScriptBinaryReader(const void* Data, UInt32 Size, UInt32 Offset) :
+			Data(static_cast<const UInt8*>(Data)),
+			Size(Size),
+			Position(Offset)
+		{
+			SME_ASSERT(Data && Offset <= Size);
+		}
+
+		CodaScriptBinaryReader::~CodaScriptBinaryReader()
+		{
+			;//
+		}
+
+		void CodaScriptBinaryReader::ReadBytes(void* Out, UInt32 Count)
+		{
+			if (Count > Size - Position)
+				throw CodaScriptException("Unexpected end of binary stream - Offset %d, requested %d bytes", Position, Count);
+
+			memcpy(Out, Data + Position, Count);
+			Position += Count;
+		}
+
+		UInt8 CodaScriptBinaryReader::ReadUInt8()
+		{
+			UInt8 Out = 0;
+			ReadBytes(&Out, sizeof(Out));
+			return Out;
+		}
+
+		UInt32 CodaScriptBinaryReader::ReadUInt32()
+		{
+			UInt32 Out = 0;
+			ReadBytes(&Out, sizeof(Out));
+			return Out;
+		}
+
+		SInt32 CodaScriptBinaryReader::ReadInt32()
+		{
+			SInt32 Out = 0;
+			ReadBytes(&Out, sizeof(Out));
+			return Out;
+		}
+
+		double CodaScriptBinaryReader::ReadDouble()
+		{
+			double Out = 0;
+			ReadBytes(&Out, sizeof(Out));
+			return Out;
+		}
+
+		std::string CodaScriptBinaryReader::ReadString()
+		{
+			UInt32 Length = ReadUInt32();
+			if (Length > Size - Position)
+				throw CodaScriptException("Unexpected end of binary stream - Offset %d, requested %d bytes", Position, Length);
+
+			std::string Out(reinterpret_cast<const char*>(Data + Position), Length);
+			Position += Length;
+			return Out;
+		}
+
+		bool CodaScriptBinaryReader::IsEOF() const
+		{
+			return Position == Size;
+		}
+
+		CodaScriptMappedFile::CodaScriptMappedFile(const char* Path) :
+			File(INVALID_HANDLE_VALUE),
+			Mapping(nullptr),
+			View(nullptr),
+			Size(0)
+		{
+			File = CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (File == INVALID_HANDLE_VALUE)
+				return;
+
+			Size = GetFileSize(File, nullptr);
+			if (Size == 0 || Size == INVALID_FILE_SIZE)
+				return;
+
+			Mapping = CreateFileMapping(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (Mapping)
+				View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		CodaScriptMappedFile::~CodaScriptMappedFile()
+		{
+			if (View)
+				UnmapViewOfFile(View);
+
+			if (Mapping)
+				CloseHandle(Mapping);
+
+			if (File != INVALID_HANDLE_VALUE)
+				CloseHandle(File);
+		}
+
+		bool CodaScriptMappedFile::IsValid() const
+		{
+			return View != nullptr;
+		}
+
+		const void* CodaScriptMappedFile::GetData() const
+		{
+			return View;
+		}
+
+		UInt32 CodaScriptMappedFile::GetSize() const
+		{
+			return Size;
+		}
+
+		thread_local CodaScriptMessageHandler::Transcript*		CodaScriptMessageHandler::ActiveTranscript = nullptr;
+
 		CodaScriptMessageHandler::CodaScriptMessageHandler(const char* ConsoleContextName) :
 			ConsoleContext(nullptr),
 			DefaultContextLoggingState(true),
@@ -316,6 +783,19 @@ namespace bgsee
 		{
 			va_list Args;
 
+			if (ActiveTranscript)
+			{
+				// the shared buffer and the console are only safe to use on the main thread
+				char Scratch[sizeof(Buffer)] = {0};
+
+				va_start(Args, Format);
+				vsnprintf_s(Scratch, sizeof(Scratch), _TRUNCATE, Format, Args);
+				va_end(Args);
+
+				ActiveTranscript->Entries.push_back(std::make_pair(Transcript::EntryType::Message, std::string(Scratch)));
+				return;
+			}
+
 			va_start(Args, Format);
 			vsnprintf_s(Buffer, sizeof(Buffer), _TRUNCATE, Format, Args);
 			va_end(Args);
@@ -327,17 +807,143 @@ namespace bgsee
 
 		void CodaScriptMessageHandler::Indent()
 		{
-			BGSEECONSOLE->Indent();
+			if (ActiveTranscript)
+				ActiveTranscript->Entries.push_back(std::make_pair(Transcript::EntryType::Indent, std::string()));
+			else
+				BGSEECONSOLE->Indent();
 		}
 
 		void CodaScriptMessageHandler::Outdent()
 		{
-			BGSEECONSOLE->Outdent();
+			if (ActiveTranscript)
+				ActiveTranscript->Entries.push_back(std::make_pair(Transcript::EntryType::Outdent, std::string()));
+			else
+				BGSEECONSOLE->Outdent();
+		}
+
+		void CodaScriptMessageHandler::BeginTranscript(Transcript* Out)
+		{
+			SME_ASSERT(Out && ActiveTranscript == nullptr);
+
+			ActiveTranscript = Out;
+		}
+
+		void CodaScriptMessageHandler::EndTranscript()
+		{
+			SME_ASSERT(ActiveTranscript);
+
+			ActiveTranscript = nullptr;
+		}
+
+		void CodaScriptMessageHandler::Replay(const Transcript& In)
+		{
+			for (auto& Itr : In.Entries)
+			{
+				switch (Itr.first)
+				{
+				case Transcript::EntryType::Message:
+					Log("%s", Itr.second.c_str());
+					break;
+				case Transcript::EntryType::Indent:
+					Indent();
+					break;
+				case Transcript::EntryType::Outdent:
+					Outdent();
+					break;
+				}
+			}
+		}
+
+		void CodaScriptWorkerPool::WorkerLoop()
+		{
+			while (true)
+			{
+				TaskT Task;
+				{
+					std::unique_lock<std::mutex> Guard(Lock);
+					TaskQueued.wait(Guard, [this]() { return Terminating || Tasks.empty() == false; });
+
+					if (Tasks.empty())
+						return;
+
+					Task = std::move(Tasks.front());
+					Tasks.pop();
+				}
+
+				try
+				{
+					Task();
+				}
+				catch (...)
+				{
+					// tasks are expected to handle their own errors, just make sure the pool doesn't go down with them
+				}
+
+				std::lock_guard<std::mutex> Guard(Lock);
+				if (--Outstanding == 0)
+					TasksCompleted.notify_all();
+			}
+		}
+
+		CodaScriptWorkerPool::CodaScriptWorkerPool(UInt32 ThreadCount) :
+			Workers(),
+			Tasks(),
+			Lock(),
+			TaskQueued(),
+			TasksCompleted(),
+			Outstanding(0),
+			Terminating(false)
+		{
+			if (ThreadCount == 0)
+				ThreadCount = std::thread::hardware_concurrency();
+			if (ThreadCount == 0)
+				ThreadCount = 1;
+
+			for (UInt32 i = 0; i < ThreadCount; i++)
+				Workers.push_back(std::thread(&CodaScriptWorkerPool::WorkerLoop, this));
+		}
+
+		CodaScriptWorkerPool::~CodaScriptWorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Terminating = true;
+			}
+
+			// pending tasks are drained before the workers exit
+			TaskQueued.notify_all();
+			for (auto& Itr : Workers)
+				Itr.join();
+		}
+
+		void CodaScriptWorkerPool::Enqueue(const TaskT& Task)
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				SME_ASSERT(Terminating == false);
+
+				Tasks.push(Task);
+				Outstanding++;
+			}
+
+			TaskQueued.notify_one();
+		}
+
+		void CodaScriptWorkerPool::Wait()
+		{
+			std::unique_lock<std::mutex> Guard(Lock);
+			TasksCompleted.wait(Guard, [this]() { return Outstanding == 0; });
+		}
+
+		UInt32 CodaScriptWorkerPool::GetThreadCount() const
+		{
+			return Workers.size();
 		}
 
 		CodaScriptCommandRegistrar::CodaScriptCommandRegistrar(const char* Category) :
 			Commands(),
-			Category(Category)
+			Category(Category),
+			ThreadSafeCommands()
 		{
 			;//
 		}
@@ -362,5 +968,18 @@ namespace bgsee
 			return Commands;
 		}
 
+		bool CodaScriptCommandRegistrar::MarkThreadSafe(ICodaScriptCommand* Command)
+		{
+			SME_ASSERT(Command);
+
+			ThreadSafeCommands.insert(Command);
+			return true;
+		}
+
+		bool CodaScriptCommandRegistrar::IsThreadSafe(ICodaScriptCommand* Command) const
+		{
+			return ThreadSafeCommands.count(Command) != 0;
+		}
+
 	}
 }
\ No newline at end of file
@@ -15,7 +15,16 @@ namespace bgsee
 			typedef std::vector<UInt32>						ParsedTokenOffsetListT;
 			typedef std::vector<char>						ParsedDelimiterListT;
 
-			ParsedTokenListT								Tokens;
+			struct TokenView
+			{
+				UInt32										Offset;			// relative to the parent line
+				UInt32										Length;
+			};
+
+			typedef std::vector<TokenView>					ParsedTokenViewListT;
+
+			ParsedTokenViewListT							Views;
+			ParsedTokenListT								Tokens;			// copies of the views, not populated when tokenizing views only
 			ParsedTokenOffsetListT							Indices;		// the position of each token relative to its parent line
 			ParsedDelimiterListT							Delimiters;
 
@@ -49,24 +58,43 @@ namespace bgsee
 			CodaScriptTokenizer();
 			~CodaScriptTokenizer();
 
-			bool											Tokenize(CodaScriptSourceCodeT Source, bool CollectEmptyTokens = false);		// returns true if at least one token was parsed, skips comments
+			bool											Tokenize(const CodaScriptSourceCodeT& Source,
+																	 bool CollectEmptyTokens = false,
+																	 bool ViewsOnly = false);		// returns true if at least one token was parsed, skips comments
+			bool											Tokenize(const char* Source, UInt32 Length,
+																	 bool CollectEmptyTokens = false,
+																	 bool ViewsOnly = false);
 			void											ResetState(void);
 
 			UInt32											GetParsedTokenCount() const;
 			CodaScriptKeywordT								GetFirstTokenKeywordType();
 
 			void											Sanitize(const CodaScriptSourceCodeT& In, CodaScriptSourceCodeT& Out, UInt32 OperationMask);
+			void											Sanitize(const char* In, UInt32 Length, CodaScriptSourceCodeT& Out, UInt32 OperationMask);
 
-			static CodaScriptKeywordT						GetKeywordType(CodaScriptSourceCodeT& Token);
+			static CodaScriptKeywordT						GetKeywordType(const CodaScriptSourceCodeT& Token);
+			static CodaScriptKeywordT						GetKeywordType(const char* Token, UInt32 Length);		// case-insensitive, O(1)
 			static const CodaScriptSourceCodeT&				GetKeywordName(CodaScriptKeywordT Keyword);
 		private:
-			CodaScriptSourceCodeT							SourceString;
+			enum
+			{
+				kCharacterClass_Whitespace					= 1 << 0,
+				kCharacterClass_Delimiter					= 1 << 1,
+			};
+
+			typedef std::array<UInt8, 256>					CharacterClassTableT;
+
+			bool											IsIndexStringLiteral(const char* Source, UInt32 Length, int Index);		// returns true if the index is inside a string literal
+			void											AddToken(const char* Source, UInt32 Offset, UInt32 Length, char Delimiter, bool ViewsOnly);
 
-			bool											IsIndexStringLiteral(const CodaScriptSourceCodeT& Source, int Index);		// returns true if the index is inside a string literal
+			static CharacterClassTableT						BuildCharacterClassTable();
+			static bool										IsWhitespace(char Character) { return kCharacterClasses[static_cast<UInt8>(Character)] & kCharacterClass_Whitespace; }
+			static bool										IsDelimiter(char Character) { return kCharacterClasses[static_cast<UInt8>(Character)] & kCharacterClass_Delimiter; }
 
 			static const CodaScriptSourceCodeT				kWhitespace;
 			static const CodaScriptSourceCodeT				kValidDelimiters;
 			static const CodaScriptSourceCodeT				kCommentDelimiter;
+			static const CharacterClassTableT				kCharacterClasses;
 			static const UInt32								kCodaKeywordCount;
 			static const CodaScriptSourceCodeT				kCodaKeywordArray[];
 		};
@@ -100,21 +128,103 @@ namespace bgsee
 			FunctorT		Functor;
 		};
 
+		class CodaScriptMessageHandler;
+
+		// besides timing whole executions, the profiler instruments individual lines of code
+		// line records accumulate hit counts and inclusive/exclusive time across executions, until reset
+		// the calling context tree tracks the same exclusive time per unique call stack, script calls included
 		class CodaScriptProfiler
 		{
 			typedef std::stack<CodaScriptElapsedTimeCounterT>		TimeCounterStackT;
+		public:
+			struct LineRecord
+			{
+				std::string				Script;
+				UInt32					Line;
+				CodaScriptSourceCodeT	Source;
+				UInt64					Hits;
+				LONGLONG				Inclusive;			// in performance counter ticks
+				LONGLONG				Exclusive;
+				UInt32					ActiveDepth;		// inclusive time is only accumulated by the outermost activation of recursive code
+			};
+		private:
+			struct CallTreeNode
+			{
+				typedef std::unordered_map<const void*, std::unique_ptr<CallTreeNode>>		ChildMapT;
+
+				std::string				Label;
+				ChildMapT				Children;
+				LONGLONG				Exclusive;
+
+				CallTreeNode(const std::string& Label) : Label(Label), Children(), Exclusive(0) {}
+			};
+
+			struct Frame
+			{
+				LineRecord*				Record;				// nullptr for script frames
+				CallTreeNode*			Node;
+				const std::string*		Script;
+				LONGLONG				Start;
+				LONGLONG				Children;
+			};
+
+			typedef std::unordered_map<const ICodaScriptExecutableCode*, LineRecord>	LineRecordMapT;
 
 			TimeCounterStackT		Counters;
+			LineRecordMapT			Lines;
+			CallTreeNode			CallTree;
+			std::vector<Frame>		Frames;
+			LONGLONG				Frequency;
+
+			static LONGLONG			GetTicks();
+
+			void					PushFrame(LineRecord* Record, const void* Key, const std::string* Script);
+			void					PopFrame();
+			void					WriteCollapsedStacks(std::fstream& Out, const CallTreeNode* Node, std::string& Path) const;
 		public:
 			CodaScriptProfiler();
 			~CodaScriptProfiler();
 
 			void					BeginProfiling(void);
 			long double				EndProfiling(void);
+
+			void					EnterScript(const ICodaScriptProgram* Program, const CodaScriptSourceCodeT& Name);
+			void					LeaveScript();
+			void					EnterCode(const ICodaScriptExecutableCode* Code);
+			void					LeaveCode();
+
+			bool					IsInstrumenting() const;
+			void					Reset();						// discards the line records and the call tree, must not be called while instrumenting
+			void					LogHotLines(CodaScriptMessageHandler* MessageHandler, UInt32 Count) const;		// sorted by exclusive time
+			bool					DumpCollapsedStacks(const char* Path) const;	// in the format consumed by flamegraph.pl, weighted by microseconds
 		};
 
 		class CodaScriptMessageHandler
 		{
+		public:
+			// buffers the messages logged on a worker thread so that they can be replayed on the main thread
+			class Transcript
+			{
+				friend class CodaScriptMessageHandler;
+
+				enum class EntryType : UInt8
+				{
+					Message,
+					Indent,
+					Outdent,
+				};
+
+				typedef std::pair<EntryType, std::string>		EntryT;
+
+				std::vector<EntryT>		Entries;
+			public:
+				Transcript() : Entries() {}
+
+				bool					IsEmpty() const { return Entries.empty(); }
+			};
+		private:
+			static thread_local Transcript*		ActiveTranscript;
+
 			bool			DefaultContextLoggingState;
 			void*			ConsoleContext;
 			char			Buffer[0x5000];
@@ -129,13 +239,44 @@ namespace bgsee
 			void			Indent();
 			void			Outdent();
 
+			void			BeginTranscript(Transcript* Out);		// redirects all subsequent messages logged on the calling thread to the transcript
+			void			EndTranscript();
+			void			Replay(const Transcript& In);
+
 			typedef std::unique_ptr<CodaScriptMessageHandler>		PtrT;
 		};
 
+		// fixed-size pool of worker threads that drain a shared task queue
+		class CodaScriptWorkerPool
+		{
+		public:
+			typedef std::function<void()>		TaskT;
+		private:
+			std::vector<std::thread>			Workers;
+			std::queue<TaskT>					Tasks;
+			std::mutex							Lock;
+			std::condition_variable				TaskQueued;
+			std::condition_variable				TasksCompleted;
+			UInt32								Outstanding;		// queued + executing
+			bool								Terminating;
+
+			void								WorkerLoop();
+		public:
+			CodaScriptWorkerPool(UInt32 ThreadCount = 0);		// defaults to the number of hardware threads
+			~CodaScriptWorkerPool();
+
+			void								Enqueue(const TaskT& Task);
+			void								Wait();				// blocks until all queued tasks have completed
+			UInt32								GetThreadCount() const;
+
+			typedef std::unique_ptr<CodaScriptWorkerPool>		PtrT;
+		};
+
 		class CodaScriptCommandRegistrar
 		{
-			ICodaScriptCommand::ListT		Commands;
-			std::string						Category;
+			ICodaScriptCommand::ListT						Commands;
+			std::string										Category;
+			std::unordered_set<ICodaScriptCommand*>			ThreadSafeCommands;
 		public:
 			CodaScriptCommandRegistrar(const char* Category);
 			~CodaScriptCommandRegistrar();
@@ -144,9 +285,81 @@ namespace bgsee
 			const char*							GetCategory() const;
 			const ICodaScriptCommand::ListT&	GetCommands() const;
 
+			bool								MarkThreadSafe(ICodaScriptCommand* Command);		// always returns true
+			bool								IsThreadSafe(ICodaScriptCommand* Command) const;
+
 			typedef std::vector<CodaScriptCommandRegistrar*>		ListT;
 		};
 
+		// 32-bit FNV-1a
+		class CodaScriptHash
+		{
+		public:
+			static const UInt32					kOffsetBasis = 2166136261U;
+
+			static UInt32						Compute(const void* Data, UInt32 Size, UInt32 Basis = kOffsetBasis);
+			static UInt32						Compute(const std::string& Data, UInt32 Basis = kOffsetBasis);
+		};
+
+		// serializes primitives into a growable buffer in native byte order
+		class CodaScriptBinaryWriter
+		{
+			std::string							Buffer;
+			bool								Valid;
+		public:
+			CodaScriptBinaryWriter();
+			~CodaScriptBinaryWriter();
+
+			void								WriteBytes(const void* Data, UInt32 Size);
+			void								WriteUInt8(UInt8 Data);
+			void								WriteUInt32(UInt32 Data);
+			void								WriteInt32(SInt32 Data);
+			void								WriteDouble(double Data);
+			void								WriteString(const std::string& Data);
+
+			void								Invalidate();			// flags the contents as incomplete
+			bool								IsValid() const;
+			const std::string&					GetBuffer() const;
+		};
+
+		// deserializes primitives from a borrowed buffer, throws a CodaScriptException when reading past its end
+		class CodaScriptBinaryReader
+		{
+			const UInt8*						Data;
+			UInt32								Size;
+			UInt32								Position;
+		public:
+			CodaScriptBinaryReader(const void* Data, UInt32 Size, UInt32 Offset = 0);
+			~CodaScriptBinaryReader();
+
+			void								ReadBytes(void* Out, UInt32 Count);
+			UInt8								ReadUInt8();
+			UInt32								ReadUInt32();
+			SInt32								ReadInt32();
+			double								ReadDouble();
+			std::string							ReadString();
+
+			bool								IsEOF() const;
+		};
+
+		// read-only memory-mapped view of an entire file
+		class CodaScriptMappedFile
+		{
+			HANDLE								File;
+			HANDLE								Mapping;
+			const void*							View;
+			UInt32								Size;
+		public:
+			CodaScriptMappedFile(const char* Path);
+			~CodaScriptMappedFile();
+
+			bool								IsValid() const;
+			const void*							GetData() const;
+			UInt32								GetSize() const;
+
+			typedef std::unique_ptr<CodaScriptMappedFile>		PtrT;
+		};
+
 		template<typename T>
 		class CodaScriptSimpleInstanceCounter
 		{
@@ -1,5 +1,6 @@
 #include "CodaVM.h"
 #include "CodaUtilities.h"
+#include "CodaBenchmark.h"
 #include "..\UIManager.h"
 #include "..\BGSEditorExtenderBase_Resource.h"
 
@@ -233,12 +234,20 @@ namespace bgsee
 			ShellExecute(nullptr, "open", (LPSTR)"coda_command_doc.html", nullptr, nullptr, SW_SHOW);
 		}
 
+#define CODASCRIPTPROGRAMCACHE_INISECTION						"CodaProgramCache"
+		SME::INI::INISetting									CodaScriptProgramCache::kINI_TrackSourceChanges("TrackSourceChanges", CODASCRIPTPROGRAMCACHE_INISECTION,
+																									"Recompile cached programs when their source or the scripts they call change",
+																									(SInt32)1);
+		SME::INI::INISetting									CodaScriptProgramCache::kINI_SourceCheckInterval("SourceCheckInterval", CODASCRIPTPROGRAMCACHE_INISECTION,
+																									"Minimum interval, in milliseconds, between consecutive checks of the same source file",
+																									(SInt32)500);
+
 		ICodaScriptProgram* CodaScriptProgramCache::Lookup(const std::string& Filepath) const
 		{
 			if (Store.count(Filepath) == 0)
 				return nullptr;
 			else
-				return Store.at(Filepath).get();
+				return Store.at(Filepath).Program.get();
 		}
 
 		void CodaScriptProgramCache::Remove(const std::string& Filepath)
@@ -246,30 +255,52 @@ namespace bgsee
 			Store.erase(Filepath);
 		}
 
-		void CodaScriptProgramCache::Add(const std::string& Filepath, ICodaScriptProgram::PtrT& Program)
+		ICodaScriptProgram* CodaScriptProgramCache::Add(const std::string& Filepath, std::unique_ptr<CodaScriptProgram>& Program)
 		{
 			SME_ASSERT(Store.count(Filepath) == 0);
 
-			Store.insert(std::make_pair(Filepath, std::move(Program)));
-		}
+			if (Program->IsValid() == false)
+			{
+				VM->GetMessageHandler()->Log("Couldn't compile Coda script @ %s", Filepath.c_str());
+				Program.reset();
+				return nullptr;
+			}
 
-		CodaScriptProgramCache::CodaScriptProgramCache(ICodaScriptVirtualMachine* VM) :
-			VM(VM),
-			Store()
-		{
-			SME_ASSERT(VM);
-		}
+			// snapshot the entire known dependency graph so that changes are picked up regardless of the order in which the callees get recompiled
+			PathSetT Closure;
+			std::vector<std::string> Pending;
+			for (auto& Itr : Program->GetDependencies())
+				Pending.push_back(ResolveDependency(Itr));
 
-		CodaScriptProgramCache::~CodaScriptProgramCache()
-		{
-			for (auto& Itr : Store)
+			while (Pending.empty() == false)
 			{
-				if (VM->IsProgramExecuting(Itr.second.get()))
-					VM->GetMessageHandler()->Log("Coda script program '%s' is still executing during disposal", Itr.second->GetName().c_str());
+				std::string Current(Pending.back());
+				Pending.pop_back();
+
+				if (Closure.insert(Current).second == false)
+					continue;
+
+				ProgramMapT::const_iterator Match = Store.find(Current);
+				if (Match != Store.end())
+				{
+					for (auto& Itr : Match->second.Revisions)
+						Pending.push_back(Itr.first);
+				}
 			}
+
+			ICodaScriptProgram::PtrT Owned(std::move(Program));
+			ICodaScriptProgram* Out = Owned.get();
+			CachedProgram Entry(Owned);
+
+			Entry.Revisions[Filepath] = Stat(Filepath).Revision;
+			for (auto& Itr : Closure)
+				Entry.Revisions[Itr] = Stat(Itr).Revision;
+
+			Store.insert(std::make_pair(Filepath, std::move(Entry)));
+			return Out;
 		}
 
-		ICodaScriptProgram* CodaScriptProgramCache::Get(const ResourceLocation& Filepath, bool Recompile /*= false*/)
+		ICodaScriptProgram* CodaScriptProgramCache::Revalidate(const ResourceLocation& Filepath, bool Recompile)
 		{
 			ICodaScriptProgram* OutProgram(Lookup(Filepath()));
 
@@ -283,6 +314,16 @@ namespace bgsee
 					OutProgram = nullptr;
 				}
 			}
+			else if (OutProgram && kINI_TrackSourceChanges().i && VM->IsProgramExecuting(OutProgram) == false)
+			{
+				// recompile if the source or any of the scripts it calls have changed
+				PathSetT Visited;
+				if (IsStale(Filepath(), Visited))
+				{
+					Remove(Filepath());
+					OutProgram = nullptr;
+				}
+			}
 
 			// recompile if invalid
 			if (OutProgram && OutProgram->IsValid() == false)
@@ -292,32 +333,169 @@ namespace bgsee
 				OutProgram = nullptr;
 			}
 
+			return OutProgram;
+		}
+
+		std::string CodaScriptProgramCache::ResolveDependency(const std::string& ScriptPath) const
+		{
+			// same as the path passed by the call command
+			return ResourceLocation(VM->GetScriptRepository().GetRelativePath() + "\\" + ScriptPath + VM->GetScriptFileExtension())();
+		}
+
+		const CodaScriptProgramCache::SourceStamp& CodaScriptProgramCache::Stat(const std::string& Filepath, bool Force)
+		{
+			SourceStamp& Stamp = Stamps[Filepath];
+			UInt64 Now = GetTickCount64();
+			SInt32 Interval = kINI_SourceCheckInterval().i;
+
+			if (Force == false && Stamp.LastChecked && Interval > 0 && Now - Stamp.LastChecked < static_cast<UInt64>(Interval))
+				return Stamp;
+
+			Stamp.LastChecked = Now;
+
+			WIN32_FILE_ATTRIBUTE_DATA Attributes = { 0 };
+			UInt64 LastWriteTime = 0, Size = 0;
+			if (GetFileAttributesEx(Filepath.c_str(), GetFileExInfoStandard, &Attributes))
+			{
+				LastWriteTime = (static_cast<UInt64>(Attributes.ftLastWriteTime.dwHighDateTime) << 32) | Attributes.ftLastWriteTime.dwLowDateTime;
+				Size = (static_cast<UInt64>(Attributes.nFileSizeHigh) << 32) | Attributes.nFileSizeLow;
+			}
+
+			if (LastWriteTime == Stamp.LastWriteTime && Size == Stamp.Size)
+				return Stamp;
+
+			// the timestamp alone isn't conclusive, editors and version control tend to touch files without modifying them
+			UInt32 Hash = 0;
+			if (LastWriteTime)
+			{
+				std::fstream Stream(Filepath.c_str(), std::iostream::in | std::iostream::binary);
+				std::string Contents((std::istreambuf_iterator<char>(Stream)), std::istreambuf_iterator<char>());
+				Hash = CodaScriptHash::Compute(Contents);
+			}
+
+			if (Hash != Stamp.Hash || Size != Stamp.Size)
+				Stamp.Revision++;
+
+			Stamp.LastWriteTime = LastWriteTime;
+			Stamp.Size = Size;
+			Stamp.Hash = Hash;
+
+			return Stamp;
+		}
+
+		bool CodaScriptProgramCache::IsStale(const std::string& Filepath, PathSetT& Visited)
+		{
+			if (Visited.insert(Filepath).second == false)
+				return false;
+
+			ProgramMapT::const_iterator Match = Store.find(Filepath);
+			if (Match == Store.end())
+				return false;
+
+			for (auto& Itr : Match->second.Revisions)
+			{
+				if (Stat(Itr.first).Revision != Itr.second)
+					return true;
+			}
+
+			// dependencies that weren't cached when the program was compiled
+			for (auto& Itr : Match->second.Revisions)
+			{
+				if (IsStale(Itr.first, Visited))
+					return true;
+			}
+
+			return false;
+		}
+
+		CodaScriptProgramCache::CodaScriptProgramCache(ICodaScriptVirtualMachine* VM) :
+			VM(VM),
+			Store(),
+			Stamps(),
+			Images(VM)
+		{
+			SME_ASSERT(VM);
+		}
+
+		CodaScriptProgramCache::~CodaScriptProgramCache()
+		{
+			for (auto& Itr : Store)
+			{
+				if (VM->IsProgramExecuting(Itr.second.Program.get()))
+					VM->GetMessageHandler()->Log("Coda script program '%s' is still executing during disposal", Itr.second.Program->GetName().c_str());
+			}
+		}
+
+		ICodaScriptProgram* CodaScriptProgramCache::Get(const ResourceLocation& Filepath, bool Recompile /*= false*/)
+		{
+			ICodaScriptProgram* OutProgram(Revalidate(Filepath, Recompile));
+
 			if (OutProgram == nullptr)
 			{
+				// stamp the source before it's read so that any concurrent modification shows up on the next check
+				Stat(Filepath(), true);
+
 				// create the program context from disk
-				ICodaScriptProgram::PtrT Program(CodaScriptCompiler::Instance.Compile(VM, Filepath));
+				std::unique_ptr<CodaScriptProgram> Program(CodaScriptCompiler::Instance.Compile(VM, Filepath, &Images));
+				OutProgram = Add(Filepath(), Program);
+			}
 
-				if (Program->IsValid() == false)
-					VM->GetMessageHandler()->Log("Couldn't compile Coda script @ %s", Filepath().c_str());
-				else
+			return OutProgram;
+		}
+
+		void CodaScriptProgramCache::Get(const std::vector<ResourceLocation>& Filepaths,
+										 std::vector<ICodaScriptProgram*>& OutPrograms,
+										 bool Recompile /*= false*/)
+		{
+			std::vector<ResourceLocation> Pending;
+			PathSetT Queued;
+
+			for (auto& Itr : Filepaths)
+			{
+				if (Revalidate(Itr, Recompile) == nullptr && Queued.insert(Itr()).second)
 				{
-					OutProgram = Program.get();
-					Add(Filepath(), Program);
+					Stat(Itr(), true);
+					Pending.push_back(Itr);
 				}
 			}
 
-			return OutProgram;
+			if (Pending.empty() == false)
+			{
+				std::vector<CodaScriptProgram*> Compiled;
+				CodaScriptCompiler::BatchStatistics Statistics;
+
+				CodaScriptCompiler::Instance.Compile(VM, Pending, Compiled, &Images, &Statistics);
+				SME_ASSERT(Compiled.size() == Pending.size());
+
+				for (int i = 0; i < Pending.size(); i++)
+				{
+					std::unique_ptr<CodaScriptProgram> Program(Compiled[i]);
+					Add(Pending[i](), Program);
+				}
+
+				VM->GetMessageHandler()->Log("Compiled %d script(s) - Parsing: %.4f s on %d thread(s), Bytecode generation: %.4f s",
+											 Statistics.Programs, Statistics.FrontEndTime, Statistics.Threads, Statistics.BackEndTime);
+			}
+
+			for (auto& Itr : Filepaths)
+				OutPrograms.push_back(Lookup(Itr()));
 		}
 
 		void CodaScriptProgramCache::Invalidate()
 		{
 			for (auto& Itr : Store)
 			{
-				SME_ASSERT(CODAVM->IsProgramExecuting(Itr.second.get()) == false);
-				Itr.second->InvalidateBytecode();
+				SME_ASSERT(CODAVM->IsProgramExecuting(Itr.second.Program.get()) == false);
+				Itr.second.Program->InvalidateBytecode();
 			}
 		}
 
+		void CodaScriptProgramCache::RegisterINISettings(INISettingDepotT& Depot)
+		{
+			Depot.push_back(&kINI_TrackSourceChanges);
+			Depot.push_back(&kINI_SourceCheckInterval);
+		}
+
 
 #define CODASCRIPTEXECUTIVE_INISECTION							"CodaExecutive"
 		SME::INI::INISetting									CodaScriptExecutive::kINI_Profiling("Profiling", CODASCRIPTEXECUTIVE_INISECTION,
@@ -328,6 +506,10 @@ namespace bgsee
 																									"Maximum number of times scripts can recursively call themselves or other scripts. Large values may cause instability",
 																									(SInt32)50);
 
+		SME::INI::INISetting									CodaScriptExecutive::kINI_TailCallLimit("TailCallLimit", CODASCRIPTEXECUTIVE_INISECTION,
+																									"Maximum number of times a script can restart itself with a call in tail position before it's aborted",
+																									(SInt32)100000);
+
 		CodaScriptExecutive::ExecutingContext& CodaScriptExecutive::Push(ICodaScriptExecutionContext* Context)
 		{
 			ICodaScriptProgram* Program = Context->GetProgram();
@@ -384,9 +566,13 @@ namespace bgsee
 		{
 			SME_ASSERT(OwnerThreadID == GetCurrentThreadId());
 			SME_ASSERT(Context);
-			SME_ASSERT(Context->CanExecute());
+			SME_ASSERT(Context->CanExecute() || Context->IsSuspended());
 			SME_ASSERT(Out.HasResult() == false && Out.Success == false);
 
+			// preempted executions pick up where they left off
+			if (Context->IsSuspended())
+				Context->Resume();
+
 			ICodaScriptProgram* Program = Context->GetProgram();
 			SME_ASSERT(Program->IsValid());
 
@@ -397,17 +583,52 @@ namespace bgsee
 				return;
 			}
 
-			bool ProfilerEnabled = kINI_Profiling().i;
+			bool ProfilerEnabled = IsProfilingEnabled();
+			UInt32 BufferAllocations = mup::CodaScriptMUPParserByteCode::GetBufferAllocationCount();
 			if (ProfilerEnabled)
 				Profiler.BeginProfiling();
 
 			ExecutingContext& ExecutionData = Push(Context);
 			{
 				ICodaScriptExpressionParser::EvaluateData EvaluatorInput(Context, VM->GetGlobals());
+				if (ProfilerEnabled)
+				{
+					ExecutionData.ExecutionAgent.SetProfiler(&Profiler);
+					Profiler.EnterScript(Program, Program->GetName());
+				}
+
 				try
 				{
 					VM->GetParser()->BeginEvaluation(Program, EvaluatorInput);
 					Program->Accept(&ExecutionData.ExecutionAgent);		// doesn't throw any exceptions, so the next statement will always be executed
+
+					// calls to the program itself in tail position restart it in the current frame
+					UInt32 TailCalls = 0;
+					bool TailCallLimitHit = false;
+					while (Context->RestartTailCall())
+					{
+						if (++TailCalls >= kINI_TailCallLimit().i)
+						{
+							VM->GetMessageHandler()->Log("Maximum tail call count hit");
+							Context->FlagError();
+							TailCallLimitHit = true;
+							break;
+						}
+
+						Program->Accept(&ExecutionData.ExecutionAgent);
+					}
+
+					// without the rewrite, the self-call runs in a frame of its own and Call returns zero to the caller if it fails or has no result
+					// restarted frames keep those semantics when the program was itself invoked by Call, so an error in a tail call doesn't fail the caller
+					// top-level executions have no caller to shield and let the error through, as does runaway recursion that hit the limit
+					bool InvokedByCall = ExecutingContexts.size() > 1;
+					if (TailCalls && InvokedByCall && TailCallLimitHit == false && (Context->HasError() || Context->HasResult() == false))
+					{
+						CodaScriptBackingStore Zero(0.0);
+						Context->ResetState();
+						Context->Return(&Zero);
+					}
+
 					VM->GetParser()->EndEvaluation(Program);
 
 					Out.Success = Context->HasError() == false;
@@ -422,13 +643,18 @@ namespace bgsee
 				{
 					VM->GetMessageHandler()->Log("Unknown Runtime Error!");
 				}
+
+				if (ProfilerEnabled)
+					Profiler.LeaveScript();
 			}
 			Pop(Context);
 
 			if (ProfilerEnabled)
 			{
 				double ElapsedTime = Profiler.EndProfiling() * 1.0;
-				VM->GetMessageHandler()->Log("Profiler: %s [%.4f ms]", Context->GetProgram()->GetName().c_str(), ElapsedTime);
+				BufferAllocations = mup::CodaScriptMUPParserByteCode::GetBufferAllocationCount() - BufferAllocations;
+				VM->GetMessageHandler()->Log("Profiler: %s [%.4f ms, %d value buffer allocations]",
+											 Context->GetProgram()->GetName().c_str(), ElapsedTime, BufferAllocations);
 			}
 		}
 
@@ -475,10 +701,298 @@ namespace bgsee
 			}
 		}
 
+		CodaScriptProfiler& CodaScriptExecutive::GetProfiler()
+		{
+			return Profiler;
+		}
+
+		bool CodaScriptExecutive::IsProfilingEnabled() const
+		{
+			return kINI_Profiling().i != 0;
+		}
+
 		void CodaScriptExecutive::RegisterINISettings( INISettingDepotT& Depot )
 		{
 			Depot.push_back(&kINI_Profiling);
 			Depot.push_back(&kINI_RecursionLimit);
+			Depot.push_back(&kINI_TailCallLimit);
+		}
+
+		CodaScriptAsyncResult::CodaScriptAsyncResult(CodaScriptMessageHandler* MessageHandler) :
+			Lock(),
+			Completed(),
+			Done(false),
+			Replayed(false),
+			Result(),
+			Messages(),
+			MessageHandler(MessageHandler)
+		{
+			SME_ASSERT(MessageHandler);
+		}
+
+		CodaScriptAsyncResult::~CodaScriptAsyncResult()
+		{
+			;//
+		}
+
+		void CodaScriptAsyncResult::Complete()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Done = true;
+			}
+
+			Completed.notify_all();
+		}
+
+		bool CodaScriptAsyncResult::IsReady() const
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			return Done;
+		}
+
+		bool CodaScriptAsyncResult::Wait(UInt32 Timeout /*= INFINITE*/)
+		{
+			std::unique_lock<std::mutex> Guard(Lock);
+			if (Timeout == INFINITE)
+			{
+				Completed.wait(Guard, [this]() { return Done; });
+				return true;
+			}
+			else
+				return Completed.wait_for(Guard, std::chrono::milliseconds(Timeout), [this]() { return Done; });
+		}
+
+		const ICodaScriptVirtualMachine::ExecuteResult& CodaScriptAsyncResult::Get()
+		{
+			Wait();
+
+			if (Replayed == false)
+			{
+				Replayed = true;
+				MessageHandler->Replay(Messages);
+			}
+
+			return Result;
+		}
+
+		SME::INI::INISetting									CodaScriptAsyncExecutive::kINI_WorkerThreads("AsyncWorkerThreads", CODASCRIPTEXECUTIVE_INISECTION,
+																										"Number of worker threads that execute thread-safe scripts asynchronously. Zero defaults to the number of hardware threads",
+																										(SInt32)2);
+
+		thread_local ICodaScriptExecutor*						CodaScriptAsyncExecutive::ThreadExecutor = nullptr;
+
+		void CodaScriptAsyncExecutive::Run(ICodaScriptExecutionContext* Context, std::shared_ptr<CodaScriptAsyncResult> Out)
+		{
+			ICodaScriptProgram* Program = Context->GetProgram();
+
+			{
+				CodaScriptExecutive Executive(VM);
+				ThreadExecutor = &Executive;
+
+				// the console can only be written to from the main thread
+				VM->GetMessageHandler()->BeginTranscript(&Out->Messages);
+				Executive.Execute(Context, Out->Result);
+				VM->GetMessageHandler()->EndTranscript();
+
+				ThreadExecutor = nullptr;
+			}
+
+			delete Context;
+			Retire(Program, Out);
+		}
+
+		void CodaScriptAsyncExecutive::RunPartition(ICodaScriptExecutionContext* Context,
+													ICodaScriptVirtualMachine::BatchParameterArrayT& Parameters,
+													ICodaScriptVirtualMachine::BatchResultArrayT& OutResults,
+													UInt32 Start, UInt32 End, std::shared_ptr<CodaScriptAsyncResult> Out)
+		{
+			ICodaScriptProgram* Program = Context->GetProgram();
+
+			{
+				CodaScriptExecutive Executive(VM);
+				ThreadExecutor = &Executive;
+
+				VM->GetMessageHandler()->BeginTranscript(&Out->Messages);
+				for (UInt32 i = Start; i < End && Program->IsValid(); i++)
+				{
+					try
+					{
+						// the context is reused for every input of the partition, its evaluation state stays warm
+						if (i != Start)
+							Context->ResetState(true);
+
+						// arrays are passed by reference, so every input is executed with copies of them to keep the partitions from modifying them concurrently
+						// the source arrays are only read here, which is safe as reading an array doesn't modify it
+						CodaScriptBackingStore::NonPtrArrayT Input(Parameters[i]);
+						IsolateParameters(Input);
+
+						Context->SetParameters(Input);
+						Executive.Execute(Context, OutResults[i]);
+					}
+					catch (CodaScriptException& E)
+					{
+						VM->GetMessageHandler()->Log("Couldn't execute script '%s' - %s", Program->GetName().c_str(), E.ToString().c_str());
+					}
+				}
+				VM->GetMessageHandler()->EndTranscript();
+
+				ThreadExecutor = nullptr;
+			}
+
+			// the context is owned by the caller of the batch
+			Retire(Program, Out);
+		}
+
+		void CodaScriptAsyncExecutive::Retire(ICodaScriptProgram* Program, std::shared_ptr<CodaScriptAsyncResult> Out)
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				auto Match = ExecutingPrograms.find(Program);
+				SME_ASSERT(Match != ExecutingPrograms.end() && Match->second);
+
+				if (--Match->second == 0)
+					ExecutingPrograms.erase(Match);
+			}
+
+			Out->Complete();
+		}
+
+		ICodaScriptArrayDataType::SharedPtrT CodaScriptAsyncExecutive::CopyArray(const ICodaScriptArrayDataType::SharedPtrT& Source, ArrayCopyMapT& Copies)
+		{
+			auto Match = Copies.find(Source.get());
+			if (Match != Copies.end())
+				return Match->second;
+
+			// the copy is registered before its elements are visited to preserve self-references
+			ICodaScriptArrayDataType::SharedPtrT Copy(Source->Clone());
+			Copies[Source.get()] = Copy;
+
+			for (UInt32 i = 0; i < Source->Size(); i++)
+			{
+				// packed elements can't be arrays
+				const CodaScriptBackingStore* Element = Source->Peek(i);
+				if (Element && Element->GetType() == ICodaScriptDataStore::kDataType_Array)
+					Copy->Insert(CopyArray(Element->GetArray(), Copies), i, true);
+			}
+
+			return Copy;
+		}
+
+		CodaScriptWorkerPool* CodaScriptAsyncExecutive::GetWorkers()
+		{
+			if (Workers == nullptr)
+				Workers.reset(new CodaScriptWorkerPool(max(kINI_WorkerThreads().i, 0)));
+
+			return Workers.get();
+		}
+
+		CodaScriptAsyncExecutive::CodaScriptAsyncExecutive(ICodaScriptVirtualMachine* VM) :
+			VM(VM),
+			Workers(),
+			ExecutingPrograms(),
+			Lock()
+		{
+			SME_ASSERT(VM);
+		}
+
+		CodaScriptAsyncExecutive::~CodaScriptAsyncExecutive()
+		{
+			// the pool drains its queue before joining
+			Workers.reset(nullptr);
+			SME_ASSERT(ExecutingPrograms.empty());
+		}
+
+		ICodaScriptAsyncResult::PtrT CodaScriptAsyncExecutive::Queue(ICodaScriptExecutionContext* Context)
+		{
+			SME_ASSERT(Context && Context->CanExecute());
+
+			ICodaScriptProgram* Program = Context->GetProgram();
+			SME_ASSERT(Program->IsThreadSafe());
+
+			std::shared_ptr<CodaScriptAsyncResult> Out(new CodaScriptAsyncResult(VM->GetMessageHandler()));
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				ExecutingPrograms[Program]++;
+			}
+
+			GetWorkers()->Enqueue([this, Context, Out]() { Run(Context, Out); });
+			return Out;
+		}
+
+		void CodaScriptAsyncExecutive::Batch(ICodaScriptProgram* Program,
+											 ICodaScriptVirtualMachine::BatchParameterArrayT& Parameters,
+											 ICodaScriptVirtualMachine::BatchResultArrayT& OutResults)
+		{
+			SME_ASSERT(Program->IsThreadSafe());
+			SME_ASSERT(OutResults.size() == Parameters.size());
+
+			const UInt32 Count = Parameters.size();
+			const UInt32 Partitions = min(GetWorkers()->GetThreadCount(), Count);
+			if (Partitions == 0)
+				return;
+
+			std::vector<ICodaScriptExecutionContext::PtrT> Contexts;
+			std::vector<std::shared_ptr<CodaScriptAsyncResult>> Handles;
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				ExecutingPrograms[Program] += Partitions;
+			}
+
+			// contiguous partitions of (nearly) equal size, each executed with a single context
+			for (UInt32 i = 0, Start = 0; i < Partitions; i++)
+			{
+				UInt32 End = Start + Count / Partitions + (i < Count % Partitions ? 1 : 0);
+
+				// the program's pool is only accessed on the main thread, so the contexts are acquired upfront
+				ICodaScriptExecutionContext* Context = Program->AcquireContext();
+				if (Context == nullptr)
+					Context = new CodaScriptExecutionContext(VM, Program);
+
+				std::shared_ptr<CodaScriptAsyncResult> Out(new CodaScriptAsyncResult(VM->GetMessageHandler()));
+				Contexts.push_back(ICodaScriptExecutionContext::PtrT(Context));
+				Handles.push_back(Out);
+
+				// the inputs and outputs outlive the tasks as the call blocks until they complete
+				GetWorkers()->Enqueue([this, Context, &Parameters, &OutResults, Start, End, Out]() {
+					RunPartition(Context, Parameters, OutResults, Start, End, Out);
+				});
+
+				Start = End;
+			}
+
+			// waits for the partitions and replays their messages in input order
+			for (auto& Itr : Handles)
+				Itr->Get();
+
+			for (auto& Itr : Contexts)
+				Program->ReleaseContext(Itr.release());
+		}
+
+		bool CodaScriptAsyncExecutive::IsProgramExecuting(ICodaScriptProgram* Program) const
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			return ExecutingPrograms.count(Program) != 0;
+		}
+
+		ICodaScriptExecutor* CodaScriptAsyncExecutive::GetThreadExecutor()
+		{
+			return ThreadExecutor;
+		}
+
+		void CodaScriptAsyncExecutive::IsolateParameters(CodaScriptBackingStore::NonPtrArrayT& Parameters)
+		{
+			ArrayCopyMapT Copies;
+			for (auto& Itr : Parameters)
+			{
+				if (Itr.GetType() == ICodaScriptDataStore::kDataType_Array)
+					Itr.SetArray(CopyArray(Itr.GetArray(), Copies));
+			}
+		}
+
+		void CodaScriptAsyncExecutive::RegisterINISettings(INISettingDepotT& Depot)
+		{
+			Depot.push_back(&kINI_WorkerThreads);
 		}
 
 
@@ -492,12 +1006,9 @@ namespace bgsee
 		SME::INI::INISetting									CodaScriptBackgrounder::kINI_LogToDefaultConsoleContext("LogToDefaultConsoleContext", CODASCRIPTBACKGROUNDER_INISECTION,
 																									 "Print console output to the default context (in addition to the Coda Script context)",
 																									 (SInt32)1);
-
-		VOID CALLBACK CodaScriptBackgrounder::CallbackProc( HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime )
-		{
-			CodaScriptBackgrounder* Daemon = (CodaScriptBackgrounder*)idEvent;
-			Daemon->Tick();
-		}
+		SME::INI::INISetting									CodaScriptBackgrounder::kINI_TickBudget("TickBudget", CODASCRIPTBACKGROUNDER_INISECTION,
+																						"Duration, in milliseconds, background scripts are allowed to run per update. Zero disables preemption",
+																						(SInt32)5);
 
 		void CodaScriptBackgrounder::ResetDepotCache(bool Renew /*= false*/ )
 		{
@@ -507,24 +1018,41 @@ namespace bgsee
 
 			if (Renew)
 			{
+				std::vector<std::string> Filenames;
+				std::vector<ResourceLocation> Filepaths;
+				std::vector<ICodaScriptProgram*> Programs;
+				CodaScriptElapsedTimeCounterT LoadTimer;
+
+				LoadTimer.Update();
 				for (IDirectoryIterator Itr(SourceDepot().c_str(),
 					(std::string("*" + VM->GetScriptFileExtension())).c_str()); !Itr.Done(); Itr.Next())
 				{
-					std::string FullPath = SourceDepot.GetRelativePath() + "\\" + std::string(Itr.Get()->cFileName);
-					VM->GetMessageHandler()->Log("Script: %s", Itr.Get()->cFileName);
+					Filenames.push_back(Itr.Get()->cFileName);
+					Filepaths.push_back(ResourceLocation(SourceDepot.GetRelativePath() + "\\" + Filenames.back()));
+				}
+
+				// the scripts are independent of each other, so they're compiled in one go
+				VM->GetProgramCache()->Get(Filepaths, Programs, true);
+
+				for (int i = 0; i < Filepaths.size(); i++)
+				{
+					ICodaScriptProgram* BackgroundScript = Programs[i];
+					VM->GetMessageHandler()->Log("Script: %s", Filenames[i].c_str());
 					VM->GetMessageHandler()->Indent();
 					{
-						ICodaScriptProgram* BackgroundScript = VM->GetProgramCache()->Get(FullPath, true);
 						if (BackgroundScript)
 						{
 							VM->GetMessageHandler()->Log("Success: %s [%.4f s]", BackgroundScript->GetName().c_str(), BackgroundScript->GetPollingInteval());
 
 							ICodaScriptExecutionContext::PtrT Context(new CodaScriptExecutionContext(VM, BackgroundScript));
-							DepotCache.push_back(std::move(Context));
+							DepotCache.emplace_back(std::move(Context));
 						}
 					}
 					VM->GetMessageHandler()->Outdent();
 				}
+
+				LoadTimer.Update();
+				VM->GetMessageHandler()->Log("Loaded %d/%d background scripts in %.4f s", DepotCache.size(), Filepaths.size(), LoadTimer.GetTimePassed() / 1000.0);
 			}
 		}
 
@@ -532,24 +1060,21 @@ namespace bgsee
 		{
 			SME_ASSERT(Backgrounding == false);
 
-			if (TimerDummyWindow)
-				KillTimer(TimerDummyWindow, (UINT_PTR)this);
+			TickSource->Stop();
 
 			if (Renew)
 			{
-				SME_ASSERT(TimerDummyWindow);
-
 				UInt32 UpdatePeriod = kINI_UpdatePeriod.GetData().i;
-				UINT_PTR Result = SetTimer(TimerDummyWindow, (UINT_PTR)this, UpdatePeriod, &CallbackProc);
-				SME_ASSERT(Result);
+				LastTickTime = TickSource->GetTime();
+				TickSource->Start(UpdatePeriod, [this]() { Tick(); });
 			}
 		}
 
-		void CodaScriptBackgrounder::Execute( ContextArrayT& Cache,  double TimePassed )
+		void CodaScriptBackgrounder::Schedule(ContextArrayT& Cache, double TimePassed, RunQueueT& OutQueue)
 		{
 			for (auto Itr = Cache.begin(); Itr != Cache.end();)
 			{
-				ICodaScriptExecutionContext* BackgroundScript = (*Itr).get();
+				ICodaScriptExecutionContext* BackgroundScript = Itr->Context.get();
 				if (BackgroundScript->GetProgram()->IsValid() == false)
 				{
 					VM->GetMessageHandler()->Log("Background script '%s' halted - Invalid program", BackgroundScript->GetProgram()->GetName().c_str());
@@ -557,36 +1082,70 @@ namespace bgsee
 					continue;
 				}
 
-				if (BackgroundScript->TickPollingInterval(TimePassed))
-				{
-					if (IsEnabled())
-					{
-						if (kINI_LogToDefaultConsoleContext().i == 0)
-							VM->GetMessageHandler()->SuspendDefaultContextLogging();
-						else
-							VM->GetMessageHandler()->Indent();
+				// preempted scripts are resumed as soon as possible, regardless of their polling interval
+				if (BackgroundScript->IsSuspended())
+					Itr->Pending = true;
+				else if (BackgroundScript->TickPollingInterval(TimePassed) && IsEnabled())
+					Itr->Pending = true;
 
-						ICodaScriptVirtualMachine::ExecuteResult Result;
-						VM->GetExecutor()->Execute(BackgroundScript, Result);
+				if (Itr->Pending)
+					OutQueue.push_back(&(*Itr));
 
-						if (kINI_LogToDefaultConsoleContext().i == 0)
-							VM->GetMessageHandler()->ResumeDefaultContextLogging();
-						else
-							VM->GetMessageHandler()->Outdent();
+				Itr++;
+			}
+		}
 
-						if (BackgroundScript->CanExecute() == false)
-						{
-							if (BackgroundScript->HasError())
-								VM->GetMessageHandler()->Log("Background script '%s' halted - Unhandled exception", BackgroundScript->GetProgram()->GetName().c_str());
+		double CodaScriptBackgrounder::Execute(ScheduledContext& Script, double TimeSlice)
+		{
+			ICodaScriptExecutionContext* BackgroundScript = Script.Context.get();
+			CodaScriptElapsedTimeCounterT ExecutionTimer;
+			ICodaScriptVirtualMachine::ExecuteResult Result;
 
-							Itr = Cache.erase(Itr);
-							continue;
-						}
-					}
+			if (kINI_LogToDefaultConsoleContext().i == 0)
+				VM->GetMessageHandler()->SuspendDefaultContextLogging();
+			else
+				VM->GetMessageHandler()->Indent();
+
+			BackgroundScript->SetTimeSlice(TimeSlice);
+			ExecutionTimer.Update();
+			VM->GetExecutor()->Execute(BackgroundScript, Result);
+			ExecutionTimer.Update();
+
+			if (kINI_LogToDefaultConsoleContext().i == 0)
+				VM->GetMessageHandler()->ResumeDefaultContextLogging();
+			else
+				VM->GetMessageHandler()->Outdent();
+
+			double Elapsed = ExecutionTimer.GetTimePassed();
+			double Budget = kINI_TickBudget().i;
+
+			// preemption only happens between statements, so long-running commands can still overrun the budget
+			if (Budget > 0 && Elapsed > Budget)
+			{
+				Script.Overruns++;
+				if (Script.Overruns == 1 || Script.Overruns % kOverrunReportInterval == 0)
+				{
+					VM->GetMessageHandler()->Log("Background script '%s' overran the update budget - %.4f ms, %d overrun(s) so far",
+												 BackgroundScript->GetProgram()->GetName().c_str(), Elapsed, Script.Overruns);
 				}
+			}
 
-				Itr++;
+			Script.DeferredTicks = 0;
+			if (BackgroundScript->IsSuspended() == false)
+			{
+				Script.Pending = false;
+				if (BackgroundScript->HasError())
+					VM->GetMessageHandler()->Log("Background script '%s' halted - Unhandled exception", BackgroundScript->GetProgram()->GetName().c_str());
 			}
+
+			return Elapsed;
+		}
+
+		void CodaScriptBackgrounder::Prune(ContextArrayT& Cache)
+		{
+			Cache.erase(std::remove_if(Cache.begin(), Cache.end(), [](const ScheduledContext& Script) {
+				return Script.Context->IsSuspended() == false && Script.Context->CanExecute() == false;
+			}), Cache.end());
 		}
 
 		void CodaScriptBackgrounder::Tick()
@@ -597,40 +1156,54 @@ namespace bgsee
 
 			SME::MiscGunk::ScopedSetter<bool> GuardBackgrounding(Backgrounding, true);
 
-			PollingTimeCounter.Update();
-			double TimePassed = PollingTimeCounter.GetTimePassed() / 1000.0f;
+			double Now = TickSource->GetTime();
+			double TimePassed = (Now - LastTickTime) / 1000.0;
+			LastTickTime = Now;
 
-			Execute(DepotCache, TimePassed);
-			Execute(RuntimeCache, TimePassed);
+			RunQueueT RunQueue;
+			Schedule(DepotCache, TimePassed, RunQueue);
+			Schedule(RuntimeCache, TimePassed, RunQueue);
+
+			if (IsEnabled() && RunQueue.size())
+			{
+				// scripts that have been waiting the longest go first, whatever doesn't fit in the budget rolls over to the next tick
+				std::stable_sort(RunQueue.begin(), RunQueue.end(), [](const ScheduledContext* A, const ScheduledContext* B) {
+					return A->DeferredTicks > B->DeferredTicks;
+				});
+
+				double Budget = kINI_TickBudget().i, Used = 0.0;
+				for (auto Itr : RunQueue)
+				{
+					if (Budget > 0 && Used >= Budget)
+						Itr->DeferredTicks++;
+					else
+						Used += Execute(*Itr, Budget > 0 ? Budget - Used : 0.0);
+				}
+			}
+
+			Prune(DepotCache);
+			Prune(RuntimeCache);
 		}
 
 		CodaScriptBackgrounder::CodaScriptBackgrounder(ICodaScriptVirtualMachine* VM,
 													   ResourceLocation Source,
 													   INIManagerGetterFunctor Getter,
-													   INIManagerSetterFunctor Setter ) :
+													   INIManagerSetterFunctor Setter,
+													   ICodaScriptTickSource* TickSource) :
 			SourceDepot(Source),
 			DepotCache(),
 			RuntimeCache(),
 			State(false),
 			Backgrounding(false),
-			TimerDummyWindow(NULL),
-			PollingTimeCounter(),
+			TickSource(TickSource),
+			LastTickTime(0),
 			VM(VM),
 			INISettingGetter(Getter),
 			INISettingSetter(Setter)
 		{
-			SME_ASSERT(VM);
+			SME_ASSERT(VM && TickSource);
 			State = kINI_Enabled.GetData().i;
 
-			const char* ClassName = "BACKGROUNDER_TIMER_WINDOW";
-			WNDCLASSEX wx = {};
-			wx.cbSize = sizeof(WNDCLASSEX);
-			wx.lpfnWndProc = [](HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) { return DefWindowProc(hWnd, uMsg, wParam, lParam); };
-			wx.hInstance = BGSEEMAIN->GetExtenderHandle();
-			wx.lpszClassName = ClassName;
-			SME_ASSERT(RegisterClassEx(&wx));
-
-			TimerDummyWindow = CreateWindowEx(0, ClassName, ClassName, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, NULL, NULL);
 			ResetTimer(true);
 		}
 
@@ -642,7 +1215,6 @@ namespace bgsee
 			ResetDepotCache();
 			RuntimeCache.clear();
 
-			DestroyWindow(TimerDummyWindow);
 			kINI_Enabled.SetInt(State);
 		}
 
@@ -651,6 +1223,7 @@ namespace bgsee
 			Depot.push_back(&kINI_Enabled);
 			Depot.push_back(&kINI_UpdatePeriod);
 			Depot.push_back(&kINI_LogToDefaultConsoleContext);
+			Depot.push_back(&kINI_TickBudget);
 		}
 
 		const ResourceLocation& CodaScriptBackgrounder::GetBackgroundScriptRepository() const
@@ -695,20 +1268,20 @@ namespace bgsee
 			SME_ASSERT(Context->CanExecute());
 
 			ICodaScriptExecutionContext::PtrT NewScript(Context);
-			RuntimeCache.push_back(std::move(NewScript));
+			RuntimeCache.emplace_back(std::move(NewScript));
 		}
 
 		bool CodaScriptBackgrounder::IsContextBackgrounding(ICodaScriptExecutionContext* Context) const
 		{
 			for (auto& Itr : RuntimeCache)
 			{
-				if (Itr.get() == Context)
+				if (Itr.Context.get() == Context)
 					return true;
 			}
 
 			for (auto& Itr : DepotCache)
 			{
-				if (Itr.get() == Context)
+				if (Itr.Context.get() == Context)
 					return true;
 			}
 
@@ -1079,6 +1652,129 @@ namespace bgsee
 			CODAVM->CommandRegistry->Dump("coda_command_doc.html");
 		}
 
+		bgsee::ConsoleCommandInfo		CodaScriptVM::kSetCodaBackendConsoleCommandData =
+		{
+			"SetCodaBackend",
+			2,
+			CodaScriptVM::SetCodaBackendConsoleCommandHandler
+		};
+
+		void CodaScriptVM::SetCodaBackendConsoleCommandHandler(UInt32 ParamCount, const char* Args)
+		{
+			// SetCodaBackend <script path relative to the repository, sans extension> <rpn|register|default>
+			CodaScriptVM* VM = CODAVM;
+			SME::StringHelpers::Tokenizer ArgParser(Args, " ,");
+			std::string ScriptPath, Backend;
+
+			ArgParser.NextToken(ScriptPath);
+			ArgParser.NextToken(Backend);
+
+			mup::CodaScriptMUPExpressionParser* Parser = dynamic_cast<mup::CodaScriptMUPExpressionParser*>(VM->GetParser());
+			if (Parser == nullptr)
+			{
+				VM->MessageHandler->Log("The current expression parser has no alternate evaluation backends");
+				return;
+			}
+			else if (VM->Executive->IsBusy() || VM->Backgrounder->IsBackgrounding())
+			{
+				VM->MessageHandler->Log("Cannot switch evaluation backends while scripts are executing");
+				return;
+			}
+
+			ResourceLocation Path(VM->BaseDirectory.GetRelativePath() + "\\" + ScriptPath + kSourceExtension);
+			if (!_stricmp(Backend.c_str(), "rpn"))
+				Parser->SetEvaluationBackend(Path, mup::CodaScriptMUPEvaluationBackend::RPN);
+			else if (!_stricmp(Backend.c_str(), "register"))
+				Parser->SetEvaluationBackend(Path, mup::CodaScriptMUPEvaluationBackend::Register);
+			else if (!_stricmp(Backend.c_str(), "default"))
+				Parser->ResetEvaluationBackend(Path);
+			else
+			{
+				VM->MessageHandler->Log("Invalid evaluation backend '%s' - Expected rpn, register or default", Backend.c_str());
+				return;
+			}
+
+			// the backend is picked up during compilation
+			if (ResourceLocation::IsRelativeTo(Path, VM->Backgrounder->GetBackgroundScriptRepository()))
+				VM->Backgrounder->Rebuild();
+			else
+				VM->ProgramCache->Get(Path, true);
+
+			VM->MessageHandler->Log("Evaluation backend for '%s' set to %s", ScriptPath.c_str(), Backend.c_str());
+		}
+
+		bgsee::ConsoleCommandInfo		CodaScriptVM::kCodaBenchmarkConsoleCommandData =
+		{
+			"CodaBenchmark",
+			1,
+			CodaScriptVM::CodaBenchmarkConsoleCommandHandler
+		};
+
+		bgsee::ConsoleCommandInfo		CodaScriptVM::kCodaProfilerConsoleCommandData =
+		{
+			"CodaProfiler",
+			1,
+			CodaScriptVM::CodaProfilerConsoleCommandHandler
+		};
+
+		void CodaScriptVM::CodaProfilerConsoleCommandHandler(UInt32 ParamCount, const char* Args)
+		{
+			// CodaProfiler <report [line count]|dump [path]|reset>
+			CodaScriptVM* VM = CODAVM;
+			SME::StringHelpers::Tokenizer ArgParser(Args, " ,");
+			std::string Operation, Argument;
+
+			ArgParser.NextToken(Operation);
+			ArgParser.NextToken(Argument);
+
+			CodaScriptProfiler& Profiler = VM->Executive->GetProfiler();
+			if (Profiler.IsInstrumenting())
+			{
+				VM->MessageHandler->Log("Cannot access the profiler while scripts are executing");
+				return;
+			}
+			else if (VM->Executive->IsProfilingEnabled() == false)
+				VM->MessageHandler->Log("Profiling is disabled - Records will not be updated");
+
+			if (!_stricmp(Operation.c_str(), "report"))
+			{
+				int Count = Argument.empty() ? 25 : atoi(Argument.c_str());
+				Profiler.LogHotLines(VM->MessageHandler.get(), Count > 0 ? Count : 25);
+			}
+			else if (!_stricmp(Operation.c_str(), "dump"))
+			{
+				std::string Path(Argument.empty() ? "coda_profile.folded" : Argument);
+				if (Profiler.DumpCollapsedStacks(Path.c_str()))
+					VM->MessageHandler->Log("Collapsed stacks written to %s", Path.c_str());
+				else
+					VM->MessageHandler->Log("Couldn't write collapsed stacks to %s", Path.c_str());
+			}
+			else if (!_stricmp(Operation.c_str(), "reset"))
+			{
+				Profiler.Reset();
+				VM->MessageHandler->Log("Profiler records discarded");
+			}
+			else
+				VM->MessageHandler->Log("Invalid operation '%s' - Expected report, dump or reset", Operation.c_str());
+		}
+
+		void CodaScriptVM::CodaBenchmarkConsoleCommandHandler(UInt32 ParamCount, const char* Args)
+		{
+			// CodaBenchmark <suite> [scale]
+			CodaScriptVM* VM = CODAVM;
+			SME::StringHelpers::Tokenizer ArgParser(Args, " ,");
+			std::string Suite, Scale;
+
+			ArgParser.NextToken(Suite);
+			ArgParser.NextToken(Scale);
+
+			if (CodaScriptBenchmarks::Run(VM, Suite.c_str(), Scale.empty() ? 0 : atoi(Scale.c_str())) == false)
+			{
+				VM->MessageHandler->Log("Unknown benchmark suite '%s'", Suite.c_str());
+				CodaScriptBenchmarks::ListSuites(VM);
+			}
+		}
+
 		CodaScriptVM::CodaScriptVM(ResourceLocation BasePath,
 								   const char* WikiURL,
 								   INIManagerGetterFunctor INIGetter,
@@ -1090,8 +1786,10 @@ namespace bgsee
 			MessageHandler(new CodaScriptMessageHandler("Coda Script")),
 			ProgramCache(new CodaScriptProgramCache(this)),
 			Executive(new CodaScriptExecutive(this)),
+			AsyncExecutive(new CodaScriptAsyncExecutive(this)),
 			Backgrounder(new CodaScriptBackgrounder(this,
-													BaseDirectory.GetRelativePath() + "\\" + kBackgroundDepotName, INIGetter, INISetter)),
+													BaseDirectory.GetRelativePath() + "\\" + kBackgroundDepotName, INIGetter, INISetter,
+													new CodaScriptWin32TickSource())),
 			GlobalStore(new CodaScriptGlobalDataStore(this, INIGetter, INISetter)),
 			ExpressionParser(BuildExpressionParser()),
 			Initialized(false)
@@ -1107,6 +1805,9 @@ namespace bgsee
 
 			// register console command
 			BGSEECONSOLE->RegisterConsoleCommand(&kDumpCodaDocsConsoleCommandData);
+			BGSEECONSOLE->RegisterConsoleCommand(&kSetCodaBackendConsoleCommandData);
+			BGSEECONSOLE->RegisterConsoleCommand(&kCodaBenchmarkConsoleCommandData);
+			BGSEECONSOLE->RegisterConsoleCommand(&kCodaProfilerConsoleCommandData);
 
 			Backgrounder->Rebuild();
 		}
@@ -1114,6 +1815,7 @@ namespace bgsee
 		CodaScriptVM::~CodaScriptVM()
 		{
 			// we need to release the following pointers in an order-dependent fashion
+			AsyncExecutive.reset(nullptr);
 			GlobalStore.reset(nullptr);
 			Backgrounder.reset(nullptr);
 			ProgramCache.reset(nullptr);
@@ -1285,6 +1987,11 @@ namespace bgsee
 
 		ICodaScriptExecutor* CodaScriptVM::GetExecutor() const
 		{
+			// scripts executing on worker threads are tracked by executives of their own
+			ICodaScriptExecutor* WorkerExecutive = CodaScriptAsyncExecutive::GetThreadExecutor();
+			if (WorkerExecutive)
+				return WorkerExecutive;
+
 			return Executive.get();
 		}
 
@@ -1300,7 +2007,11 @@ namespace bgsee
 
 		bool CodaScriptVM::IsProgramExecuting(ICodaScriptProgram* Program) const
 		{
-			return Executive->IsProgramExecuting(Program);
+			if (Executive->IsProgramExecuting(Program))
+				return true;
+
+			// the async executive is released first during disposal
+			return AsyncExecutive && AsyncExecutive->IsProgramExecuting(Program);
 		}
 
 		void CodaScriptVM::RunScript(ExecuteParams& Input, ExecuteResult& Output)
@@ -1318,7 +2029,11 @@ namespace bgsee
 			{
 				try
 				{
-					ICodaScriptExecutionContext::PtrT Context(new CodaScriptExecutionContext(this, Program));
+					// background contexts are owned by the backgrounder and never make it back into the pool
+					ICodaScriptExecutionContext::PtrT Context(Input.RunInBackground ? nullptr : Program->AcquireContext());
+					if (Context == nullptr)
+						Context.reset(new CodaScriptExecutionContext(this, Program));
+
 					Context->SetParameters(Input.Parameters);
 
 					if (Input.RunInBackground)
@@ -1327,13 +2042,103 @@ namespace bgsee
 						Output.Success = true;
 					}
 					else
+					{
 						Executive->Execute(Context.get(), Output);
+						Program->ReleaseContext(Context.release());
+					}
+				}
+				catch (CodaScriptException& E)
+				{
+					MessageHandler->Log("Couldn't execute script '%s' - %s", Program->GetName().c_str(), E.ToString().c_str());
+				}
+			}
+		}
+
+		ICodaScriptAsyncResult::PtrT CodaScriptVM::RunScriptAsync(ExecuteParams& Input)
+		{
+			ResourceLocation Path(Input.Program ? Input.Program->GetFilepath().GetRelativePath() :
+								BaseDirectory.GetRelativePath() + "\\" + Input.Filepath + CodaScriptVM::kSourceExtension);
+			if (ResourceLocation::IsRelativeTo(Path, Backgrounder->GetBackgroundScriptRepository()))
+			{
+				MessageHandler->Log("Cannot execute background script '%s' manually", Input.Filepath.c_str());
+				return nullptr;
+			}
+
+			ICodaScriptProgram* Program = ProgramCache->Get(Path, Input.Recompile);
+			if (Program == nullptr || Program->IsValid() == false)
+				return nullptr;
+			else if (Program->IsThreadSafe() == false)
+			{
+				MessageHandler->Log("Cannot execute script '%s' asynchronously - %s", Program->GetName().c_str(),
+									Program->GetCompilerMetadata()->GetThreadSafetyViolation());
+				return nullptr;
+			}
+
+			try
+			{
+				// the context is released on the worker thread, so it doesn't go back into the program's pool
+				ICodaScriptExecutionContext::PtrT Context(new CodaScriptExecutionContext(this, Program));
+
+				// the caller can modify the arrays it passed while the script is executing
+				CodaScriptBackingStore::NonPtrArrayT Parameters(Input.Parameters);
+				CodaScriptAsyncExecutive::IsolateParameters(Parameters);
+
+				Context->SetParameters(Parameters);
+
+				return AsyncExecutive->Queue(Context.release());
+			}
+			catch (CodaScriptException& E)
+			{
+				MessageHandler->Log("Couldn't execute script '%s' - %s", Program->GetName().c_str(), E.ToString().c_str());
+			}
+
+			return nullptr;
+		}
+
+		void CodaScriptVM::RunBatch(ICodaScriptProgram* Program, BatchParameterArrayT& Parameters, BatchResultArrayT& OutResults)
+		{
+			SME_ASSERT(Program);
+			SME_ASSERT(CodaScriptAsyncExecutive::GetThreadExecutor() == nullptr);
+
+			OutResults.clear();
+			OutResults.resize(Parameters.size());
+
+			if (ResourceLocation::IsRelativeTo(Program->GetFilepath(), Backgrounder->GetBackgroundScriptRepository()))
+			{
+				MessageHandler->Log("Cannot execute background script '%s' manually", Program->GetName().c_str());
+				return;
+			}
+			else if (Program->IsValid() == false || Parameters.empty())
+				return;
+
+			if (Program->IsThreadSafe() && Parameters.size() > 1)
+			{
+				AsyncExecutive->Batch(Program, Parameters, OutResults);
+				return;
+			}
+
+			// programs that aren't thread-safe are executed in order on the main thread, still with a single context
+			ICodaScriptExecutionContext::PtrT Context(Program->AcquireContext());
+			if (Context == nullptr)
+				Context.reset(new CodaScriptExecutionContext(this, Program));
+
+			for (UInt32 i = 0; i < Parameters.size() && Program->IsValid(); i++)
+			{
+				try
+				{
+					if (i)
+						Context->ResetState(true);
+
+					Context->SetParameters(Parameters[i]);
+					Executive->Execute(Context.get(), OutResults[i]);
 				}
 				catch (CodaScriptException& E)
 				{
 					MessageHandler->Log("Couldn't execute script '%s' - %s", Program->GetName().c_str(), E.ToString().c_str());
 				}
 			}
+
+			Program->ReleaseContext(Context.release());
 		}
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "..\Console.h"
 #include "CodaCompiler.h"
 #include "CodaInterpreter.h"
+#include "CodaTickSource.h"
 
 namespace bgsee
 {
@@ -34,19 +35,59 @@ namespace bgsee
 
 		class CodaScriptProgramCache : public ICodaScriptProgramCache
 		{
-			typedef std::unordered_map<std::string, ICodaScriptProgram::PtrT>		ProgramMapT;		// key = file path
+			friend class CodaScriptBenchmarks;
+
+			static INISetting				kINI_TrackSourceChanges;
+			static INISetting				kINI_SourceCheckInterval;
+
+			struct SourceStamp
+			{
+				UInt64						LastWriteTime;
+				UInt64						Size;
+				UInt32						Hash;
+				UInt32						Revision;			// incremented every time the contents change
+				UInt64						LastChecked;		// tick count of the last stat
+
+				SourceStamp() : LastWriteTime(0), Size(0), Hash(0), Revision(0), LastChecked(0) {}
+			};
+
+			typedef std::unordered_map<std::string, UInt32>		RevisionMapT;		// key = file path
+
+			struct CachedProgram
+			{
+				ICodaScriptProgram::PtrT	Program;
+				RevisionMapT				Revisions;			// revisions of the source and its direct dependencies at compile time
+
+				CachedProgram(ICodaScriptProgram::PtrT& Program) : Program(std::move(Program)), Revisions() {}
+			};
+
+			typedef std::unordered_map<std::string, CachedProgram>		ProgramMapT;		// key = file path
+			typedef std::unordered_map<std::string, SourceStamp>		SourceStampMapT;	// key = file path
+			typedef std::unordered_set<std::string>						PathSetT;
 
 			ICodaScriptVirtualMachine*		VM;
 			ProgramMapT						Store;
+			SourceStampMapT					Stamps;
+			CodaScriptProgramImageCache		Images;
 
 			ICodaScriptProgram*				Lookup(const std::string& Filepath) const;
 			void							Remove(const std::string& Filepath);
-			void							Add(const std::string& Filepath, ICodaScriptProgram::PtrT& Program);
+			ICodaScriptProgram*				Add(const std::string& Filepath, std::unique_ptr<CodaScriptProgram>& Program);		// takes ownership, returns nullptr if the program is invalid
+			ICodaScriptProgram*				Revalidate(const ResourceLocation& Filepath, bool Recompile);						// returns the cached program if it's up-to-date, evicts it otherwise
+
+			std::string						ResolveDependency(const std::string& ScriptPath) const;
+			const SourceStamp&				Stat(const std::string& Filepath, bool Force = false);		// rehashes the file only if its timestamp or size changed
+			bool							IsStale(const std::string& Filepath, PathSetT& Visited);	// checks the source and its transitive dependencies
 		public:
 			CodaScriptProgramCache(ICodaScriptVirtualMachine* VM);
 			virtual ~CodaScriptProgramCache();
 
+			static void						RegisterINISettings(INISettingDepotT& Depot);
+
 			virtual ICodaScriptProgram*			Get(const ResourceLocation& Filepath, bool Recompile = false) override;
+			virtual void						Get(const std::vector<ResourceLocation>& Filepaths,
+													std::vector<ICodaScriptProgram*>& OutPrograms,
+													bool Recompile = false) override;
 			virtual void						Invalidate() override;
 		};
 
@@ -54,6 +95,7 @@ namespace bgsee
 		{
 			static INISetting							kINI_Profiling;
 			static INISetting							kINI_RecursionLimit;
+			static INISetting							kINI_TailCallLimit;
 
 			struct ExecutingContext
 			{
@@ -88,26 +130,109 @@ namespace bgsee
 			virtual void								RaiseGlobalException() override;
 			virtual void								PrintStackTrace() const override;
 
+			CodaScriptProfiler&							GetProfiler();
+			bool										IsProfilingEnabled() const;
+
 			static void									RegisterINISettings(INISettingDepotT& Depot);
 		};
 
+		class CodaScriptAsyncResult : public ICodaScriptAsyncResult
+		{
+			friend class CodaScriptAsyncExecutive;
+
+			mutable std::mutex								Lock;
+			std::condition_variable							Completed;
+			bool											Done;
+			bool											Replayed;
+			ICodaScriptVirtualMachine::ExecuteResult		Result;
+			CodaScriptMessageHandler::Transcript			Messages;			// written to by the worker thread until the execution completes
+			CodaScriptMessageHandler*						MessageHandler;
+
+			void											Complete();
+		public:
+			CodaScriptAsyncResult(CodaScriptMessageHandler* MessageHandler);
+			virtual ~CodaScriptAsyncResult();
+
+			virtual bool												IsReady() const override;
+			virtual bool												Wait(UInt32 Timeout = INFINITE) override;
+			virtual const ICodaScriptVirtualMachine::ExecuteResult&		Get() override;
+		};
+
+		// executes thread-safe programs on a pool of worker threads, every execution gets an executive of its own
+		// the evaluation state is held by the execution context, so a program can be executing on any number of threads at once
+		class CodaScriptAsyncExecutive
+		{
+			static INISetting							kINI_WorkerThreads;
+
+			static thread_local ICodaScriptExecutor*	ThreadExecutor;
+
+			typedef std::unordered_map<ICodaScriptProgram*, UInt32>		ProgramCounterMapT;		// value = number of pending executions
+			typedef std::unordered_map<const ICodaScriptArrayDataType*, ICodaScriptArrayDataType::SharedPtrT>		ArrayCopyMapT;		// key = source array
+
+			ICodaScriptVirtualMachine*					VM;
+			CodaScriptWorkerPool::PtrT					Workers;			// created on demand
+			ProgramCounterMapT							ExecutingPrograms;
+			mutable std::mutex							Lock;
+
+			void										Run(ICodaScriptExecutionContext* Context, std::shared_ptr<CodaScriptAsyncResult> Out);
+			void										RunPartition(ICodaScriptExecutionContext* Context,
+																	 ICodaScriptVirtualMachine::BatchParameterArrayT& Parameters,
+																	 ICodaScriptVirtualMachine::BatchResultArrayT& OutResults,
+																	 UInt32 Start, UInt32 End, std::shared_ptr<CodaScriptAsyncResult> Out);
+			void										Retire(ICodaScriptProgram* Program, std::shared_ptr<CodaScriptAsyncResult> Out);
+			CodaScriptWorkerPool*						GetWorkers();
+
+			static ICodaScriptArrayDataType::SharedPtrT	CopyArray(const ICodaScriptArrayDataType::SharedPtrT& Source, ArrayCopyMapT& Copies);
+		public:
+			CodaScriptAsyncExecutive(ICodaScriptVirtualMachine* VM);
+			~CodaScriptAsyncExecutive();				// waits for pending executions to complete
+
+			ICodaScriptAsyncResult::PtrT				Queue(ICodaScriptExecutionContext* Context);		// takes ownership of the pointer
+			void										Batch(ICodaScriptProgram* Program,
+															  ICodaScriptVirtualMachine::BatchParameterArrayT& Parameters,
+															  ICodaScriptVirtualMachine::BatchResultArrayT& OutResults);		// splits the inputs into one partition per worker, blocks until the batch completes
+			bool										IsProgramExecuting(ICodaScriptProgram* Program) const;
+
+			static ICodaScriptExecutor*					GetThreadExecutor();		// returns the executive of the script executing on the calling thread if it's a worker, nullptr otherwise
+			static void									IsolateParameters(CodaScriptBackingStore::NonPtrArrayT& Parameters);		// replaces array parameters with deep copies, arrays that are passed more than once stay aliased
+
+			static void									RegisterINISettings(INISettingDepotT& Depot);
+
+			typedef std::unique_ptr<CodaScriptAsyncExecutive>		PtrT;
+		};
+
 		class CodaScriptBackgrounder : public ICodaScriptBackgroundDaemon
 		{
+			friend class CodaScriptBenchmarks;
+
 			static INISetting					kINI_Enabled;
 			static INISetting					kINI_UpdatePeriod;
 			static INISetting					kINI_LogToDefaultConsoleContext;
+			static INISetting					kINI_TickBudget;
 
-			static VOID CALLBACK				CallbackProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+			static const UInt32					kOverrunReportInterval = 100;
+
+			struct ScheduledContext
+			{
+				ICodaScriptExecutionContext::PtrT	Context;
+				bool								Pending;			// due for execution or preempted, waiting for its turn
+				UInt32								DeferredTicks;		// ticks it's been pending for without getting to execute
+				UInt32								Overruns;			// executions that took longer than the budget of an entire tick
+
+				ScheduledContext(ICodaScriptExecutionContext::PtrT&& Context) :
+					Context(std::move(Context)), Pending(false), DeferredTicks(0), Overruns(0) {}
+			};
 
-			typedef std::vector<ICodaScriptExecutionContext::PtrT>	ContextArrayT;
+			typedef std::vector<ScheduledContext>	ContextArrayT;
+			typedef std::vector<ScheduledContext*>	RunQueueT;
 
 			ResourceLocation					SourceDepot;
 			ContextArrayT						DepotCache;		// stores the contexts for scripts in the depot
 			ContextArrayT						RuntimeCache;	// stores the contexts for regular scripts executing in the background
 			bool								State;
 			bool								Backgrounding;
-			HWND								TimerDummyWindow;
-			CodaScriptElapsedTimeCounterT		PollingTimeCounter;
+			ICodaScriptTickSource::PtrT			TickSource;
+			double								LastTickTime;		// in milliseconds, as reported by the tick source
 			ICodaScriptVirtualMachine*			VM;
 
 			INIManagerGetterFunctor				INISettingGetter;
@@ -116,13 +241,16 @@ namespace bgsee
 			void								ResetDepotCache(bool Renew = false);
 			void								ResetTimer(bool Renew = false);
 
-			void								Execute(ContextArrayT& Cache, double TimePassed);
+			void								Schedule(ContextArrayT& Cache, double TimePassed, RunQueueT& OutQueue);		// queues the scripts that are due
+			double								Execute(ScheduledContext& Script, double TimeSlice);		// returns the execution time in milliseconds
+			void								Prune(ContextArrayT& Cache);		// removes finished and halted scripts
 			void								Tick();
 		public:
 			CodaScriptBackgrounder(ICodaScriptVirtualMachine* VM,
 								   ResourceLocation Source,
 								   INIManagerGetterFunctor Getter,
-								   INIManagerSetterFunctor Setter);
+								   INIManagerSetterFunctor Setter,
+								   ICodaScriptTickSource* TickSource);		// takes ownership of the tick source
 			virtual ~CodaScriptBackgrounder();
 
 			static void							RegisterINISettings(INISettingDepotT& Depot);
@@ -181,6 +309,12 @@ namespace bgsee
 
 			static ConsoleCommandInfo					kDumpCodaDocsConsoleCommandData;
 			static void									DumpCodaDocsConsoleCommandHandler(UInt32 ParamCount, const char* Args);
+			static ConsoleCommandInfo					kSetCodaBackendConsoleCommandData;
+			static void									SetCodaBackendConsoleCommandHandler(UInt32 ParamCount, const char* Args);
+			static ConsoleCommandInfo					kCodaProfilerConsoleCommandData;
+			static void									CodaProfilerConsoleCommandHandler(UInt32 ParamCount, const char* Args);
+			static ConsoleCommandInfo					kCodaBenchmarkConsoleCommandData;
+			static void									CodaBenchmarkConsoleCommandHandler(UInt32 ParamCount, const char* Args);
 
 			static CodaScriptVM*						Singleton;
 
@@ -189,6 +323,7 @@ namespace bgsee
 			CodaScriptMessageHandler::PtrT				MessageHandler;
 			CodaScriptProgramCache::PtrT				ProgramCache;
 			CodaScriptExecutive::PtrT					Executive;
+			CodaScriptAsyncExecutive::PtrT				AsyncExecutive;
 			CodaScriptBackgrounder::PtrT				Backgrounder;
 			CodaScriptGlobalDataStore::PtrT				GlobalStore;
 			ICodaScriptExpressionParser::PtrT			ExpressionParser;
@@ -232,6 +367,10 @@ namespace bgsee
 
 			virtual bool										IsProgramExecuting(ICodaScriptProgram* Program) const override;
 			virtual void										RunScript(ExecuteParams& Input, ExecuteResult& Output) override;
+			virtual ICodaScriptAsyncResult::PtrT				RunScriptAsync(ExecuteParams& Input) override;
+			virtual void										RunBatch(ICodaScriptProgram* Program,
+																		 BatchParameterArrayT& Parameters,
+																		 BatchResultArrayT& OutResults) override;
 		};
 
 #define CODAVM											bgsee::script::CodaScriptVM::Get()
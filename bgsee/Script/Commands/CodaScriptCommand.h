@@ -42,6 +42,10 @@
 			{																										\
 				return Documentation;																				\
 			}																										\
+			virtual bool						IsThreadSafe(void)													\
+			{																										\
+				return GetRegistrar()->IsThreadSafe(this);															\
+			}																										\
 			virtual int							GetParameterData(int* OutParameterCount = NULL,						\
 																ParameterInfo** OutParameterInfoArray = NULL,		\
 																UInt8* OutResultType = NULL)						\
@@ -96,6 +100,10 @@
 			{																										\
 				return Documentation;																				\
 			}																										\
+			virtual bool						IsThreadSafe(void)													\
+			{																										\
+				return GetRegistrar()->IsThreadSafe(this);															\
+			}																										\
 			virtual int							GetParameterData(int* OutParameterCount = NULL,						\
 																ParameterInfo** OutParameterInfoArray = NULL,		\
 																UInt8* OutResultType = NULL)						\
@@ -153,6 +161,10 @@
 			{																										\
 				return Documentation;																				\
 			}																										\
+			virtual bool						IsThreadSafe(void)													\
+			{																										\
+				return GetRegistrar()->IsThreadSafe(this);															\
+			}																										\
 			virtual int							GetParameterData(int* OutParameterCount = NULL,						\
 																ParameterInfo** OutParameterInfoArray = NULL,		\
 																UInt8* OutResultType = NULL)						\
@@ -204,6 +216,10 @@
 			{																										\
 				return Documentation;																				\
 			}																										\
+			virtual bool						IsThreadSafe(void)													\
+			{																										\
+				return GetRegistrar()->IsThreadSafe(this);															\
+			}																										\
 			virtual int							GetParameterData(int* OutParameterCount = NULL,						\
 																ParameterInfo** OutParameterInfoArray = NULL,		\
 																UInt8* OutResultType = NULL)						\
@@ -228,6 +244,9 @@
 
 #define CodaScriptCommandPrototypeDef(Name)			CodaScriptCommand##Name		kCommand##Name##Prototype
 
+// must follow the command's prototype definition
+#define CodaScriptCommandThreadSafeDef(Name)		static const bool	kCommand##Name##ThreadSafe = GetRegistrar()->MarkThreadSafe(&kCommand##Name##Prototype)
+
 #define CodaScriptCommandHandler(Name)																				\
 		bool CodaScriptCommand##Name##::Execute(ICodaScriptDataStore* Arguments,									\
 												ICodaScriptDataStore* Result,										\
@@ -20,6 +20,15 @@ namespace bgsee
 				CodaScriptCommandPrototypeDef(ArraySetAt);
 				CodaScriptCommandPrototypeDef(ArrayAppend);
 
+				CodaScriptCommandThreadSafeDef(ArrayCreate);
+				CodaScriptCommandThreadSafeDef(ArrayInsert);
+				CodaScriptCommandThreadSafeDef(ArrayErase);
+				CodaScriptCommandThreadSafeDef(ArrayClear);
+				CodaScriptCommandThreadSafeDef(ArraySize);
+				CodaScriptCommandThreadSafeDef(ArrayInsertAt);
+				CodaScriptCommandThreadSafeDef(ArraySetAt);
+				CodaScriptCommandThreadSafeDef(ArrayAppend);
+
 				CodaScriptCommandParamData(ArrayInsert, 3)
 				{
 					{ "Array",								ICodaScriptDataStore::kDataType_Array	},
@@ -26,6 +26,14 @@ namespace bgsee
 				CodaScriptCommandPrototypeDef(Error);
 				CodaScriptCommandPrototypeDef(DebugBreak);
 
+				CodaScriptCommandThreadSafeDef(Return);
+				CodaScriptCommandThreadSafeDef(Break);
+				CodaScriptCommandThreadSafeDef(Continue);
+				CodaScriptCommandThreadSafeDef(GetSecondsPassed);
+				CodaScriptCommandThreadSafeDef(FormatNumber);
+				CodaScriptCommandThreadSafeDef(PrintToConsole);
+				CodaScriptCommandThreadSafeDef(Error);
+
 				CodaScriptCommandParamData(FormatNumber, 3)
 				{
 					{ "Format String",					ICodaScriptDataStore::kDataType_String	},
@@ -67,11 +75,9 @@ namespace bgsee
 					script::ICodaScriptVirtualMachine::ExecuteParams Input;
 					script::ICodaScriptVirtualMachine::ExecuteResult Output;
 
+					// the arguments are temporaries owned by the command wrapper, so they can be moved
 					for (int i = 1; i < ArgumentCount; i++)
-					{
-						const CodaScriptBackingStore* Store = &ArgumentStore[i];
-						Input.Parameters.push_back(*Store);
-					}
+						Input.Parameters.push_back(std::move(ArgumentStore[i]));
 
 					if (CallSelf)
 						Input.Program = CurrentProgram;
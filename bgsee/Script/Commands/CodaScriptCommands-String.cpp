@@ -20,6 +20,15 @@ namespace bgsee
 				CodaScriptCommandPrototypeDef(StringIsNumber);
 				CodaScriptCommandPrototypeDef(StringToNumber);
 
+				CodaScriptCommandThreadSafeDef(StringLength);
+				CodaScriptCommandThreadSafeDef(StringCompare);
+				CodaScriptCommandThreadSafeDef(StringErase);
+				CodaScriptCommandThreadSafeDef(StringFind);
+				CodaScriptCommandThreadSafeDef(StringInsert);
+				CodaScriptCommandThreadSafeDef(StringSubStr);
+				CodaScriptCommandThreadSafeDef(StringIsNumber);
+				CodaScriptCommandThreadSafeDef(StringToNumber);
+
 				CodaScriptCommandParamData(StringCompare, 3)
 				{
 					{ "First String",						ICodaScriptDataStore::kDataType_String	},
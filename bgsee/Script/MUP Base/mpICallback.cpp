@@ -52,6 +52,7 @@ namespace bgsee { namespace script { namespace mup {
     ,m_pPackage(a_pPackage)
     ,m_nArgc(a_nArgc)
     ,m_nArgsPresent(-1)
+    ,m_bPure(true)
   {}
 
   //------------------------------------------------------------------------------
@@ -123,6 +124,23 @@ namespace bgsee { namespace script { namespace mup {
     return ss.str();
   }
 
+  //------------------------------------------------------------------------------
+  void ICallback::SetPure(bool a_bPure)
+  {
+    m_bPure = a_bPure;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns true if the callback can be evaluated at compile time.
+
+    Pure callbacks have no side effects and always return the same value
+    for the same arguments.
+  */
+  bool ICallback::IsPure() const
+  {
+    return m_bPure;
+  }
+
   //------------------------------------------------------------------------------
   void ICallback::SetNumArgsPresent(int argc)
   {
@@ -68,12 +68,14 @@ namespace bgsee { namespace script { namespace mup {
 
       int GetArgc() const;
       int GetArgsPresent() const;
+      bool IsPure() const;
       void  SetParent(parent_type *a_pParent);
       void  SetNumArgsPresent(int argc);
 
   protected:
       parent_type* GetParent();
       void  SetArgc(int argc);
+      void  SetPure(bool a_bPure);
 
   private:
 
@@ -81,6 +83,7 @@ namespace bgsee { namespace script { namespace mup {
       const IPackage *m_pPackage;  ///< Pointer to thhe package this callback is belonging to (may be zero)
       int  m_nArgc;                ///< Number of this function can take Arguments.
       int  m_nArgsPresent;         ///< Number of arguments actually submitted
+      bool m_bPure;                ///< True if the result depends only on the arguments and evaluation has no side effects
   }; // class ICallback
 } } }
 
@@ -172,6 +172,7 @@ namespace bgsee { namespace script { namespace mup {
   IOprtIndex::IOprtIndex(int nArgc)
     :IToken(cmIC, _T("[...]"))
     ,m_nArgc(nArgc)
+    ,m_bWriteTarget(false)
   {}
 
   //------------------------------------------------------------------------------
@@ -218,4 +219,16 @@ namespace bgsee { namespace script { namespace mup {
     else
       return m_nArgsPresent;
   }
+
+  //-----------------------------------------------------------------------------------------------
+  bool IOprtIndex::IsWriteTarget() const
+  {
+    return m_bWriteTarget;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void IOprtIndex::SetWriteTarget(bool a_bWriteTarget)
+  {
+    m_bWriteTarget = a_bWriteTarget;
+  }
 } } }  // namespace mu
\ No newline at end of file
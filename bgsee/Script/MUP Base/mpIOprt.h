@@ -123,10 +123,13 @@ namespace bgsee { namespace script { namespace mup {
         int  GetArgc() const;
         int  GetArgsPresent() const;
         void SetNumArgsPresent(int argc);
+        bool IsWriteTarget() const;
+        void SetWriteTarget(bool a_bWriteTarget);
 
     private:
         int m_nArgc;          ///< Number of arguments needed for the index operator (dimension of the index)
         int m_nArgsPresent;   ///< Number of arguments actually submitted
+        bool m_bWriteTarget;  ///< Set if the result is the left operand of an assignment
     }; // class IOperator
 } } }  // namespace mu
 
@@ -44,6 +44,7 @@
 namespace bgsee { namespace script { namespace mup {
 #ifdef MUP_LEAKAGE_REPORT
   std::list<IToken*> IToken::s_Tokens;
+  std::mutex IToken::s_TokensLock;
 #endif
 
 #ifndef _UNICODE
@@ -86,6 +87,7 @@ namespace bgsee { namespace script { namespace mup {
 	Out += "\n";
 	Out += "Memory leakage report:\n\n";
 	char Buffer[0x1000] = {0};
+	std::lock_guard<std::mutex> Guard(IToken::s_TokensLock);
 	if (IToken::s_Tokens.size())
 	{
 	  list<IToken*>::const_iterator item = IToken::s_Tokens.begin();
@@ -128,6 +130,7 @@ namespace bgsee { namespace script { namespace mup {
 	,m_flags(0)
   {
 #ifdef MUP_LEAKAGE_REPORT
+	std::lock_guard<std::mutex> Guard(IToken::s_TokensLock);
 	IToken::s_Tokens.push_back(this);
 #endif
   }
@@ -141,6 +144,7 @@ namespace bgsee { namespace script { namespace mup {
 	,m_flags(0)
   {
 #ifdef MUP_LEAKAGE_REPORT
+	std::lock_guard<std::mutex> Guard(IToken::s_TokensLock);
 	IToken::s_Tokens.push_back(this);
 #endif
   }
@@ -149,6 +153,7 @@ namespace bgsee { namespace script { namespace mup {
   IToken::~IToken()
   {
 #ifdef MUP_LEAKAGE_REPORT
+	std::lock_guard<std::mutex> Guard(IToken::s_TokensLock);
 	std::list<IToken*>::iterator it = std::find(IToken::s_Tokens.begin(), IToken::s_Tokens.end(), this);
 	IToken::s_Tokens.remove(this);
 #endif
@@ -175,6 +180,23 @@ namespace bgsee { namespace script { namespace mup {
 	m_nRefCount = 0;
   }
 
+  //------------------------------------------------------------------------------
+  /** \brief Assignment operator.
+	  \param ref The token to copy basic state information from.
+
+	Same as the copy constructor, the reference count belongs to the object
+	and is left untouched.
+  */
+  IToken& IToken::operator=(const IToken &ref)
+  {
+	m_eCode  = ref.m_eCode;
+	m_sIdent = ref.m_sIdent;
+	m_flags  = ref.m_flags;
+	m_nPosExpr = ref.m_nPosExpr;
+
+	return *this;
+  }
+
   //------------------------------------------------------------------------------
   void IToken::ResetRef()
   {
@@ -104,6 +104,7 @@ namespace bgsee { namespace script { namespace mup {
 	virtual ~IToken();
 	IToken(ECmdCode a_iCode, string_type a_sIdent);
 	IToken(const IToken &ref);
+	IToken& operator=(const IToken &ref);
 
 	void ResetRef();
 
@@ -122,11 +123,12 @@ namespace bgsee { namespace script { namespace mup {
 	ECmdCode m_eCode;
 	string_type m_sIdent;
 	int m_nPosExpr;           ///< Original position of the token in the expression
-	mutable long m_nRefCount; ///< Reference counter.
+	mutable std::atomic<long> m_nRefCount; ///< Reference counter. Atomic as the tokens of compiled bytecode are shared by threads evaluating the same program
 	int m_flags;
 
 #ifdef MUP_LEAKAGE_REPORT
 	static std::list<IToken*> s_Tokens;
+	static std::mutex s_TokensLock;		///< Tokens are also created and destroyed by scripts executing on worker threads
 
   public:
 	static bool LeakageReport(std::string& Out);
@@ -48,7 +48,9 @@ namespace bgsee { namespace script { namespace mup {
 
   OprtAssign::OprtAssign()
     :IOprtBin(_T("="), (int)prASSIGN, oaLEFT)
-  {}
+  {
+    SetPure(false);
+  }
 
   //---------------------------------------------------------------------
   const char_type* OprtAssign::GetDesc() const
@@ -89,7 +91,9 @@ namespace bgsee { namespace script { namespace mup {
 
   OprtAssignAdd::OprtAssignAdd()
     :IOprtBin(_T("+="), (int)prASSIGN, oaLEFT)
-  {}
+  {
+    SetPure(false);
+  }
 
   //---------------------------------------------------------------------
   void OprtAssignAdd::Eval(ptr_val_type& ret, const ptr_val_type *a_pArg, int)
@@ -106,6 +110,14 @@ namespace bgsee { namespace script { namespace mup {
       throw ParserError(err);
     }
 
+    // strings are appended in place and the variable itself is returned, avoiding a copy of the (growing) string
+    if (a_pArg[0]->GetType() == 's')
+    {
+      *pVar += *a_pArg[1];
+      ret.Reset(pVar);
+      return;
+    }
+
     *pVar = cmplx_type(a_pArg[0]->GetFloat() + a_pArg[1]->GetFloat(),
                        a_pArg[0]->GetImag() + a_pArg[1]->GetImag());
     *ret = *pVar;
@@ -131,7 +143,9 @@ namespace bgsee { namespace script { namespace mup {
 
   OprtAssignSub::OprtAssignSub()
     :IOprtBin(_T("-="), (int)prASSIGN, oaLEFT)
-  {}
+  {
+    SetPure(false);
+  }
 
   //---------------------------------------------------------------------
   void OprtAssignSub::Eval(ptr_val_type& ret, const ptr_val_type *a_pArg, int)
@@ -171,7 +185,9 @@ namespace bgsee { namespace script { namespace mup {
 
   OprtAssignMul::OprtAssignMul()
     :IOprtBin(_T("*="), (int)prASSIGN, oaLEFT)
-  {}
+  {
+    SetPure(false);
+  }
 
   //---------------------------------------------------------------------
   void OprtAssignMul::Eval(ptr_val_type& ret, const ptr_val_type *a_pArg, int)
@@ -213,7 +229,9 @@ namespace bgsee { namespace script { namespace mup {
   //---------------------------------------------------------------------
 
   OprtAssignDiv::OprtAssignDiv() : IOprtBin(_T("/="), (int)prASSIGN, oaLEFT)
-  {}
+  {
+    SetPure(false);
+  }
 
   //------------------------------------------------------------------------------
   void OprtAssignDiv::Eval(ptr_val_type &ret, const ptr_val_type *a_pArg, int)
@@ -64,6 +64,34 @@ namespace bgsee { namespace script { namespace mup {
       }
 shadeMe: what this is I don't even...*/
 
+      // Coda arrays are one-dimensional. elements that are only read are copied into a value, so reading never modifies
+      // the array. assignment targets get a proxy that writes the element back
+      CodaScriptBackingStore* Store = ret->GetStore();
+      if (Store->GetType() == ICodaScriptDataStore::kDataType_Array)
+      {
+        if (a_iArgc != 1)
+          throw ParserError(ErrorContext(ecINDEX_DIMENSION, -1, GetIdent()));
+
+        int Index = a_pArg[0]->GetInteger();
+        ICodaScriptArrayDataType::SharedPtrT Array(Store->GetArray());
+
+        if (Index < 0 || Index >= (int)Array->Size())
+          throw ParserError(ErrorContext(ecINDEX_OUT_OF_BOUNDS, -1, GetIdent()));
+
+        if (IsWriteTarget())
+          ret.Reset(new CodaScriptMUPArrayElement(Array, Index));
+        else
+        {
+          // temporaries are overwritten in place, the array is kept alive by the local reference
+          if (ret->IsVariable())
+            ret.Reset(new CodaScriptMUPValue());
+
+          Array->At(Index, *ret->AsValue());
+        }
+
+        return;
+      }
+
       switch(a_iArgc)
       {
       case 1:
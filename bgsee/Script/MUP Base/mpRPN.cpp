@@ -145,6 +145,18 @@ namespace bgsee { namespace script { namespace mup {
 	}
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Replace the token sequence with a rewritten one.
+
+	The new sequence must not require a larger stack than the original. Jump
+	offsets are recomputed.
+  */
+  void RPN::Assign(const token_vec_type &a_vRPN)
+  {
+	m_vRPN = a_vRPN;
+	Finalize();
+  }
+
   //---------------------------------------------------------------------------
   void  RPN::EnableOptimizer(bool bStat)
   {
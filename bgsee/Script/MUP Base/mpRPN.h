@@ -56,6 +56,7 @@ namespace bgsee { namespace script { namespace mup {
     void Pop(int num);
     void Reset();
     void Finalize();
+    void Assign(const token_vec_type &a_vRPN);
     void AsciiDump() const;
 
     const token_vec_type& GetData() const;
@@ -6,56 +6,160 @@ namespace bgsee
 	{
 		namespace mup
 		{
-			int		CodaScriptMUPArrayDataType::GIC = 0;
+			std::atomic<int>		CodaScriptMUPArrayDataType::GIC(0);
 
 			void CodaScriptMUPArrayDataType::Copy( const CodaScriptMUPArrayDataType& Source )
 			{
+				// the elements are only duplicated when either array is modified
+				this->Layout = Source.Layout;
 				this->DataStore = Source.DataStore;
+				this->NumericStore = Source.NumericStore;
+				this->ReferenceStore = Source.ReferenceStore;
 			}
 
-			template<typename ElementT>
-			bool CodaScriptMUPArrayDataType::AddElement(ElementT Element, int Index, bool Replace)
+			CodaScriptMUPArrayDataType::MutableElementArrayT& CodaScriptMUPArrayDataType::GetMutableStore()
 			{
-				if (Index == -1)
+				if (Layout != ElementLayout::Generic)
+					Degrade();
+				else if (DataStore.use_count() > 1)
+					DataStore.reset(new MutableElementArrayT(*DataStore));
+
+				return *DataStore;
+			}
+
+			void CodaScriptMUPArrayDataType::SetLayout( ElementLayout NewLayout, UInt32 Reserve )
+			{
+				Layout = NewLayout;
+				DataStore.reset();
+				NumericStore.reset();
+				ReferenceStore.reset();
+
+				switch (NewLayout)
 				{
-					DataStore.push_back(CodaScriptMUPValue(Element));
-					return true;
+				case ElementLayout::Numeric:
+					NumericStore.reset(new NumericElementArrayT());
+					NumericStore->reserve(Reserve);
+					break;
+				case ElementLayout::Reference:
+					ReferenceStore.reset(new ReferenceElementArrayT());
+					ReferenceStore->reserve(Reserve);
+					break;
+				case ElementLayout::Generic:
+					DataStore.reset(new MutableElementArrayT());
+					DataStore->reserve(Reserve);
+					break;
+				}
+			}
+
+			void CodaScriptMUPArrayDataType::Degrade()
+			{
+				if (Layout == ElementLayout::Generic)
+					return;
+
+				// the packed store can be shared with other copies, so the elements are always copied out
+				SharedElementArrayT Elements(new MutableElementArrayT());
+				Elements->reserve(Size() + 1);
+
+				if (Layout == ElementLayout::Numeric)
+				{
+					for (auto Itr : *NumericStore)
+						Elements->emplace_back(Itr);
 				}
-				else if (Index < Size())
+				else
 				{
-					if (Replace)
-						DataStore[Index] = CodaScriptMUPValue(Element);
-					else
-						DataStore.emplace(DataStore.begin() + Index, CodaScriptMUPValue(Element));
+					for (auto Itr : *ReferenceStore)
+						Elements->emplace_back(Itr);
+				}
+
+				Layout = ElementLayout::Generic;
+				NumericStore.reset();
+				ReferenceStore.reset();
+				DataStore = Elements;
+			}
 
+			bool CodaScriptMUPArrayDataType::PreparePackedInsert( ElementLayout Required )
+			{
+				if (Layout == Required)
+					return true;
+				else if (Size() == 0)
+				{
+					// empty arrays adopt the layout of their first element
+					SetLayout(Required, 5);
 					return true;
 				}
+
+				Degrade();
+				return false;
+			}
+
+			template<typename ElementT>
+			bool CodaScriptMUPArrayDataType::AddElement(ElementT Element, int Index, bool Replace)
+			{
+				if (Index != -1 && Index >= Size())
+					return false;
+
+				MutableElementArrayT& Elements = GetMutableStore();
+				if (Index == -1)
+					Elements.push_back(CodaScriptMUPValue(Element));
+				else if (Replace)
+					Elements[Index] = CodaScriptMUPValue(Element);
 				else
+					Elements.emplace(Elements.begin() + Index, CodaScriptMUPValue(Element));
+
+				return true;
+			}
+
+			template<typename StoreT, typename ElementT>
+			bool CodaScriptMUPArrayDataType::AddPackedElement(std::shared_ptr<StoreT>& Store, ElementT Element, int Index, bool Replace)
+			{
+				if (Index != -1 && Index >= Size())
 					return false;
+
+				if (Store.use_count() > 1)
+					Store.reset(new StoreT(*Store));
+
+				StoreT& Elements = *Store;
+				if (Index == -1)
+					Elements.push_back(Element);
+				else if (Replace)
+					Elements[Index] = Element;
+				else
+					Elements.insert(Elements.begin() + Index, Element);
+
+				return true;
 			}
 
 			CodaScriptMUPArrayDataType::CodaScriptMUPArrayDataType() :
 				ICodaScriptArrayDataType(),
-				DataStore()
+				Layout(ElementLayout::Numeric),
+				DataStore(),
+				NumericStore(),
+				ReferenceStore()
 			{
 				GIC++;
 
-				DataStore.reserve(5);
+				SetLayout(ElementLayout::Numeric, 5);
 			}
 
 			CodaScriptMUPArrayDataType::CodaScriptMUPArrayDataType( CodaScriptBackingStore* Elements, UInt32 Size ) :
 				ICodaScriptArrayDataType(),
-				DataStore(Size)
+				Layout(ElementLayout::Numeric),
+				DataStore(),
+				NumericStore(new NumericElementArrayT(Size, 0)),
+				ReferenceStore()
 			{
 				GIC++;
 
 				for (int i = 0; i < Size; i++)
-					AddElement<const CodaScriptBackingStore&>(Elements[i], -1, true);
+					Insert(&Elements[i]);
 			}
 
 			CodaScriptMUPArrayDataType::CodaScriptMUPArrayDataType( CodaScriptMUPArrayDataType* Source ) :
 				ICodaScriptArrayDataType(),
-				DataStore()
+				Layout(ElementLayout::Numeric),
+				DataStore(),
+				NumericStore(),
+				ReferenceStore()
 			{
 				GIC++;
 
@@ -64,7 +168,9 @@ namespace bgsee
 
 			CodaScriptMUPArrayDataType::~CodaScriptMUPArrayDataType()
 			{
-				Clear();
+				DataStore.reset();
+				NumericStore.reset();
+				ReferenceStore.reset();
 
 				GIC--;
 				SME_ASSERT(GIC >= 0);
@@ -72,7 +178,10 @@ namespace bgsee
 
 			CodaScriptMUPArrayDataType::CodaScriptMUPArrayDataType( const CodaScriptMUPArrayDataType& rhs ) :
 				ICodaScriptArrayDataType(),
-				DataStore()
+				Layout(ElementLayout::Numeric),
+				DataStore(),
+				NumericStore(),
+				ReferenceStore()
 			{
 				GIC++;
 
@@ -81,11 +190,14 @@ namespace bgsee
 
 			CodaScriptMUPArrayDataType::CodaScriptMUPArrayDataType( UInt32 Size ) :
 				ICodaScriptArrayDataType(),
-				DataStore()
+				Layout(ElementLayout::Numeric),
+				DataStore(),
+				NumericStore(),
+				ReferenceStore()
 			{
 				GIC++;
 
-				DataStore.reserve(Size);
+				SetLayout(ElementLayout::Numeric, Size);
 			}
 
 			CodaScriptMUPArrayDataType& CodaScriptMUPArrayDataType::operator=( const CodaScriptMUPArrayDataType& rhs )
@@ -97,7 +209,15 @@ namespace bgsee
 
 			bool CodaScriptMUPArrayDataType::Insert(CodaScriptBackingStore* Data, int Index /* = -1 */, bool Replace /* = true */)
 			{
-				return AddElement<const CodaScriptBackingStore&>(*Data, Index, Replace);
+				switch (Data->GetType())
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					return Insert(Data->GetNumber(), Index, Replace);
+				case ICodaScriptDataStore::kDataType_Reference:
+					return Insert(Data->GetFormID(), Index, Replace);
+				default:
+					return AddElement<const CodaScriptBackingStore&>(*Data, Index, Replace);
+				}
 			}
 
 			bool CodaScriptMUPArrayDataType::Insert(ICodaScriptArrayDataType::SharedPtrT Data, int Index /* = -1 */, bool Replace /* = true */)
@@ -107,7 +227,10 @@ namespace bgsee
 
 			bool CodaScriptMUPArrayDataType::Insert(CodaScriptReferenceDataTypeT Data, int Index /* = -1 */, bool Replace /* = true */)
 			{
-				return AddElement<CodaScriptReferenceDataTypeT>(Data, Index, Replace);
+				if (PreparePackedInsert(ElementLayout::Reference))
+					return AddPackedElement(ReferenceStore, Data, Index, Replace);
+				else
+					return AddElement<CodaScriptReferenceDataTypeT>(Data, Index, Replace);
 			}
 
 			bool CodaScriptMUPArrayDataType::Insert(CodaScriptStringParameterTypeT Data, int Index /* = -1 */, bool Replace /* = true */)
@@ -117,7 +240,10 @@ namespace bgsee
 
 			bool CodaScriptMUPArrayDataType::Insert(CodaScriptNumericDataTypeT Data, int Index /* = -1 */, bool Replace /* = true */)
 			{
-				return AddElement<CodaScriptNumericDataTypeT>(Data, Index, Replace);
+				if (PreparePackedInsert(ElementLayout::Numeric))
+					return AddPackedElement(NumericStore, Data, Index, Replace);
+				else
+					return AddElement<CodaScriptNumericDataTypeT>(Data, Index, Replace);
 			}
 
 			bool CodaScriptMUPArrayDataType::Erase( UInt32 Index )
@@ -125,15 +251,35 @@ namespace bgsee
 				if (Index >= Size())
 					return false;
 
-				MutableElementArrayT::iterator Itr = DataStore.begin() + Index;
-				DataStore.erase(Itr);
+				switch (Layout)
+				{
+				case ElementLayout::Numeric:
+					if (NumericStore.use_count() > 1)
+						NumericStore.reset(new NumericElementArrayT(*NumericStore));
+
+					NumericStore->erase(NumericStore->begin() + Index);
+					break;
+				case ElementLayout::Reference:
+					if (ReferenceStore.use_count() > 1)
+						ReferenceStore.reset(new ReferenceElementArrayT(*ReferenceStore));
+
+					ReferenceStore->erase(ReferenceStore->begin() + Index);
+					break;
+				default:
+					{
+						MutableElementArrayT& Elements = GetMutableStore();
+						Elements.erase(Elements.begin() + Index);
+					}
+
+					break;
+				}
 
 				return true;
 			}
 
 			void CodaScriptMUPArrayDataType::Clear( void )
 			{
-				DataStore.clear();
+				SetLayout(ElementLayout::Numeric, 5);
 			}
 
 			bool CodaScriptMUPArrayDataType::At( UInt32 Index, CodaScriptBackingStore& OutBuffer ) const
@@ -141,24 +287,68 @@ namespace bgsee
 				if (Index >= Size())
 					return false;
 
-				OutBuffer = *(DataStore[Index].GetStore());
+				switch (Layout)
+				{
+				case ElementLayout::Numeric:
+					OutBuffer = (*NumericStore)[Index];
+					break;
+				case ElementLayout::Reference:
+					OutBuffer = (*ReferenceStore)[Index];
+					break;
+				default:
+					OutBuffer = *((*DataStore)[Index].GetStore());
+					break;
+				}
+
 				return true;
 			}
 
-			bool CodaScriptMUPArrayDataType::At( UInt32 Index, CodaScriptMUPValue** OutBuffer ) const
+			bool CodaScriptMUPArrayDataType::At( UInt32 Index, ICodaScriptDataStoreOwner& OutValue ) const
 			{
 				if (Index >= Size())
 					return false;
 
-				SME_ASSERT(OutBuffer);
+				switch (Layout)
+				{
+				case ElementLayout::Numeric:
+					OutValue = CodaScriptBackingStore((*NumericStore)[Index]);
+					break;
+				case ElementLayout::Reference:
+					OutValue = CodaScriptBackingStore((*ReferenceStore)[Index]);
+					break;
+				default:
+					OutValue = *((*DataStore)[Index].GetStore());
+					break;
+				}
 
-				*OutBuffer = const_cast<CodaScriptMUPValue*>(&(DataStore[Index]));
 				return true;
 			}
 
+			const CodaScriptBackingStore* CodaScriptMUPArrayDataType::Peek(UInt32 Index) const
+			{
+				if (Layout != ElementLayout::Generic || Index >= Size())
+					return nullptr;
+
+				return (*DataStore)[Index].GetStore();
+			}
+
 			UInt32 CodaScriptMUPArrayDataType::Size( void ) const
 			{
-				return DataStore.size();
+				switch (Layout)
+				{
+				case ElementLayout::Numeric:
+					return NumericStore->size();
+				case ElementLayout::Reference:
+					return ReferenceStore->size();
+				default:
+					return DataStore->size();
+				}
+			}
+
+			ICodaScriptArrayDataType::SharedPtrT CodaScriptMUPArrayDataType::Clone( void ) const
+			{
+				ICodaScriptArrayDataType::SharedPtrT Copy(new CodaScriptMUPArrayDataType(*this));
+				return Copy;
 			}
 		}
 	}
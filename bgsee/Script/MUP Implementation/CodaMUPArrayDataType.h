@@ -10,15 +10,38 @@ namespace bgsee
 		{
 			class CodaScriptMUPArrayDataType : public ICodaScriptArrayDataType
 			{
-				static int												GIC;
+				static std::atomic<int>									GIC;
 			protected:
+				// homogeneous numeric and reference arrays are stored packed until a heterogeneous element is inserted
+				enum class ElementLayout : UInt8
+				{
+					Numeric,
+					Reference,
+					Generic,
+				};
+
 				typedef std::vector<CodaScriptMUPValue>					MutableElementArrayT;
+				typedef std::shared_ptr<MutableElementArrayT>			SharedElementArrayT;
+				typedef std::vector<CodaScriptNumericDataTypeT>			NumericElementArrayT;
+				typedef std::shared_ptr<NumericElementArrayT>			SharedNumericArrayT;
+				typedef std::vector<CodaScriptReferenceDataTypeT>		ReferenceElementArrayT;
+				typedef std::shared_ptr<ReferenceElementArrayT>			SharedReferenceArrayT;
 
-				MutableElementArrayT									DataStore;
+				// only the store that matches the layout is allocated, all of them are shared between copies until either is modified
+				ElementLayout											Layout;
+				SharedElementArrayT										DataStore;
+				SharedNumericArrayT										NumericStore;
+				SharedReferenceArrayT									ReferenceStore;
 
 				void													Copy(const CodaScriptMUPArrayDataType& Source);
+				MutableElementArrayT&									GetMutableStore();		// degrades packed elements and detaches them if they are shared
+				void													SetLayout(ElementLayout NewLayout, UInt32 Reserve = 0);
+				void													Degrade();
+				bool													PreparePackedInsert(ElementLayout Required);		// returns false if the array had to be degraded
 				template<typename ElementT>
 				bool													AddElement(ElementT Element, int Index, bool Replace);
+				template<typename StoreT, typename ElementT>
+				bool													AddPackedElement(std::shared_ptr<StoreT>& Store, ElementT Element, int Index, bool Replace);
 			public:
 				CodaScriptMUPArrayDataType();
 				CodaScriptMUPArrayDataType(UInt32 Size);
@@ -39,10 +62,14 @@ namespace bgsee
 				virtual void											Clear(void);
 
 				virtual bool											At(UInt32 Index, CodaScriptBackingStore& OutBuffer) const;
-				virtual bool											At(UInt32 Index, CodaScriptMUPValue** OutBuffer) const;
+				virtual bool											At(UInt32 Index, ICodaScriptDataStoreOwner& OutValue) const;
+				virtual const CodaScriptBackingStore*					Peek(UInt32 Index) const;
 				virtual UInt32											Size(void) const;
+				virtual ICodaScriptArrayDataType::SharedPtrT			Clone(void) const;
+
+				bool													IsPacked() const { return Layout != ElementLayout::Generic; }
 
-				static const int&										GetGIC() { return GIC; }
+				static int												GetGIC() { return GIC; }
 			};
 		}
 	}
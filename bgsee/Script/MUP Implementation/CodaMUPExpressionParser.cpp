@@ -2,6 +2,7 @@
 #include "utGeneric.h"
 #include "mpDefines.h"
 #include "mpIfThenElse.h"
+#include "mpOprtIndex.h"
 #include "mpScriptTokens.h"
 #include "mpPackageUnit.h"
 #include "mpPackageStr.h"
@@ -10,7 +11,11 @@
 #include "mpPackageCommon.h"
 #include "mpPackageMatrix.h"
 #include "CodaMUPScriptCommand.h"
+#include "CodaMUPOptimizer.h"
+#include "CodaMUPTypeInference.h"
+#include "CodaMUPSuperinstruction.h"
 #include "CodaUtilities.h"
+#include "Commands\CodaScriptCommands-General.h"
 #include "Main.h"
 #include "Console.h"
 
@@ -35,8 +40,25 @@ namespace bgsee
 				Cache.ReleaseAll();
 			}
 
+			void CodaScriptMUPParserByteCode::ValueBuffer::Scrub()
+			{
+				// variables are swapped out for cached values and the remaining values are reset
+				// so that strings and arrays don't outlive the execution context that created them
+				for (auto& Itr : StackBuffer)
+				{
+					if (Itr->IsVariable())
+						Itr.Reset(Cache.CreateFromCache());
+					else
+						*Itr = (float_type)0;
+				}
+			}
+
+			std::atomic<UInt32>		CodaScriptMUPParserByteCode::BufferAllocationCounter(0);
+
 			CodaScriptMUPParserByteCode::ValueBuffer* CodaScriptMUPParserByteCode::CreateBufferContext() const
 			{
+				BufferAllocationCounter++;
+
 				ValueBuffer* Out = new ValueBuffer;
 				Out->StackBuffer.assign(RPNStack.GetRequiredStackSize(), ptr_val_type());
 
@@ -50,53 +72,165 @@ namespace bgsee
 				return Out;
 			}
 
-			void CodaScriptMUPParserByteCode::PushBufferContext()
+			void CodaScriptMUPParserByteCode::FlagAssignmentTargets()
 			{
-				ValueBuffer::PtrT Context(CreateBufferContext());
-				CurrentValueCache = Context.get();
-				Buffer.push(std::move(Context));
+				// array elements only need a write-back proxy when they are the left operand of an assignment
+				// the simulated stack holds the RPN index of the token that produced each value
+				const token_vec_type& Tokens = RPNStack.GetData();
+				std::vector<std::size_t> Producers;
+				Producers.reserve(RPNStack.GetRequiredStackSize());
+
+				for (std::size_t i = 0; i < Tokens.size(); ++i)
+				{
+					IToken* pTok = Tokens[i].Get();
+
+					switch (pTok->GetCode())
+					{
+					case cmSCRIPT_NEWLINE:
+						Producers.clear();
+						break;
+					case cmVAL:
+						Producers.push_back(i);
+						break;
+					case cmIC:
+						{
+							int nArgs = static_cast<IOprtIndex*>(pTok)->GetArgsPresent();
+							SME_ASSERT(Producers.size() > nArgs);
+
+							static_cast<IOprtIndex*>(pTok)->SetWriteTarget(false);
+							Producers.resize(Producers.size() - nArgs - 1);
+							Producers.push_back(i);
+						}
+						break;
+					case cmOPRT_POSTFIX:
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+						{
+							int nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+							SME_ASSERT(Producers.size() >= nArgs);
+
+							IPrecedence* Precedence = pTok->AsIPrecedence();
+							if (nArgs && Precedence && Precedence->GetPri() == prASSIGN)
+							{
+								IToken* Target = Tokens[Producers[Producers.size() - nArgs]].Get();
+								if (Target->GetCode() == cmIC)
+									static_cast<IOprtIndex*>(Target)->SetWriteTarget(true);
+							}
+
+							Producers.resize(Producers.size() - nArgs);
+							Producers.push_back(i);
+						}
+						break;
+					case cmIF:
+					case cmELSE:
+						// pops the condition and the result of the then branch respectively
+						SME_ASSERT(Producers.size());
+						Producers.pop_back();
+						break;
+					default:
+						break;
+					}
+				}
 			}
 
-			void CodaScriptMUPParserByteCode::PopBufferContext()
+			void CodaScriptMUPParserByteCode::GenerateRegisterStream()
 			{
-				if (Buffer.empty())
-					throw CodaScriptException("Value buffer stack underflow");
-				else
-					Buffer.pop();
+				const token_vec_type& Tokens = RPNStack.GetData();
+				std::vector<int> TargetMap(Tokens.size() + 1, -1);			// RPN index -> instruction index
+				Stack<int> IfStackPos;
+				int sidx = -1;
 
-				if (Buffer.empty())
-					CurrentValueCache = nullptr;
-				else
-					CurrentValueCache = Buffer.top().get();
+				RegisterStream.clear();
+				RegisterStream.reserve(Tokens.size());
+
+				for (std::size_t i = 0; i < Tokens.size(); ++i)
+				{
+					IToken* pTok = Tokens[i].Get();
+					TargetMap[i] = RegisterStream.size();
+
+					switch (pTok->GetCode())
+					{
+					case cmSCRIPT_NEWLINE:
+						sidx = -1;
+						break;
+					case cmVAL:
+						{
+							IValue* pVal = static_cast<IValue*>(pTok);
+							++sidx;
+							RegisterStream.emplace_back(pVal->IsVariable() ? Instruction::OpCode::LoadVariable : Instruction::OpCode::LoadConstant,
+														sidx, pTok);
+						}
+						break;
+					case cmIC:
+						{
+							int nArgs = static_cast<IOprtIndex*>(pTok)->GetArgsPresent();
+							sidx -= nArgs;
+							RegisterStream.emplace_back(Instruction::OpCode::Index, sidx, pTok, nArgs);
+						}
+						break;
+					case cmOPRT_POSTFIX:
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+						{
+							int nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+							sidx -= nArgs - 1;
+							RegisterStream.emplace_back(Instruction::OpCode::Invoke, sidx, pTok, nArgs);
+						}
+						break;
+					case cmIF:
+						// the else branch starts off with the same stack depth as the then branch
+						RegisterStream.emplace_back(Instruction::OpCode::JumpIfFalse, sidx, pTok, 0,
+													i + static_cast<TokenIfThenElse*>(pTok)->GetOffset() + 1);
+						IfStackPos.push(--sidx);
+						break;
+					case cmELSE:
+					case cmJMP:
+						RegisterStream.emplace_back(Instruction::OpCode::Jump, 0, pTok, 0,
+													i + static_cast<TokenIfThenElse*>(pTok)->GetOffset() + 1);
+						if (pTok->GetCode() == cmELSE)
+							sidx = IfStackPos.pop();
+						break;
+					case cmENDIF:
+						break;
+					default:
+						throw CodaScriptException(Source, "Unexpected token '%s' in RPN", pTok->GetIdent().c_str());
+					}
+
+					SME_ASSERT(sidx < RPNStack.GetRequiredStackSize());
+				}
+
+				TargetMap[Tokens.size()] = RegisterStream.size();
+				for (auto& Itr : RegisterStream)
+				{
+					if (Itr.Target != -1)
+					{
+						SME_ASSERT(Itr.Target <= Tokens.size());
+						Itr.Target = TargetMap[Itr.Target];
+					}
+				}
 			}
 
 			CodaScriptMUPParserByteCode::CodaScriptMUPParserByteCode(CodaScriptMUPExpressionParser* Parent, ICodaScriptExecutableCode* Source) :
 				ICodaScriptExpressionByteCode(Source),
 				Parser(Parent),
+				Index(0),
 				TokenPos(0),
 				RPNStack(),
-				Buffer(),
-				CurrentValueCache(nullptr)
+				RegisterStream()
 			{
 				SME_ASSERT(Parser);
 			}
 
 			CodaScriptMUPParserByteCode::~CodaScriptMUPParserByteCode()
 			{
-				if (Buffer.size())
-					BGSEECONSOLE_MESSAGE("Value buffer still in use");
-
 				RPNStack.Reset();
 			}
 
-			val_vec_type& CodaScriptMUPParserByteCode::GetStackBuffer() const
+			UInt32 CodaScriptMUPParserByteCode::GetIndex() const
 			{
-				return CurrentValueCache->StackBuffer;
-			}
-
-			ValueCache& CodaScriptMUPParserByteCode::GetCache() const
-			{
-				return CurrentValueCache->Cache;
+				return Index;
 			}
 
 			CodaScriptMUPVariable* CodaScriptMUPParserMetadata::CreateWrapper(const CodaScriptSourceCodeT& Name, bool Global)
@@ -104,8 +238,10 @@ namespace bgsee
 				if (GetWrapper(Name, Global))
 					throw CodaScriptException("Variable wrapper '%s' already exists", Name);
 
+				// the caller appends the wrapper to the corresponding slot array
 				VarWrapperMapT& Source = Global ? Globals : Locals;
-				CodaScriptMUPVariable* Out = new CodaScriptMUPVariable(Name, Global);
+				UInt32 Slot = Global ? GlobalSlots.size() : LocalSlots.size();
+				CodaScriptMUPVariable* Out = new CodaScriptMUPVariable(Name, this, Global, Slot);
 				CodaScriptMUPVariable::PtrT Addend(Out);
 				Source.insert(std::make_pair(Name, std::move(Addend)));
 				return Out;
@@ -120,84 +256,86 @@ namespace bgsee
 					return Source.at(Name).get();
 			}
 
-			void CodaScriptMUPParserMetadata::BindWrappers(ICodaScriptExpressionParser::EvaluateData& Data)
+			void CodaScriptMUPParserMetadata::BindWrappers(ICodaScriptExpressionParser::EvaluateData& Data, CodaScriptMUPVariable::BindingFrame& OutFrame)
 			{
 				int LocalCount = Data.Context->GetProgram()->GetVariableCount();
 				int GlobalCount = Data.GlobalVariables.size();
-				std::vector<CodaScriptMUPVariable*> Transaction;
+
+				OutFrame.Owner = this;
+				OutFrame.Locals.resize(LocalSlots.size());
+				OutFrame.Globals.clear();
 
 				try
 				{
 					if (LocalCount != Locals.size())
 						throw CodaScriptException("Local variable count mismatch - Expected %d, received %d", Locals.size(), LocalCount);
-					else if (GlobalCount < Globals.size())
+					else if (ReferencesGlobals && GlobalCount < Globals.size())
 						// new globals aren't an issue as they aren't referenced by the bytecode
 						throw CodaScriptException("Global variable count mismatch - Expected %d, received %d", Globals.size(), GlobalCount);
 
-					for (auto& Itr : Locals)
+					for (UInt32 i = 0; i < LocalSlots.size(); i++)
 					{
-						CodaScriptVariable* Var = Data.Context->GetVariable(Itr.first);
+						CodaScriptVariable* Var = Data.Context->GetVariableBySlot(i);
 						if (Var == nullptr)
-							throw CodaScriptException("Couldn't find wrapped local variable '%s'", Itr.first.c_str());
+							throw CodaScriptException("Couldn't find wrapped local variable '%s'", LocalSlots[i]->GetName().c_str());
 
-						Itr.second->Bind(Var);
-						Transaction.push_back(Itr.second.get());
+						OutFrame.Locals[i] = LocalSlots[i]->Resolve(Var);
 					}
 
-					for (auto& Itr : Globals)
-					{
-						CodaScriptVariable* Var = Data.GetGlobal(Itr.first);
-						if (Var == nullptr)
-							throw CodaScriptException("Couldn't find wrapped global variable '%s'", Itr.first.c_str());
+					// the global store can't be read on worker threads, so it's left alone by programs that don't need it
+					if (ReferencesGlobals == false)
+						return;
 
-						Itr.second->Bind(Var);
-						Transaction.push_back(Itr.second.get());
+					OutFrame.Globals.reserve(GlobalSlots.size());
+					for (auto& Itr : GlobalSlots)
+					{
+						// a global that was removed can have its address reused by a new one, so the name is checked as well
+						if (Itr.Index >= Data.GlobalVariables.size() || Data.GlobalVariables[Itr.Index] != Itr.Variable ||
+							_stricmp(Itr.Variable->GetName(), Itr.Wrapper->GetName().c_str()))
+						{
+							// the global store was modified since the last binding, resolve the global by name
+							auto Match = std::find_if(Data.GlobalVariables.begin(), Data.GlobalVariables.end(),
+													  [&Itr](const CodaScriptVariable* Global) { return !_stricmp(Global->GetName(), Itr.Wrapper->GetName().c_str()); });
+							if (Match == Data.GlobalVariables.end())
+								throw CodaScriptException("Couldn't find wrapped global variable '%s'", Itr.Wrapper->GetName().c_str());
+
+							Itr.Index = Match - Data.GlobalVariables.begin();
+							Itr.Variable = *Match;
+						}
 
+						SME_ASSERT(Itr.Wrapper->GetSlot() == OutFrame.Globals.size());
+						OutFrame.Globals.push_back(Itr.Wrapper->Resolve(Itr.Variable));
 					}
 				}
 				catch (...)
 				{
-					// reset the transaction, flag the program and rethrow
-					for (auto Itr : Transaction)
-						Itr->Unbind();
+					// the frame is only activated after a successful binding, so there's nothing to roll back. flag the program and rethrow
+					OutFrame.Locals.clear();
+					OutFrame.Globals.clear();
 
 					Data.Context->GetProgram()->InvalidateBytecode();
 					throw;
 				}
 			}
 
-			void CodaScriptMUPParserMetadata::UnbindWrappers()
-			{
-				for (auto& Itr : Locals)
-					Itr.second->Unbind();
-
-				for (auto& Itr : Globals)
-					Itr.second->Unbind();
-			}
-
 			CodaScriptMUPParserMetadata::CodaScriptMUPParserMetadata(CodaScriptMUPExpressionParser* Parser, ICodaScriptProgram* Program) :
 				Parser(Parser),
 				Program(Program),
 				Locals(),
 				Globals(),
-				CompiledBytecode()
+				LocalSlots(),
+				GlobalSlots(),
+				CompiledBytecode(),
+				Backend(CodaScriptMUPEvaluationBackend::RPN),
+				ReferencesGlobals(true),
+				ThreadSafetyViolation()
 			{
 				SME_ASSERT(Parser && Program);
 			}
 
 			CodaScriptMUPParserMetadata::~CodaScriptMUPParserMetadata()
 			{
-				for (auto& Itr : Locals)
-				{
-					if (Itr.second->IsBound())
-						BGSEECONSOLE_MESSAGE("Local variable wrapper '%s' still bound to a value", Itr.first.c_str());
-				}
-
-				for (auto& Itr : Globals)
-				{
-					if (Itr.second->IsBound())
-						BGSEECONSOLE_MESSAGE("Global variable wrapper '%s' still bound to a value", Itr.first.c_str());
-				}
+				;//
 			}
 
 			ICodaScriptProgram* CodaScriptMUPParserMetadata::GetSourceProgram() const
@@ -210,6 +348,54 @@ namespace bgsee
 				return Parser;
 			}
 
+			const char* CodaScriptMUPParserMetadata::GetThreadSafetyViolation() const
+			{
+				if (ThreadSafetyViolation.empty())
+					return nullptr;
+				else
+					return ThreadSafetyViolation.c_str();
+			}
+
+			CodaScriptMUPEvaluationState::CodaScriptMUPEvaluationState(const CodaScriptMUPParserMetadata* Metadata) :
+				Metadata(Metadata),
+				Bindings(),
+				Buffers()
+			{
+				SME_ASSERT(Metadata);
+			}
+
+			CodaScriptMUPEvaluationState::~CodaScriptMUPEvaluationState()
+			{
+				SME_ASSERT(CodaScriptMUPVariable::GetActiveBindings() != &Bindings);
+			}
+
+			const CodaScriptMUPParserMetadata* CodaScriptMUPEvaluationState::GetMetadata() const
+			{
+				return Metadata;
+			}
+
+			CodaScriptMUPParserByteCode::ValueBuffer& CodaScriptMUPEvaluationState::GetBuffer(CodaScriptMUPParserByteCode* ByteCode)
+			{
+				UInt32 Index = ByteCode->GetIndex();
+				if (Index >= Buffers.size())
+					Buffers.resize(Index + 1);
+
+				// buffers are only allocated for the bytecode that the context actually evaluates
+				if (Buffers[Index] == nullptr)
+					Buffers[Index].reset(ByteCode->CreateBufferContext());
+
+				return *Buffers[Index];
+			}
+
+			void CodaScriptMUPEvaluationState::Scrub()
+			{
+				for (auto& Itr : Buffers)
+				{
+					if (Itr)
+						Itr->Scrub();
+				}
+			}
+
 			//------------------------------------------------------------------------------
 			const char_type *g_sCmdCode[] = { _T("BRCK. OPEN  "),
 				_T("BRCK. CLOSE "),
@@ -238,6 +424,8 @@ namespace bgsee
 				_T("SCRIPT_FUNC "),
 				_T("UNKNOWN     ") };
 
+			thread_local CodaScriptMUPExpressionParser::OperationContext::StackT		CodaScriptMUPExpressionParser::s_opContext;
+
 			const char_type* CodaScriptMUPExpressionParser::c_DefaultOprt[] = { _T("("),
 				_T(")"),
 				_T("["),
@@ -590,6 +778,194 @@ namespace bgsee
 				}
 			}
 
+			bool CodaScriptMUPExpressionParser::SerializeRPN(const RPN& Code, const var_maptype& Variables, CodaScriptBinaryWriter& Out) const
+			{
+				const token_vec_type& Tokens = Code.GetData();
+				Out.WriteUInt32(Tokens.size());
+
+				for (auto& Itr : Tokens)
+				{
+					ECmdCode Cmd = Itr->GetCode();
+					Out.WriteUInt8(Cmd);
+					Out.WriteInt32(Itr->GetExprPos());
+					Out.WriteString(Itr->GetIdent());
+
+					switch (Cmd)
+					{
+					case cmVAL:
+						{
+							IValue* Value = Itr->AsIValue();
+							Out.WriteUInt8(Value->IsVariable());
+
+							if (Value->IsVariable())
+							{
+								// variables are rebound by name
+								if (Variables.find(Itr->GetIdent()) == Variables.end())
+									return false;
+
+								break;
+							}
+
+							CodaScriptBackingStore* Store = Value->GetStore();
+							if (Store == nullptr)
+								return false;
+
+							Out.WriteUInt8(Store->GetType());
+							switch (Store->GetType())
+							{
+							case ICodaScriptDataStore::kDataType_Numeric:
+								Out.WriteDouble(Store->GetNumber());
+								break;
+							case ICodaScriptDataStore::kDataType_Reference:
+								Out.WriteUInt32(Store->GetFormID());
+								break;
+							case ICodaScriptDataStore::kDataType_String:
+								Out.WriteString(std::string(Store->GetString(), Store->GetStringLength()));
+								break;
+							default:
+								return false;
+							}
+						}
+
+						break;
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+					case cmOPRT_POSTFIX:
+						Out.WriteInt32(Itr->AsICallback()->GetArgsPresent());
+						break;
+					case cmIC:
+						Out.WriteInt32(Itr->AsIOprtIndex()->GetArgsPresent());
+						break;
+					case cmSCRIPT_NEWLINE:
+						Out.WriteInt32(static_cast<const TokenNewline&>(*Itr).GetStackOffset());
+						break;
+					case cmIF:
+					case cmELSE:
+					case cmENDIF:
+						// jump offsets are recalculated when the RPN is finalized
+						break;
+					default:
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			void CodaScriptMUPExpressionParser::DeserializeRPN(CodaScriptBinaryReader& In, const var_maptype& Variables, RPN& OutCode) const
+			{
+				for (UInt32 i = 0, j = In.ReadUInt32(); i < j; i++)
+				{
+					ECmdCode Cmd = static_cast<ECmdCode>(In.ReadUInt8());
+					int ExprPos = In.ReadInt32();
+					string_type Ident(In.ReadString());
+					ptr_tok_type Token;
+					int NewlineOffset = -1;
+
+					switch (Cmd)
+					{
+					case cmVAL:
+						if (In.ReadUInt8())
+						{
+							var_maptype::const_iterator Match = Variables.find(Ident);
+							if (Match == Variables.end())
+								throw CodaScriptException("Unknown variable '%s' in compiled image", Ident.c_str());
+
+							Token = ptr_tok_type(Match->second->Clone());
+						}
+						else
+						{
+							UInt8 Type = In.ReadUInt8();
+							switch (Type)
+							{
+							case ICodaScriptDataStore::kDataType_Numeric:
+								Token = ptr_tok_type(new CodaScriptMUPValue((float_type)In.ReadDouble()));
+								break;
+							case ICodaScriptDataStore::kDataType_Reference:
+								Token = ptr_tok_type(new CodaScriptMUPValue((CodaScriptReferenceDataTypeT)In.ReadUInt32()));
+								break;
+							case ICodaScriptDataStore::kDataType_String:
+								Token = ptr_tok_type(new CodaScriptMUPValue(string_type(In.ReadString())));
+								break;
+							default:
+								throw CodaScriptException("Invalid constant type %d in compiled image", Type);
+							}
+						}
+
+						break;
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+					case cmOPRT_POSTFIX:
+						{
+							const IToken* Definition = nullptr;
+							if (Cmd == cmFUNC && m_FunDef.find(Ident) != m_FunDef.end())
+								Definition = &*m_FunDef.find(Ident)->second;
+							else if (Cmd == cmOPRT_BIN && m_OprtDef.find(Ident) != m_OprtDef.end())
+								Definition = &*m_OprtDef.find(Ident)->second;
+							else if (Cmd == cmOPRT_INFIX && m_InfixOprtDef.find(Ident) != m_InfixOprtDef.end())
+								Definition = &*m_InfixOprtDef.find(Ident)->second;
+							else if (Cmd == cmOPRT_POSTFIX && m_PostOprtDef.find(Ident) != m_PostOprtDef.end())
+								Definition = &*m_PostOprtDef.find(Ident)->second;
+
+							if (Definition == nullptr)
+								throw CodaScriptException("Unknown callback '%s' in compiled image", Ident.c_str());
+
+							Token = ptr_tok_type(Definition->Clone());
+							if (Cmd == cmFUNC)
+								Token->Compile(_T("xxx"));
+
+							Token->AsICallback()->SetNumArgsPresent(In.ReadInt32());
+						}
+
+						break;
+					case cmIC:
+						Token = ptr_tok_type(new OprtIndex());
+						Token->AsIOprtIndex()->SetNumArgsPresent(In.ReadInt32());
+						break;
+					case cmSCRIPT_NEWLINE:
+						Token = ptr_tok_type(new TokenNewline());
+						NewlineOffset = In.ReadInt32();
+						break;
+					case cmIF:
+					case cmELSE:
+					case cmENDIF:
+						Token = ptr_tok_type(new TokenIfThenElse(Cmd));
+						break;
+					default:
+						throw CodaScriptException("Invalid token %d in compiled image", Cmd);
+					}
+
+					Token->SetIdent(Ident);
+					Token->SetExprPos(ExprPos);
+
+					if (Cmd == cmSCRIPT_NEWLINE)
+						OutCode.AddNewline(Token, NewlineOffset);
+					else
+						OutCode.Add(Token);
+				}
+
+				OutCode.Finalize();
+			}
+
+#define CODASCRIPTMUPPARSER_INISECTION							"CodaExpressionParser"
+			SME::INI::INISetting								CodaScriptMUPExpressionParser::kINI_RegisterBackend("RegisterBackend", CODASCRIPTMUPPARSER_INISECTION,
+																												"Evaluate expressions with the register-based interpreter instead of walking the RPN",
+																												(SInt32)0);
+			SME::INI::INISetting								CodaScriptMUPExpressionParser::kINI_ConstantFolding("ConstantFolding", CODASCRIPTMUPPARSER_INISECTION,
+																												"Evaluate constant subexpressions and prune dead ternary branches at compile time",
+																												(SInt32)1);
+			SME::INI::INISetting								CodaScriptMUPExpressionParser::kINI_TypeSpecialization("TypeSpecialization", CODASCRIPTMUPPARSER_INISECTION,
+																												"Infer the types of local variables and specialize operators whose operand types are known",
+																												(SInt32)1);
+			SME::INI::INISetting								CodaScriptMUPExpressionParser::kINI_Superinstructions("Superinstructions", CODASCRIPTMUPPARSER_INISECTION,
+																												"Fuse common token sequences into single instructions",
+																												(SInt32)1);
+			SME::INI::INISetting								CodaScriptMUPExpressionParser::kINI_TailCalls("TailCalls", CODASCRIPTMUPPARSER_INISECTION,
+																												"Run self-calls in tail position in the caller's frame instead of recursing",
+																												(SInt32)1);
+
 			CodaScriptMUPExpressionParser::CodaScriptMUPExpressionParser() :
 				ICodaScriptExpressionParser(),
 				m_TokenReader(),
@@ -601,7 +977,8 @@ namespace bgsee
 				m_sNameChars(),
 				m_sOprtChars(),
 				m_sInfixOprtChars(),
-				m_opContext()
+				m_BackendOverrides(),
+				m_CommandTableHash(CodaScriptHash::kOffsetBasis)
 			{
 				DefineNameChars(_T("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"));
 				DefineOprtChars(_T("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+-*^/?<>=#!$%&|~'_{}"));
@@ -616,7 +993,7 @@ namespace bgsee
 
 			CodaScriptMUPExpressionParser::~CodaScriptMUPExpressionParser()
 			{
-				SME_ASSERT(m_opContext.empty());
+				SME_ASSERT(s_opContext.empty());
 			}
 
 			void CodaScriptMUPExpressionParser::AddValueReader( IValueReader *a_pReader )
@@ -693,9 +1070,9 @@ namespace bgsee
 
 			const var_maptype& CodaScriptMUPExpressionParser::GetVar() const
 			{
-				SME_ASSERT(m_opContext.empty() == false);
+				SME_ASSERT(s_opContext.empty() == false);
 
-				const OperationContext& Context = m_opContext.top();
+				const OperationContext& Context = s_opContext.top();
 				SME_ASSERT(Context.Type == OperationType::Compile);
 
 				return Context.CompileData.Variables;
@@ -745,11 +1122,48 @@ namespace bgsee
 
 				if (Command->GetAlias())
 					DefineFun(new CodaScriptMUPScriptCommand(Command, true));
+
+				// serialized bytecode binds commands by name and bakes in their argument counts
+				ICodaScriptCommand::ParameterInfo* ParamData = nullptr;
+				UInt8 ResultType = ICodaScriptDataStore::kDataType_Invalid;
+				int ParamCount = Command->GetParameterData(nullptr, &ParamData, &ResultType);
+
+				m_CommandTableHash = CodaScriptHash::Compute(Command->GetName(), strlen(Command->GetName()), m_CommandTableHash);
+				if (Command->GetAlias())
+					m_CommandTableHash = CodaScriptHash::Compute(Command->GetAlias(), strlen(Command->GetAlias()), m_CommandTableHash);
+
+				m_CommandTableHash = CodaScriptHash::Compute(&ParamCount, sizeof(ParamCount), m_CommandTableHash);
+				m_CommandTableHash = CodaScriptHash::Compute(&ResultType, sizeof(ResultType), m_CommandTableHash);
+				for (int i = 0; ParamData && i < ParamCount; i++)
+					m_CommandTableHash = CodaScriptHash::Compute(&ParamData[i].Type, sizeof(ParamData[i].Type), m_CommandTableHash);
 			}
 
 			void CodaScriptMUPExpressionParser::RegisterConstant( const char* Name, CodaScriptBackingStore& Value )
 			{
 				DefineConst(Name, CodaScriptMUPValue(Value));
+
+				// constants are inlined into the bytecode
+				m_CommandTableHash = CodaScriptHash::Compute(Name, strlen(Name), m_CommandTableHash);
+				switch (Value.GetType())
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					{
+						CodaScriptNumericDataTypeT Number = Value.GetNumber();
+						m_CommandTableHash = CodaScriptHash::Compute(&Number, sizeof(Number), m_CommandTableHash);
+					}
+
+					break;
+				case ICodaScriptDataStore::kDataType_Reference:
+					{
+						CodaScriptReferenceDataTypeT FormID = Value.GetFormID();
+						m_CommandTableHash = CodaScriptHash::Compute(&FormID, sizeof(FormID), m_CommandTableHash);
+					}
+
+					break;
+				case ICodaScriptDataStore::kDataType_String:
+					m_CommandTableHash = CodaScriptHash::Compute(Value.GetString(), Value.GetStringLength(), m_CommandTableHash);
+					break;
+				}
 			}
 
 			void CodaScriptMUPExpressionParser::RegisterProgram(ICodaScriptProgram* Program)
@@ -776,19 +1190,36 @@ namespace bgsee
 					CodaScriptMUPVariable* Wrapper = Metadata->CreateWrapper(Itr, false);
 					SME_ASSERT(Wrapper);
 					OpContext.CompileData.Variables[Itr] = ptr_tok_type(new Variable(Wrapper));
+
+					// variable names are returned in slot order
+					SME_ASSERT(Program->GetVariableSlot(Itr) == Metadata->LocalSlots.size());
+					Metadata->LocalSlots.push_back(Wrapper);
 				}
 
-				for (auto Itr : Data.GlobalVariables)
+				for (UInt32 i = 0; i < Data.GlobalVariables.size(); i++)
 				{
+					CodaScriptVariable* Itr = Data.GlobalVariables[i];
 					CheckVariableName(Itr->GetName(), OpContext.CompileData.Variables);
 
 					CodaScriptMUPVariable* Wrapper = Metadata->CreateWrapper(Itr->GetName(), true);
 					SME_ASSERT(Wrapper);
 					OpContext.CompileData.Variables[Itr->GetName()] = ptr_tok_type(new Variable(Wrapper));
+					Metadata->GlobalSlots.push_back(CodaScriptMUPParserMetadata::GlobalSlot(Wrapper, i, Itr));
 				}
 
+				std::string Filepath(Program->GetFilepath()());
+				SME::StringHelpers::MakeLower(Filepath);
+				if (m_BackendOverrides.count(Filepath))
+					Metadata->Backend = m_BackendOverrides.at(Filepath);
+				else
+					Metadata->Backend = GetDefaultEvaluationBackend();
+
+				OpContext.CompileData.CachedImage = Data.CachedImage;
+				OpContext.CompileData.ImageRecorder = Data.ImageRecorder;
 				OpContext.CompileData.Metadata = Metadata.release();
-				m_opContext.push(OpContext);
+				// the wrappers of the program being compiled mustn't resolve against the frame of an enclosing evaluation
+				OpContext.CompileData.SuspendedBindings = CodaScriptMUPVariable::SetActiveBindings(nullptr);
+				s_opContext.push(OpContext);
 			}
 
 			void CodaScriptMUPExpressionParser::Compile(ICodaScriptSyntaxTreeEvaluator* EvaluationAgent,
@@ -796,9 +1227,9 @@ namespace bgsee
 														ICodaScriptExpressionByteCode** OutByteCode)
 			{
 				SME_ASSERT(SourceCode && OutByteCode && EvaluationAgent);
-				SME_ASSERT(m_opContext.empty() == false);
+				SME_ASSERT(s_opContext.empty() == false);
 
-				OperationContext& Context = m_opContext.top();
+				OperationContext& Context = s_opContext.top();
 				SME_ASSERT(Context.Type == OperationType::Compile && Context.CompileData.Metadata);
 				SME_ASSERT(Context.Bytecode == nullptr);
 				SME_ASSERT(Context.Program == EvaluationAgent->GetProgram());
@@ -821,8 +1252,31 @@ namespace bgsee
 
 					*OutByteCode = nullptr;
 
-					m_TokenReader->SetExpr(SourceCode->GetSourceCode());
-					CreateRPN(GeneratedCode.get());
+					if (SourceCode->GetType() == ICodaScriptExecutableCode::kCodeType_Loop_FOREACH)
+					{
+						CodaScriptFOREACHBlock* Loop = dynamic_cast<CodaScriptFOREACHBlock*>(SourceCode);
+						SME_ASSERT(Loop);
+
+						Context.CompileData.Iterators.push_back(Loop->GetIteratorName());
+					}
+
+					if (Context.CompileData.CachedImage)
+						DeserializeRPN(*Context.CompileData.CachedImage, Context.CompileData.Variables, GeneratedCode->RPNStack);
+					else
+					{
+						m_TokenReader->SetExpr(SourceCode->GetSourceCode());
+						CreateRPN(GeneratedCode.get());
+						if (kINI_ConstantFolding().i)
+							CodaScriptMUPRPNOptimizer().Optimize(GeneratedCode->RPNStack);
+
+						CodaScriptBinaryWriter* Recorder = Context.CompileData.ImageRecorder;
+						if (Recorder && SerializeRPN(GeneratedCode->RPNStack, Context.CompileData.Variables, *Recorder) == false)
+							Recorder->Invalidate();
+					}
+
+					GeneratedCode->FlagAssignmentTargets();
+					GeneratedCode->GenerateRegisterStream();
+					GeneratedCode->Index = Context.CompileData.Metadata->CompiledBytecode.size();
 					Context.CompileData.Metadata->CompiledBytecode.push_back(GeneratedCode.get());
 
 					*OutByteCode = GeneratedCode.release();
@@ -837,15 +1291,30 @@ namespace bgsee
 			{
 				SME_ASSERT(OutMetadata);
 
-				if (m_opContext.empty())
+				if (s_opContext.empty())
 					throw CodaScriptException("Parser operation stack underflow");
 
-				OperationContext& Current = m_opContext.top();
+				OperationContext& Current = s_opContext.top();
 				if (Current.Type != OperationType::Compile || Current.Program != Program)
 					throw CodaScriptException("Mismatched end compilation call");
 
+				CodaScriptMUPVariable::SetActiveBindings(Current.CompileData.SuspendedBindings);
+
+				// the optimization passes fold command calls and variable loads into compound tokens, so this goes first
+				VerifyThreadSafety(Current);
+
+				if (kINI_TypeSpecialization().i)
+					SpecializeOperators(Current);
+
+				// fusion hides assignments from type inference, so it goes last
+				if (kINI_Superinstructions().i)
+					FuseSuperinstructions(Current);
+
+				if (kINI_TailCalls().i)
+					EliminateTailCalls(Current);
+
 				*OutMetadata = Current.CompileData.Metadata;
-				m_opContext.pop();
+				s_opContext.pop();
 			}
 
 			void CodaScriptMUPExpressionParser::BeginEvaluation(ICodaScriptProgram* Program, EvaluateData Data)
@@ -854,13 +1323,187 @@ namespace bgsee
 				CodaScriptMUPParserMetadata* Metadata = dynamic_cast<CodaScriptMUPParserMetadata*>(Program->GetCompilerMetadata());
 				SME_ASSERT(Metadata);
 
-				// bind the variables to the execution context
-				Metadata->BindWrappers(Data);
-				m_opContext.push(OpContext);
+				// the value buffers and bindings live in the execution context, so reused contexts come with warm buffers
+				CodaScriptMUPEvaluationState* State = dynamic_cast<CodaScriptMUPEvaluationState*>(Data.Context->GetEvaluationState());
+				if (State == nullptr || State->GetMetadata() != Metadata)
+				{
+					State = new CodaScriptMUPEvaluationState(Metadata);
+					Data.Context->SetEvaluationState(State);
+				}
+
+				// bind the variables to the execution context and activate them on this thread
+				Metadata->BindWrappers(Data, State->Bindings);
+				State->Bindings.Previous = CodaScriptMUPVariable::SetActiveBindings(&State->Bindings);
 
-				// create new value buffers for the current context
-				for (auto& Itr : Metadata->CompiledBytecode)
-					Itr->PushBufferContext();
+				OpContext.EvaluateData.Backend = Metadata->Backend;
+				OpContext.EvaluateData.State = State;
+				s_opContext.push(OpContext);
+			}
+
+			void CodaScriptMUPExpressionParser::InvokeCallback(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer,
+															   ICallback* Callback, ptr_val_type* Args, int Argc) const
+			{
+				ptr_val_type &val = Args[0];
+				try
+				{
+					if (val->IsVariable())
+					{
+						ptr_val_type buf(Buffer.Cache.CreateFromCache());
+						Callback->Eval(buf, Args, Argc);
+						val = buf;
+					}
+					else
+						Callback->Eval(val, Args, Argc);
+				}
+				catch (ParserError &exc)
+				{
+					// <ibg 20130131> Not too happy about that:
+					// Multiarg functions may throw ecTOO_FEW_PARAMS from eval. I don't
+					// want this to be converted to ecEVAL because fixed argument functions
+					// already throw ecTOO_FEW_PARAMS in case of missing parameters and two
+					// different error codes would be inconsistent.
+					if (exc.GetCode() == ecTOO_FEW_PARAMS || exc.GetCode() == ecDOMAIN_ERROR || exc.GetCode() == ecOVERFLOW)
+						throw;
+					// </ibg>
+
+					ErrorContext err;
+					err.Expr = ByteCode->GetSource()->GetSourceCode();
+					err.Ident = Callback->GetIdent();
+					err.Errc = ecEVAL;
+					err.Pos = Callback->GetExprPos();
+					err.Hint = exc.GetMsg();
+					throw ParserError(err);
+				}
+				catch (MatrixError& /*exc*/)
+				{
+					ErrorContext err;
+					err.Expr = ByteCode->GetSource()->GetSourceCode();
+					err.Ident = Callback->GetIdent();
+					err.Errc = ecMATRIX_DIMENSION_MISMATCH;
+					err.Pos = Callback->GetExprPos();
+					throw ParserError(err);
+				}
+			}
+
+			void CodaScriptMUPExpressionParser::EvaluateRPN(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer) const
+			{
+				ptr_val_type *pStack = &Buffer.StackBuffer[0];
+				const ptr_tok_type *pRPN = &(ByteCode->RPNStack.GetData()[0]);
+
+				int sidx = -1;
+				std::size_t lenRPN = ByteCode->RPNStack.GetSize();
+				for (std::size_t i = 0; i < lenRPN; ++i)
+				{
+					IToken *pTok = pRPN[i].Get();
+					ECmdCode eCode = pTok->GetCode();
+
+					switch (eCode)
+					{
+					case cmSCRIPT_NEWLINE:
+						sidx = -1;
+						continue;
+					case cmVAL:
+						{
+							IValue *pVal = static_cast<IValue*>(pTok);
+
+							sidx++;
+							assert(sidx < (int)Buffer.StackBuffer.size());
+							if (pVal->IsVariable())
+							{
+								pStack[sidx].Reset(pVal);
+							}
+							else
+							{
+								ptr_val_type &val = pStack[sidx];
+								if (val->IsVariable())
+									val.Reset(Buffer.Cache.CreateFromCache());
+
+								*val = *(static_cast<IValue*>(pTok));
+							}
+						}
+						continue;
+					case  cmIC:
+						{
+							IOprtIndex *pIdxOprt = static_cast<IOprtIndex*>(pTok);
+							int nArgs = pIdxOprt->GetArgsPresent();
+							sidx -= nArgs - 1;
+							assert(sidx >= 0);
+
+							ptr_val_type &idx = pStack[sidx];     // Pointer to the first index
+							ptr_val_type &val = pStack[--sidx];   // Pointer to the variable or value being indexed
+							pIdxOprt->At(val, &idx, nArgs);
+						}
+						continue;
+					case cmOPRT_POSTFIX:
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+						{
+							ICallback *pFun = static_cast<ICallback*>(pTok);
+							int nArgs = pFun->GetArgsPresent();
+							sidx -= nArgs - 1;
+							assert(sidx >= 0);
+
+							InvokeCallback(ByteCode, Buffer, pFun, &pStack[sidx], nArgs);
+						}
+						continue;
+					case cmIF:
+						MUP_ASSERT(sidx >= 0);
+						if (pStack[sidx--]->GetBool() == false)
+							i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
+						continue;
+					case cmELSE:
+					case cmJMP:
+						i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
+						continue;
+					case cmENDIF:
+						continue;
+					default:
+						Error(ecINTERNAL_ERROR);
+					} // switch token
+				} // for all RPN tokens
+			}
+
+			void CodaScriptMUPExpressionParser::EvaluateRegisterStream(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer) const
+			{
+				typedef CodaScriptMUPParserByteCode::Instruction::OpCode OpCode;
+
+				ptr_val_type* Registers = &Buffer.StackBuffer[0];
+				const CodaScriptMUPParserByteCode::Instruction* Stream = ByteCode->RegisterStream.data();
+				const std::size_t Length = ByteCode->RegisterStream.size();
+
+				std::size_t Pos = 0;
+				while (Pos < Length)
+				{
+					const CodaScriptMUPParserByteCode::Instruction& Current = Stream[Pos++];
+					ptr_val_type& Register = Registers[Current.Register];
+
+					switch (Current.Op)
+					{
+					case OpCode::LoadConstant:
+						if (Register->IsVariable())
+							Register.Reset(Buffer.Cache.CreateFromCache());
+
+						*Register = *static_cast<IValue*>(Current.Operand);
+						break;
+					case OpCode::LoadVariable:
+						Register.Reset(static_cast<IValue*>(Current.Operand));
+						break;
+					case OpCode::Invoke:
+						InvokeCallback(ByteCode, Buffer, static_cast<ICallback*>(Current.Operand), &Register, Current.Argc);
+						break;
+					case OpCode::Index:
+						static_cast<IOprtIndex*>(Current.Operand)->At(Register, &Register + 1, Current.Argc);
+						break;
+					case OpCode::JumpIfFalse:
+						if (Register->GetBool() == false)
+							Pos = Current.Target;
+						break;
+					case OpCode::Jump:
+						Pos = Current.Target;
+						break;
+					}
+				}
 			}
 
 			void CodaScriptMUPExpressionParser::Evaluate(ICodaScriptSyntaxTreeEvaluator* EvaluationAgent,
@@ -872,8 +1515,8 @@ namespace bgsee
 				CodaScriptMUPParserByteCode* CompiledByteCode = dynamic_cast<CodaScriptMUPParserByteCode*>(ByteCode);
 				SME_ASSERT(CompiledByteCode);
 
-				SME_ASSERT(m_opContext.empty() == false);
-				OperationContext& Context = m_opContext.top();
+				SME_ASSERT(s_opContext.empty() == false);
+				OperationContext& Context = s_opContext.top();
 				SME_ASSERT(Context.Type == OperationType::Evaluate && Context.EvaluateData.ExecutionContext == EvaluationAgent->GetContext());
 				SME_ASSERT(Context.Bytecode == nullptr);
 				SME_ASSERT(Context.Program == EvaluationAgent->GetProgram());
@@ -893,7 +1536,6 @@ namespace bgsee
 						}
 					});
 
-					ptr_val_type *pStack = &CompiledByteCode->GetStackBuffer()[0];
 					if (CompiledByteCode->RPNStack.GetSize() == 0)
 					{
 						ErrorContext err;
@@ -903,123 +1545,17 @@ namespace bgsee
 						throw ParserError(err);
 					}
 
-					const ptr_tok_type *pRPN = &(CompiledByteCode->RPNStack.GetData()[0]);
-
-					int sidx = -1;
-					std::size_t lenRPN = CompiledByteCode->RPNStack.GetSize();
-					for (std::size_t i = 0; i < lenRPN; ++i)
-					{
-						IToken *pTok = pRPN[i].Get();
-						ECmdCode eCode = pTok->GetCode();
-
-						switch (eCode)
-						{
-						case cmSCRIPT_NEWLINE:
-							sidx = -1;
-							continue;
-						case cmVAL:
-							{
-								IValue *pVal = static_cast<IValue*>(pTok);
-
-								sidx++;
-								assert(sidx < (int)CompiledByteCode->GetStackBuffer().size());
-								if (pVal->IsVariable())
-								{
-									pStack[sidx].Reset(pVal);
-								}
-								else
-								{
-									ptr_val_type &val = pStack[sidx];
-									if (val->IsVariable())
-										val.Reset(CompiledByteCode->GetCache().CreateFromCache());
-
-									*val = *(static_cast<IValue*>(pTok));
-								}
-							}
-							continue;
-						case  cmIC:
-							{
-								IOprtIndex *pIdxOprt = static_cast<IOprtIndex*>(pTok);
-								int nArgs = pIdxOprt->GetArgsPresent();
-								sidx -= nArgs - 1;
-								assert(sidx >= 0);
-
-								ptr_val_type &idx = pStack[sidx];     // Pointer to the first index
-								ptr_val_type &val = pStack[--sidx];   // Pointer to the variable or value being indexed
-								pIdxOprt->At(val, &idx, nArgs);
-							}
-							continue;
-						case cmOPRT_POSTFIX:
-						case cmFUNC:
-						case cmOPRT_BIN:
-						case cmOPRT_INFIX:
-							{
-								ICallback *pFun = static_cast<ICallback*>(pTok);
-								int nArgs = pFun->GetArgsPresent();
-								sidx -= nArgs - 1;
-								assert(sidx >= 0);
+					SME_ASSERT(Context.EvaluateData.State);
+					CodaScriptMUPParserByteCode::ValueBuffer& Buffer = Context.EvaluateData.State->GetBuffer(CompiledByteCode);
 
-								ptr_val_type &val = pStack[sidx];
-								try
-								{
-									if (val->IsVariable())
-									{
-										ptr_val_type buf(CompiledByteCode->GetCache().CreateFromCache());
-										pFun->Eval(buf, &val, nArgs);
-										val = buf;
-									}
-									else
-										pFun->Eval(val, &val, nArgs);
-								}
-								catch (ParserError &exc)
-								{
-									// <ibg 20130131> Not too happy about that:
-									// Multiarg functions may throw ecTOO_FEW_PARAMS from eval. I don't
-									// want this to be converted to ecEVAL because fixed argument functions
-									// already throw ecTOO_FEW_PARAMS in case of missing parameters and two
-									// different error codes would be inconsistent.
-									if (exc.GetCode() == ecTOO_FEW_PARAMS || exc.GetCode() == ecDOMAIN_ERROR || exc.GetCode() == ecOVERFLOW)
-										throw;
-									// </ibg>
-
-									ErrorContext err;
-									err.Expr = CompiledByteCode->GetSource()->GetSourceCode();
-									err.Ident = pFun->GetIdent();
-									err.Errc = ecEVAL;
-									err.Pos = pFun->GetExprPos();
-									err.Hint = exc.GetMsg();
-									throw ParserError(err);
-								}
-								catch (MatrixError& /*exc*/)
-								{
-									ErrorContext err;
-									err.Expr = CompiledByteCode->GetSource()->GetSourceCode();
-									err.Ident = pFun->GetIdent();
-									err.Errc = ecMATRIX_DIMENSION_MISMATCH;
-									err.Pos = pFun->GetExprPos();
-									throw ParserError(err);
-								}
-							}
-							continue;
-						case cmIF:
-							MUP_ASSERT(sidx >= 0);
-							if (pStack[sidx--]->GetBool() == false)
-								i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
-							continue;
-						case cmELSE:
-						case cmJMP:
-							i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
-							continue;
-						case cmENDIF:
-							continue;
-						default:
-							Error(ecINTERNAL_ERROR);
-						} // switch token
-					} // for all RPN tokens
+					if (Context.EvaluateData.Backend == CodaScriptMUPEvaluationBackend::Register)
+						EvaluateRegisterStream(CompiledByteCode, Buffer);
+					else
+						EvaluateRPN(CompiledByteCode, Buffer);
 
 					if (Result)
 					{
-						*Result = *pStack[0]->GetStore();
+						*Result = *Buffer.StackBuffer[0]->GetStore();
 					}
 				}
 				catch (ParserError& E)
@@ -1034,20 +1570,39 @@ namespace bgsee
 				CodaScriptMUPParserMetadata* Metadata = dynamic_cast<CodaScriptMUPParserMetadata*>(Program->GetCompilerMetadata());
 				SME_ASSERT(Metadata);
 
-				if (m_opContext.empty())
+				if (s_opContext.empty())
 					throw CodaScriptException("Parser operation stack underflow");
 
-				OperationContext& Current = m_opContext.top();
+				OperationContext& Current = s_opContext.top();
 				if (Current.Type != OperationType::Evaluate || Current.Program != Program)
 					throw CodaScriptException("Mismatched end evaluation call");
 
-				// restore the variables to their previous binding
-				Metadata->UnbindWrappers();
-				m_opContext.pop();
+				// restore the bindings of the enclosing evaluation, if any
+				CodaScriptMUPEvaluationState* State = Current.EvaluateData.State;
+				SME_ASSERT(State && CodaScriptMUPVariable::GetActiveBindings() == &State->Bindings);
+				CodaScriptMUPVariable::SetActiveBindings(State->Bindings.Previous);
+				State->Bindings.Previous = nullptr;
+				s_opContext.pop();
 
-				// release the current value buffer
-				for (auto& Itr : Metadata->CompiledBytecode)
-					Itr->PopBufferContext();
+				// the buffers are retained by the context but mustn't keep its values alive
+				State->Scrub();
+			}
+
+			UInt32 CodaScriptMUPExpressionParser::GetCommandTableVersion() const
+			{
+				return m_CommandTableHash;
+			}
+
+			UInt32 CodaScriptMUPExpressionParser::GetBytecodeVersion() const
+			{
+				// the optimizer rewrites the RPN, so images compiled with and without it aren't interchangeable
+				UInt32 Version = CodaScriptHash::Compute(GetVersion());
+				UInt32 ImageVersion = kBytecodeImageVersion;
+				SInt32 ConstantFolding = kINI_ConstantFolding().i;
+
+				Version = CodaScriptHash::Compute(&ImageVersion, sizeof(ImageVersion), Version);
+				Version = CodaScriptHash::Compute(&ConstantFolding, sizeof(ConstantFolding), Version);
+				return Version;
 			}
 
 			string_type CodaScriptMUPExpressionParser::GetVersion() const
@@ -1072,22 +1627,174 @@ namespace bgsee
 				}
 			}
 
+			void CodaScriptMUPExpressionParser::SpecializeOperators(OperationContext& Context) const
+			{
+				CodaScriptMUPParserMetadata* Metadata = Context.CompileData.Metadata;
+				CodaScriptMUPTypeInference Inference;
+
+				// globals, parameters and loop iterators are assigned outside of the program's expressions and stay untyped
+				CodaScriptVariableNameArrayT Parameters;
+				Context.Program->GetParameters(Parameters);
+
+				for (auto Itr : Metadata->LocalSlots)
+				{
+					const CodaScriptSourceCodeT& Name = Itr->GetName();
+					if (std::find(Parameters.begin(), Parameters.end(), Name) != Parameters.end() ||
+						std::find(Context.CompileData.Iterators.begin(), Context.CompileData.Iterators.end(), Name) != Context.CompileData.Iterators.end())
+					{
+						continue;
+					}
+
+					Inference.RegisterVariable(Name);
+				}
+
+				// the variable types only ever widen, so this terminates
+				bool Widened = true;
+				while (Widened)
+				{
+					Widened = false;
+					for (auto Itr : Metadata->CompiledBytecode)
+						Widened |= Inference.Analyze(Itr->RPNStack);
+				}
+
+				for (auto Itr : Metadata->CompiledBytecode)
+				{
+					if (Inference.Specialize(Itr->RPNStack))
+						Itr->GenerateRegisterStream();
+				}
+			}
+
+			void CodaScriptMUPExpressionParser::VerifyThreadSafety(OperationContext& Context) const
+			{
+				CodaScriptMUPParserMetadata* Metadata = Context.CompileData.Metadata;
+				Metadata->ReferencesGlobals = false;
+				Metadata->ThreadSafetyViolation.clear();
+
+				for (auto Itr : Metadata->CompiledBytecode)
+				{
+					for (auto& Token : Itr->RPNStack.GetData())
+					{
+						std::string Violation;
+
+						if (Token->GetCode() == cmVAL)
+						{
+							Variable* Var = dynamic_cast<Variable*>(Token->AsIValue());
+							CodaScriptMUPVariable* Wrapper = Var ? dynamic_cast<CodaScriptMUPVariable*>(Var->GetPtr()) : nullptr;
+							if (Wrapper == nullptr || Metadata->GetWrapper(Wrapper->GetName(), true) != Wrapper)
+								continue;
+
+							// globals are shared with the main thread
+							Metadata->ReferencesGlobals = true;
+							Violation = "accesses global variable '" + Wrapper->GetName() + "'";
+						}
+						else
+						{
+							CodaScriptMUPScriptCommand* Command = dynamic_cast<CodaScriptMUPScriptCommand*>(Token.Get());
+							if (Command == nullptr || Command->GetCommand()->IsThreadSafe())
+								continue;
+
+							Violation = std::string("calls '") + Command->GetCommand()->GetName() + "'";
+						}
+
+						if (Metadata->ThreadSafetyViolation.empty())
+						{
+							char Buffer[0x200] = {0};
+							FORMAT_STR(Buffer, "Line %d %s", Itr->GetSource()->GetLine(), Violation.c_str());
+							Metadata->ThreadSafetyViolation = Buffer;
+						}
+					}
+				}
+			}
+
+			void CodaScriptMUPExpressionParser::FuseSuperinstructions(OperationContext& Context) const
+			{
+				CodaScriptMUPSuperinstructionFuser Fuser;
+
+				for (auto Itr : Context.CompileData.Metadata->CompiledBytecode)
+				{
+					if (Fuser.Fuse(Itr->RPNStack))
+						Itr->GenerateRegisterStream();
+				}
+			}
+
+			void CodaScriptMUPExpressionParser::EliminateTailCalls(OperationContext& Context) const
+			{
+				for (auto Itr : Context.CompileData.Metadata->CompiledBytecode)
+				{
+					// the call's result has to be the sole argument of a return that ends the expression
+					const token_vec_type& Tokens = Itr->RPNStack.GetData();
+					if (Tokens.size() < 2)
+						continue;
+
+					CodaScriptMUPScriptCommand* Return = dynamic_cast<CodaScriptMUPScriptCommand*>(Tokens.back().Get());
+					CodaScriptMUPScriptCommand* Call = dynamic_cast<CodaScriptMUPScriptCommand*>(Tokens[Tokens.size() - 2].Get());
+
+					if (Return == nullptr || Call == nullptr || Return->GetArgsPresent() != 1 ||
+						dynamic_cast<commands::general::CodaScriptCommandReturn*>(Return->GetCommand()) == nullptr ||
+						dynamic_cast<commands::general::CodaScriptCommandCall*>(Call->GetCommand()) == nullptr ||
+						dynamic_cast<CodaScriptMUPTailCallCommand*>(Call))
+					{
+						continue;
+					}
+
+					// whether the callee is the program itself is only known at runtime
+					token_vec_type Rewritten(Tokens.begin(), Tokens.end() - 2);
+					Rewritten.push_back(ptr_tok_type(new CodaScriptMUPTailCallCommand(*Call, Tokens.back())));
+
+					Itr->RPNStack.Assign(Rewritten);
+					Itr->GenerateRegisterStream();
+				}
+			}
+
 			ICodaScriptSyntaxTreeEvaluator* CodaScriptMUPExpressionParser::GetCurrentEvaluationAgent() const
 			{
-				if (m_opContext.size())
-					return m_opContext.top().Agent;
+				if (s_opContext.size())
+					return s_opContext.top().Agent;
 				else
 					return nullptr;
 			}
 
 			CodaScriptMUPParserByteCode* CodaScriptMUPExpressionParser::GetCurrentByteCode(void) const
 			{
-				if (m_opContext.size())
-					return m_opContext.top().Bytecode;
+				if (s_opContext.size())
+					return s_opContext.top().Bytecode;
 				else
 					return nullptr;
 			}
 
+			void CodaScriptMUPExpressionParser::SetEvaluationBackend(const ResourceLocation& Filepath, CodaScriptMUPEvaluationBackend Backend)
+			{
+				std::string Key(Filepath());
+				SME::StringHelpers::MakeLower(Key);
+
+				m_BackendOverrides[Key] = Backend;
+			}
+
+			void CodaScriptMUPExpressionParser::ResetEvaluationBackend(const ResourceLocation& Filepath)
+			{
+				std::string Key(Filepath());
+				SME::StringHelpers::MakeLower(Key);
+
+				m_BackendOverrides.erase(Key);
+			}
+
+			CodaScriptMUPEvaluationBackend CodaScriptMUPExpressionParser::GetDefaultEvaluationBackend() const
+			{
+				if (kINI_RegisterBackend().i)
+					return CodaScriptMUPEvaluationBackend::Register;
+				else
+					return CodaScriptMUPEvaluationBackend::RPN;
+			}
+
+			void CodaScriptMUPExpressionParser::RegisterINISettings(INISettingDepotT& Depot)
+			{
+				Depot.push_back(&kINI_RegisterBackend);
+				Depot.push_back(&kINI_ConstantFolding);
+				Depot.push_back(&kINI_TypeSpecialization);
+				Depot.push_back(&kINI_Superinstructions);
+				Depot.push_back(&kINI_TailCalls);
+			}
+
 
 
 		}
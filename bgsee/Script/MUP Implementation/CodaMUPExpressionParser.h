@@ -14,6 +14,7 @@
 #include "CodaInterpreter.h"
 #include "CodaMUPValue.h"
 #include "CodaMUPVariable.h"
+#include "Main.h"
 
 namespace bgsee
 {
@@ -23,6 +24,14 @@ namespace bgsee
 		{
 			class CodaScriptMUPExpressionParser;
 			class CodaScriptMUPFunction;
+			class CodaScriptMUPEvaluationState;
+
+			// selects the interpreter loop used to evaluate a program's bytecode
+			enum class CodaScriptMUPEvaluationBackend
+			{
+				RPN,				// walks the token stream
+				Register,			// executes the flat register stream generated from the former
+			};
 
 			class CodaScriptMUPParserByteCode : public ICodaScriptExpressionByteCode
 			{
@@ -30,7 +39,8 @@ namespace bgsee
 
 				CodaScriptMUPParserByteCode(const CodaScriptMUPParserByteCode &ByteCode);
 				CodaScriptMUPParserByteCode& operator=(const CodaScriptMUPParserByteCode &ByteCode);
-			protected:
+			public:
+				// the value stack used to evaluate the bytecode, owned by the evaluation state of the executing context
 				struct ValueBuffer
 				{
 					val_vec_type					StackBuffer;
@@ -39,27 +49,57 @@ namespace bgsee
 					ValueBuffer();
 					~ValueBuffer();
 
+					void							Scrub();			// drops references held by the stack buffer so that it can be reused
+
 					typedef std::unique_ptr<ValueBuffer>	PtrT;
-					typedef std::stack<PtrT>				StackT;
+					typedef std::vector<PtrT>				PoolT;
+				};
+			protected:
+				static std::atomic<UInt32>		BufferAllocationCounter;
+
+				// flattened encoding of the RPN - stack positions are resolved to register (value buffer) indices,
+				// jump offsets to absolute targets, and newline/endif markers are dropped altogether
+				struct Instruction
+				{
+					enum class OpCode : UInt8
+					{
+						LoadConstant,			// R[Register] = copy of Operand
+						LoadVariable,			// R[Register] = reference to Operand
+						Invoke,					// R[Register] = Operand(R[Register]...R[Register + Argc - 1])
+						Index,					// R[Register] = R[Register][R[Register + 1]...R[Register + Argc]]
+						JumpIfFalse,			// if R[Register] == false, continue at Target
+						Jump,					// continue at Target
+					};
+
+					OpCode							Op;
+					int								Register;
+					int								Argc;
+					int								Target;
+					IToken*							Operand;			// owned by the RPN
+
+					Instruction(OpCode Op, int Register, IToken* Operand, int Argc = 0, int Target = -1) :
+						Op(Op), Register(Register), Argc(Argc), Target(Target), Operand(Operand) {}
+
+					typedef std::vector<Instruction>		ArrayT;
 				};
 
 				CodaScriptMUPExpressionParser*	Parser;
 
+				UInt32							Index;				// in the program's compiled bytecode
 				int								TokenPos;
 				RPN								RPNStack;			///< reverse polish notation
-				ValueBuffer::StackT				Buffer;				// buffers for currently executing contexts
-				ValueBuffer*					CurrentValueCache;
+				Instruction::ArrayT				RegisterStream;
 
-				ValueBuffer*					CreateBufferContext() const;
+				void							FlagAssignmentTargets();		// flags the index operators whose results are assigned to
+				void							GenerateRegisterStream();
 			public:
 				CodaScriptMUPParserByteCode(CodaScriptMUPExpressionParser* Parent, ICodaScriptExecutableCode* Source);
 				virtual ~CodaScriptMUPParserByteCode();
 
-				void							PushBufferContext();
-				void							PopBufferContext();
+				ValueBuffer*					CreateBufferContext() const;		// the bytecode is immutable once compiled, so this can be called from any thread
+				UInt32							GetIndex() const;
 
-				val_vec_type&					GetStackBuffer() const;
-				ValueCache&						GetCache() const;
+				static UInt32					GetBufferAllocationCount() { return BufferAllocationCounter; }
 
 				typedef std::vector<CodaScriptMUPParserByteCode*>		ArrayT;
 			};
@@ -73,23 +113,64 @@ namespace bgsee
 			protected:
 				typedef std::unordered_map<CodaScriptSourceCodeT, CodaScriptMUPVariable::PtrT>		VarWrapperMapT;		// key = name
 
+				struct GlobalSlot
+				{
+					CodaScriptMUPVariable*				Wrapper;
+					UInt32								Index;			// in the global variable array
+					CodaScriptVariable*					Variable;		// the global at the above index when last bound, used to validate the index
+
+					GlobalSlot(CodaScriptMUPVariable* Wrapper, UInt32 Index, CodaScriptVariable* Variable) :
+						Wrapper(Wrapper), Index(Index), Variable(Variable) {}
+
+					typedef std::vector<GlobalSlot>		ArrayT;
+				};
+
+				typedef std::vector<CodaScriptMUPVariable*>		LocalSlotArrayT;		// index = program variable slot
+
 				CodaScriptMUPExpressionParser*			Parser;
 				ICodaScriptProgram*						Program;
 				VarWrapperMapT							Locals;
 				VarWrapperMapT							Globals;
+				LocalSlotArrayT							LocalSlots;
+				GlobalSlot::ArrayT						GlobalSlots;
 				CodaScriptMUPParserByteCode::ArrayT		CompiledBytecode;
+				CodaScriptMUPEvaluationBackend			Backend;
+				bool									ReferencesGlobals;			// false if the bytecode never loads a global, binding the globals is skipped in that case
+				std::string								ThreadSafetyViolation;		// empty if the program is thread-safe
 
 				CodaScriptMUPVariable*			CreateWrapper(const CodaScriptSourceCodeT& Name, bool Global);
 				CodaScriptMUPVariable*			GetWrapper(const CodaScriptSourceCodeT& Name, bool Global) const;
 
-				void							BindWrappers(ICodaScriptExpressionParser::EvaluateData& Data);
-				void							UnbindWrappers();
+				void							BindWrappers(ICodaScriptExpressionParser::EvaluateData& Data, CodaScriptMUPVariable::BindingFrame& OutFrame);
 			public:
 				CodaScriptMUPParserMetadata(CodaScriptMUPExpressionParser* Parser, ICodaScriptProgram* Program);
 				virtual ~CodaScriptMUPParserMetadata();
 
 				virtual ICodaScriptExpressionParser*	GetParentParser() const override;
 				virtual ICodaScriptProgram*				GetSourceProgram() const override;
+				virtual const char*						GetThreadSafetyViolation() const override;
+			};
+
+			// the mutable half of a program's evaluation, one per execution context
+			// the compiled bytecode and metadata are only ever read during evaluation, so any number of contexts
+			// can evaluate the same program concurrently as long as each brings its own state
+			class CodaScriptMUPEvaluationState : public ICodaScriptEvaluationState
+			{
+				friend class CodaScriptMUPExpressionParser;
+
+				CodaScriptMUPEvaluationState(const CodaScriptMUPEvaluationState &State);
+				CodaScriptMUPEvaluationState& operator=(const CodaScriptMUPEvaluationState &State);
+			protected:
+				const CodaScriptMUPParserMetadata*				Metadata;		// the state is rebuilt if the program was recompiled since it was created
+				CodaScriptMUPVariable::BindingFrame				Bindings;
+				CodaScriptMUPParserByteCode::ValueBuffer::PoolT	Buffers;		// index = bytecode index, allocated on first use
+			public:
+				CodaScriptMUPEvaluationState(const CodaScriptMUPParserMetadata* Metadata);
+				virtual ~CodaScriptMUPEvaluationState();
+
+				const CodaScriptMUPParserMetadata*				GetMetadata() const;
+				CodaScriptMUPParserByteCode::ValueBuffer&		GetBuffer(CodaScriptMUPParserByteCode* ByteCode);
+				void											Scrub();		// releases the values referenced by the buffers at the end of an evaluation
 			};
 
 			// a stripped-down and slightly different implementation of mup::ParserXBase
@@ -119,30 +200,51 @@ namespace bgsee
 					struct
 					{
 						ICodaScriptExecutionContext*	ExecutionContext;
+						CodaScriptMUPEvaluationBackend	Backend;
+						CodaScriptMUPEvaluationState*	State;
 					} EvaluateData;
 
 					struct
 					{
 						CodaScriptMUPParserMetadata*	Metadata;
 						var_maptype						Variables;		// locals and globals
+						CodaScriptVariableNameArrayT	Iterators;		// locals assigned by FOREACH loops
+						CodaScriptBinaryReader*			CachedImage;
+						CodaScriptBinaryWriter*			ImageRecorder;
+						const CodaScriptMUPVariable::BindingFrame*		SuspendedBindings;		// bindings of the evaluation that triggered the compilation, if any
 					} CompileData;
 
 					OperationContext(OperationType Type, ICodaScriptProgram* Program, ICodaScriptExecutionContext* Context) :
-						Type(Type), Program(Program), Agent(nullptr), Bytecode(nullptr), EvaluateData{ Context }, CompileData{ nullptr }
+						Type(Type), Program(Program), Agent(nullptr), Bytecode(nullptr),
+						EvaluateData{ Context, CodaScriptMUPEvaluationBackend::RPN, nullptr }, CompileData{ nullptr }
 					{}
 
 					OperationContext(OperationType Type, ICodaScriptProgram* Program) :
-						Type(Type), Program(Program), Agent(nullptr), Bytecode(nullptr), EvaluateData{ nullptr }, CompileData{ nullptr }
+						Type(Type), Program(Program), Agent(nullptr), Bytecode(nullptr),
+						EvaluateData{ nullptr, CodaScriptMUPEvaluationBackend::RPN, nullptr }, CompileData{ nullptr }
 					{}
 				};
 
+				typedef std::unordered_map<std::string, CodaScriptMUPEvaluationBackend>		BackendOverrideMapT;		// key = script filepath
+
+				static INISetting								kINI_RegisterBackend;
+				static INISetting								kINI_ConstantFolding;
+				static INISetting								kINI_TypeSpecialization;
+				static INISetting								kINI_Superinstructions;
+				static INISetting								kINI_TailCalls;
+
+				static const UInt32								kBytecodeImageVersion = 1;		// bump when the RPN serialization format changes
+
+				static thread_local OperationContext::StackT	s_opContext;		///< Stores the contexts of the executing parser operations, per thread as thread-safe programs are evaluated on worker threads
+
 				std::unique_ptr<TokenReader>					m_TokenReader;
 				fun_maptype										m_FunDef;           ///< Function definitions
 				oprt_pfx_maptype								m_PostOprtDef;		///< Postfix operator callbacks
 				oprt_ifx_maptype								m_InfixOprtDef;		///< Infix operator callbacks.
 				oprt_bin_maptype								m_OprtDef;			///< Binary operator callbacks
 				val_maptype										m_valDef;			///< Definition of parser constants
-				OperationContext::StackT						m_opContext;		///< Stores the contexts of the executing parser operations
+				BackendOverrideMapT								m_BackendOverrides;	///< Per-program evaluation backend selection
+				UInt32											m_CommandTableHash;	///< Hash of the registered commands and constants
 
 				string_type										m_sNameChars;       ///< Charset for names
 				string_type										m_sOprtChars;       ///< Charset for postfix/ binary operator tokens
@@ -156,6 +258,13 @@ namespace bgsee
 
 				void											CheckName(const string_type &a_sName, const string_type &a_CharSet) const;
 				void											CreateRPN(CodaScriptMUPParserByteCode* OutByteCode) const;
+				bool											SerializeRPN(const RPN& Code, const var_maptype& Variables, CodaScriptBinaryWriter& Out) const;		// returns false if the RPN contains tokens that can't be serialized
+				void											DeserializeRPN(CodaScriptBinaryReader& In, const var_maptype& Variables, RPN& OutCode) const;
+
+				void											InvokeCallback(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer,
+																			   ICallback* Callback, ptr_val_type* Args, int Argc) const;
+				void											EvaluateRPN(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer) const;
+				void											EvaluateRegisterStream(CodaScriptMUPParserByteCode* ByteCode, CodaScriptMUPParserByteCode::ValueBuffer& Buffer) const;
 
 				const var_maptype&								GetVar() const;
 				const char_type**								GetOprtDef() const;
@@ -169,6 +278,10 @@ namespace bgsee
 				void											DefineInfixOprtChars(const char_type *a_szCharset);
 
 				void											CheckVariableName(const CodaScriptSourceCodeT& Name, const var_maptype& RegisteredVars) const;
+				void											VerifyThreadSafety(OperationContext& Context) const;
+				void											SpecializeOperators(OperationContext& Context) const;
+				void											FuseSuperinstructions(OperationContext& Context) const;
+				void											EliminateTailCalls(OperationContext& Context) const;
 			public:
 				CodaScriptMUPExpressionParser();
 				virtual ~CodaScriptMUPExpressionParser();
@@ -202,8 +315,18 @@ namespace bgsee
 																		 CodaScriptBackingStore* Result = nullptr) override;
 				virtual void									EndEvaluation(ICodaScriptProgram* Program) override;
 
+				virtual UInt32									GetCommandTableVersion() const override;
+				virtual UInt32									GetBytecodeVersion() const override;
+
 				ICodaScriptSyntaxTreeEvaluator*					GetCurrentEvaluationAgent() const;
 				CodaScriptMUPParserByteCode*					GetCurrentByteCode(void) const;
+
+				// the override takes effect the next time the program is compiled
+				void											SetEvaluationBackend(const ResourceLocation& Filepath, CodaScriptMUPEvaluationBackend Backend);
+				void											ResetEvaluationBackend(const ResourceLocation& Filepath);
+				CodaScriptMUPEvaluationBackend					GetDefaultEvaluationBackend() const;
+
+				static void										RegisterINISettings(INISettingDepotT& Depot);
 			};
 		}
 	}
@@ -0,0 +1,274 @@
+#include "CodaMUPOptimizer.h"
+#include "mpICallback.h"
+#include "mpIValue.h"
+#include "mpIOprt.h"
+#include "CodaMUPValue.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			bool CodaScriptMUPRPNOptimizer::Node::IsConstant() const
+			{
+				if (Type != NodeType::Value)
+					return false;
+
+				const IValue* Val = Token->AsIValue();
+				return Val && Val->IsVariable() == false;
+			}
+
+			bool CodaScriptMUPRPNOptimizer::BuildTree(const token_vec_type& Tokens, Node::ArrayT& OutStatements) const
+			{
+				struct PendingTernary
+				{
+					Node::PtrT		Condition;
+					Node::PtrT		Then;
+					ptr_tok_type	If;
+					ptr_tok_type	Else;
+				};
+
+				Node::ArrayT Operands;
+				std::vector<PendingTernary> Ternaries;
+
+				for (auto& Itr : Tokens)
+				{
+					switch (Itr->GetCode())
+					{
+					case cmVAL:
+						Operands.push_back(Node::PtrT(new Node(Node::NodeType::Value, Itr)));
+						break;
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+					case cmOPRT_POSTFIX:
+					case cmIC:
+						{
+							int Argc = -1;
+							if (Itr->GetCode() == cmIC)
+							{
+								// the index operator consumes the indexed value in addition to its arguments
+								IOprtIndex* Index = Itr->AsIOprtIndex();
+								if (Index)
+									Argc = Index->GetArgsPresent() + 1;
+							}
+							else
+							{
+								ICallback* Callback = Itr->AsICallback();
+								if (Callback)
+									Argc = Callback->GetArgsPresent();
+							}
+
+							if (Argc < 0 || Argc > static_cast<int>(Operands.size()))
+								return false;
+
+							Node::PtrT Current(new Node(Itr->GetCode() == cmIC ? Node::NodeType::Index : Node::NodeType::Callback, Itr));
+							for (auto Operand = Operands.end() - Argc; Operand != Operands.end(); ++Operand)
+								Current->Operands.push_back(std::move(*Operand));
+
+							Operands.erase(Operands.end() - Argc, Operands.end());
+							Operands.push_back(std::move(Current));
+						}
+
+						break;
+					case cmIF:
+						if (Operands.empty())
+							return false;
+
+						Ternaries.push_back(PendingTernary());
+						Ternaries.back().Condition = std::move(Operands.back());
+						Ternaries.back().If = Itr;
+						Operands.pop_back();
+
+						break;
+					case cmELSE:
+						if (Operands.empty() || Ternaries.empty())
+							return false;
+
+						Ternaries.back().Then = std::move(Operands.back());
+						Ternaries.back().Else = Itr;
+						Operands.pop_back();
+
+						break;
+					case cmENDIF:
+						{
+							if (Operands.empty() || Ternaries.empty() || Ternaries.back().Then == nullptr)
+								return false;
+
+							PendingTernary& Pending = Ternaries.back();
+							Node::PtrT Current(new Node(Node::NodeType::Ternary, Pending.If));
+							Current->Else = Pending.Else;
+							Current->EndIf = Itr;
+							Current->Operands.push_back(std::move(Pending.Condition));
+							Current->Operands.push_back(std::move(Pending.Then));
+							Current->Operands.push_back(std::move(Operands.back()));
+
+							Operands.pop_back();
+							Ternaries.pop_back();
+							Operands.push_back(std::move(Current));
+						}
+
+						break;
+					case cmSCRIPT_NEWLINE:
+						for (auto& Statement : Operands)
+							OutStatements.push_back(std::move(Statement));
+
+						Operands.clear();
+						OutStatements.push_back(Node::PtrT(new Node(Node::NodeType::Newline, Itr)));
+
+						break;
+					default:
+						// unknown token, leave the stream untouched
+						return false;
+					}
+				}
+
+				if (Ternaries.empty() == false)
+					return false;
+
+				for (auto& Statement : Operands)
+					OutStatements.push_back(std::move(Statement));
+
+				return true;
+			}
+
+			void CodaScriptMUPRPNOptimizer::Fold(Node::PtrT& Current)
+			{
+				for (auto& Itr : Current->Operands)
+					Fold(Itr);
+
+				switch (Current->Type)
+				{
+				case Node::NodeType::Callback:
+					{
+						ICallback* Callback = Current->Token->AsICallback();
+						if (Callback->IsPure() == false || Current->Operands.empty())
+							break;
+
+						for (auto& Itr : Current->Operands)
+						{
+							if (Itr->IsConstant() == false)
+								return;
+						}
+
+						ptr_tok_type Result;
+						if (EvaluateConstant(Callback, Current->Operands, Result))
+						{
+							Current.reset(new Node(Node::NodeType::Value, Result));
+							FoldCount++;
+						}
+					}
+
+					break;
+				case Node::NodeType::Ternary:
+					{
+						if (Current->Operands[0]->IsConstant() == false)
+							break;
+
+						bool Condition = false;
+						try
+						{
+							Condition = Current->Operands[0]->Token->AsIValue()->GetBool();
+						}
+						catch (...)
+						{
+							// let the runtime report the type mismatch
+							break;
+						}
+
+						Node::PtrT Taken(std::move(Current->Operands[Condition ? 1 : 2]));
+						Current = std::move(Taken);
+						FoldCount++;
+					}
+
+					break;
+				}
+			}
+
+			bool CodaScriptMUPRPNOptimizer::EvaluateConstant(ICallback* Callback, const Node::ArrayT& Operands, ptr_tok_type& OutResult) const
+			{
+				// evaluate on copies, the callback is free to overwrite its first argument
+				val_vec_type Args;
+				for (auto& Itr : Operands)
+					Args.push_back(ptr_val_type(new CodaScriptMUPValue(*Itr->Token->AsIValue())));
+
+				try
+				{
+					Callback->Eval(Args[0], &Args[0], Args.size());
+				}
+				catch (...)
+				{
+					// errors are raised when the expression is evaluated
+					return false;
+				}
+
+				// arrays are reference types and must be instantiated anew on every evaluation
+				if (Args[0]->IsMatrix())
+					return false;
+
+				CodaScriptMUPValue* Folded = new CodaScriptMUPValue(*Args[0]);
+				Folded->SetExprPos(Callback->GetExprPos());
+				OutResult = ptr_tok_type(Folded);
+				return true;
+			}
+
+			void CodaScriptMUPRPNOptimizer::Emit(const Node* Current, token_vec_type& Out) const
+			{
+				if (Current->Type == Node::NodeType::Ternary)
+				{
+					Emit(Current->Operands[0].get(), Out);
+					Out.push_back(Current->Token);
+					Emit(Current->Operands[1].get(), Out);
+					Out.push_back(Current->Else);
+					Emit(Current->Operands[2].get(), Out);
+					Out.push_back(Current->EndIf);
+				}
+				else
+				{
+					for (auto& Itr : Current->Operands)
+						Emit(Itr.get(), Out);
+
+					Out.push_back(Current->Token);
+				}
+			}
+
+			CodaScriptMUPRPNOptimizer::CodaScriptMUPRPNOptimizer() :
+				FoldCount(0)
+			{
+				;//
+			}
+
+			CodaScriptMUPRPNOptimizer::~CodaScriptMUPRPNOptimizer()
+			{
+				;//
+			}
+
+			bool CodaScriptMUPRPNOptimizer::Optimize(RPN& Code)
+			{
+				Node::ArrayT Statements;
+				if (BuildTree(Code.GetData(), Statements) == false)
+					return false;
+
+				UInt32 FoldsBefore = FoldCount;
+				for (auto& Itr : Statements)
+					Fold(Itr);
+
+				if (FoldCount == FoldsBefore)
+					return false;
+
+				token_vec_type Rewritten;
+				for (auto& Itr : Statements)
+					Emit(Itr.get(), Rewritten);
+
+				Code.Assign(Rewritten);
+				return true;
+			}
+
+			UInt32 CodaScriptMUPRPNOptimizer::GetFoldCount() const
+			{
+				return FoldCount;
+			}
+		}
+	}
+}
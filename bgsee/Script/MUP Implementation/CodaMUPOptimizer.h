@@ -0,0 +1,56 @@
+#pragma once
+#include "mpRPN.h"
+#include "mpIToken.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			// folds constant subexpressions and prunes dead ternary branches in compiled RPN
+			// the token stream is rebuilt into an expression tree, reduced bottom-up and flattened back
+			class CodaScriptMUPRPNOptimizer
+			{
+				struct Node
+				{
+					enum class NodeType
+					{
+						Value,
+						Callback,
+						Index,
+						Ternary,			// Operands = condition, then-branch, else-branch
+						Newline,
+					};
+
+					typedef std::unique_ptr<Node>		PtrT;
+					typedef std::vector<PtrT>			ArrayT;
+
+					NodeType						Type;
+					ptr_tok_type					Token;		// for ternaries, the IF token
+					ptr_tok_type					Else;
+					ptr_tok_type					EndIf;
+					ArrayT							Operands;
+
+					Node(NodeType Type, ptr_tok_type Token) :
+						Type(Type), Token(Token), Else(), EndIf(), Operands() {}
+
+					bool							IsConstant() const;
+				};
+
+				UInt32								FoldCount;
+
+				bool								BuildTree(const token_vec_type& Tokens, Node::ArrayT& OutStatements) const;
+				void								Fold(Node::PtrT& Current);
+				bool								EvaluateConstant(ICallback* Callback, const Node::ArrayT& Operands, ptr_tok_type& OutResult) const;
+				void								Emit(const Node* Current, token_vec_type& Out) const;
+			public:
+				CodaScriptMUPRPNOptimizer();
+				~CodaScriptMUPRPNOptimizer();
+
+				bool								Optimize(RPN& Code);			// returns true if the token stream was rewritten
+				UInt32								GetFoldCount() const;
+			};
+		}
+	}
+}
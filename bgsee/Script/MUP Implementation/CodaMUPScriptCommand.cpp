@@ -3,6 +3,8 @@
 #include "CodaInterpreter.h"
 #include "CodaVM.h"
 #include "CodaUtilities.h"
+#include "CodaMUPValue.h"
+#include "Commands\CodaScriptCommands-General.h"
 
 namespace bgsee
 {
@@ -16,7 +18,8 @@ namespace bgsee
 						Source->GetParameterData(nullptr, nullptr, nullptr)),
 				Parent(Source)
 			{
-				;//
+				// commands are evaluated through the executing agent and can have side effects
+				SetPure(false);
 			}
 
 			CodaScriptMUPScriptCommand::~CodaScriptMUPScriptCommand()
@@ -69,7 +72,11 @@ namespace bgsee
 									CurrentArg->GetType() != ICodaScriptDataStore::kDataType_Invalid);
 						}
 
-						WrappedArgs.push_back(*CurrentArg);
+						// temporaries are discarded once the command returns, so their data is moved instead of copied
+						if (arg[i]->IsVariable())
+							WrappedArgs.push_back(*CurrentArg);
+						else
+							WrappedArgs.push_back(std::move(*CurrentArg));
 					}
 				}
 				else
@@ -138,6 +145,64 @@ namespace bgsee
 			{
 				return new CodaScriptMUPScriptCommand(*this);
 			}
+
+			ICodaScriptCommand* CodaScriptMUPScriptCommand::GetCommand() const
+			{
+				return Parent;
+			}
+
+			CodaScriptMUPTailCallCommand::CodaScriptMUPTailCallCommand(const CodaScriptMUPScriptCommand& Call, const ptr_tok_type& Return) :
+				CodaScriptMUPScriptCommand(Call),
+				Return(Return)
+			{
+				;//
+			}
+
+			CodaScriptMUPTailCallCommand::~CodaScriptMUPTailCallCommand()
+			{
+				;//
+			}
+
+			void CodaScriptMUPTailCallCommand::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				ICodaScriptSyntaxTreeEvaluator* ExecutionAgent = GetParent()->GetCurrentEvaluationAgent();
+				SME_ASSERT(ExecutionAgent);
+
+				ICodaScriptExecutionContext* Context = ExecutionAgent->GetContext();
+				ICodaScriptProgram* Program = ExecutionAgent->GetProgram();
+				const CodaScriptBackingStore* Callee = argc ? arg[0]->GetStore() : nullptr;
+
+				// background scripts can't call themselves, and calls with the wrong number of arguments
+				// need to fail the same way they usually do
+				if (Callee && Callee->GetType() == ICodaScriptDataStore::kDataType_String &&
+					_stricmp(Callee->GetString(), commands::general::kConstant_ScriptSelf.c_str()) == 0 &&
+					Program->GetParameterCount() == argc - 1 &&
+					ExecutionAgent->GetVM()->GetBackgroundDaemon()->IsContextBackgrounding(Context) == false)
+				{
+					CodaScriptBackingStore::NonPtrArrayT Parameters;
+					Parameters.reserve(argc - 1);
+					for (int i = 1; i < argc; i++)
+					{
+						if (arg[i]->IsVariable())
+							Parameters.push_back(*arg[i]->GetStore());
+						else
+							Parameters.push_back(std::move(*arg[i]->GetStore()));
+					}
+
+					Context->TailCall(Parameters);
+					*ret = 0.0;
+					return;
+				}
+
+				ptr_val_type Result(new CodaScriptMUPValue());
+				CodaScriptMUPScriptCommand::Eval(Result, arg, argc);
+				Return->AsICallback()->Eval(ret, &Result, 1);
+			}
+
+			IToken* CodaScriptMUPTailCallCommand::Clone() const
+			{
+				return new CodaScriptMUPTailCallCommand(*this);
+			}
 		}
 	}
 }
\ No newline at end of file
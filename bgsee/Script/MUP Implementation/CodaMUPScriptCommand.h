@@ -20,6 +20,23 @@ namespace bgsee
 				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
 				virtual const char_type*			GetDesc() const;
 				virtual IToken*						Clone() const;
+
+				ICodaScriptCommand*					GetCommand() const;
+			};
+
+			// Return(Call(SELF, ...)), with the call in tail position
+			// instead of recursing, the parameters are handed to the execution context and the executor restarts the program
+			// in the same frame. other calls are evaluated as usual
+			class CodaScriptMUPTailCallCommand : public CodaScriptMUPScriptCommand
+			{
+			protected:
+				ptr_tok_type						Return;
+			public:
+				CodaScriptMUPTailCallCommand(const CodaScriptMUPScriptCommand& Call, const ptr_tok_type& Return);
+				virtual ~CodaScriptMUPTailCallCommand();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual IToken*						Clone() const;
 			};
 		}
 	}
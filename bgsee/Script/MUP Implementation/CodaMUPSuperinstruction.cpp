@@ -0,0 +1,481 @@
+#include "CodaMUPSuperinstruction.h"
+#include "mpIValue.h"
+#include "mpVariable.h"
+#include "mpOprtBinAssign.h"
+#include "CodaMUPValue.h"
+#include "CodaMUPVariable.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			void CodaScriptMUPSuperinstruction::Replay(ptr_val_type& ret) const
+			{
+				val_vec_type Stack;
+				for (auto& Itr : Sequence)
+				{
+					if (Itr->GetCode() == cmVAL)
+					{
+						IValue* Value = Itr->AsIValue();
+						if (Value->IsVariable())
+							Stack.push_back(ptr_val_type(Value));
+						else
+							Stack.push_back(ptr_val_type(new CodaScriptMUPValue(*Value)));
+					}
+					else
+					{
+						ICallback* Callback = Itr->AsICallback();
+						int Argc = Callback->GetArgsPresent();
+						SME_ASSERT(Argc <= static_cast<int>(Stack.size()));
+
+						ptr_val_type Result(new CodaScriptMUPValue());
+						Callback->Eval(Result, Stack.data() + Stack.size() - Argc, Argc);
+
+						Stack.erase(Stack.end() - Argc, Stack.end());
+						Stack.push_back(Result);
+					}
+				}
+
+				SME_ASSERT(Stack.size() == 1);
+				*ret = *Stack.back();
+			}
+
+			CodaScriptMUPSuperinstruction::CodaScriptMUPSuperinstruction(const token_vec_type& Sequence) :
+				ICallback(cmFUNC, Sequence.back()->GetIdent().c_str(), 0),
+				Sequence(Sequence)
+			{
+				SetNumArgsPresent(0);
+				SetExprPos(Sequence.back()->GetExprPos());
+				SetPure(false);
+			}
+
+			CodaScriptMUPSuperinstruction::~CodaScriptMUPSuperinstruction()
+			{
+				;//
+			}
+
+			const char_type* CodaScriptMUPSuperinstruction::GetDesc() const
+			{
+				return _T("superinstruction");
+			}
+
+			CodaScriptMUPIncrementInstruction::CodaScriptMUPIncrementInstruction(const token_vec_type& Sequence, IValue* Target, CodaScriptNumericDataTypeT Delta) :
+				CodaScriptMUPSuperinstruction(Sequence),
+				Target(Target),
+				Delta(Delta)
+			{
+				;//
+			}
+
+			CodaScriptMUPIncrementInstruction::~CodaScriptMUPIncrementInstruction()
+			{
+				;//
+			}
+
+			void CodaScriptMUPIncrementInstruction::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				const CodaScriptBackingStore* Store = Target->GetStore();
+				if (Store->GetType() != ICodaScriptDataStore::kDataType_Numeric)
+				{
+					Replay(ret);
+					return;
+				}
+
+				float_type Result = Store->GetNumber() + Delta;
+				*Target = Result;
+				*ret = Result;
+			}
+
+			IToken* CodaScriptMUPIncrementInstruction::Clone() const
+			{
+				return new CodaScriptMUPIncrementInstruction(*this);
+			}
+
+			CodaScriptMUPCompareConstantInstruction::CodaScriptMUPCompareConstantInstruction(const token_vec_type& Sequence, IValue* Target, IValue* Constant,
+																							 CodaScriptMUPSpecializedOprt::Operation Op) :
+				CodaScriptMUPSuperinstruction(Sequence),
+				Target(Target),
+				Constant(Constant->GetStore()),
+				Op(Op)
+			{
+				;//
+			}
+
+			CodaScriptMUPCompareConstantInstruction::~CodaScriptMUPCompareConstantInstruction()
+			{
+				;//
+			}
+
+			void CodaScriptMUPCompareConstantInstruction::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				const CodaScriptBackingStore* Store = Target->GetStore();
+				if (Store->GetType() != Constant->GetType())
+				{
+					Replay(ret);
+					return;
+				}
+
+				switch (Constant->GetType())
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					CodaScriptMUPSpecializedOprt::EvalNumeric(Op, ret, Store->GetNumber(), Constant->GetNumber());
+					break;
+				case ICodaScriptDataStore::kDataType_String:
+					CodaScriptMUPSpecializedOprt::EvalString(Op, ret, Store, Constant);
+					break;
+				default:
+					Replay(ret);
+				}
+			}
+
+			IToken* CodaScriptMUPCompareConstantInstruction::Clone() const
+			{
+				return new CodaScriptMUPCompareConstantInstruction(*this);
+			}
+
+			CodaScriptMUPAppendConstantInstruction::CodaScriptMUPAppendConstantInstruction(const token_vec_type& Sequence, IValue* Target, IValue* Constant) :
+				CodaScriptMUPSuperinstruction(Sequence),
+				Target(Target),
+				Constant(Constant->GetStore())
+			{
+				;//
+			}
+
+			CodaScriptMUPAppendConstantInstruction::~CodaScriptMUPAppendConstantInstruction()
+			{
+				;//
+			}
+
+			void CodaScriptMUPAppendConstantInstruction::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				CodaScriptMUPValue* Value = static_cast<Variable*>(Target)->GetPtr()->AsValue();
+				if (Value->GetStore()->GetType() != ICodaScriptDataStore::kDataType_String)
+				{
+					Replay(ret);
+					return;
+				}
+
+				Value->AppendString(Constant->GetString(), Constant->GetStringLength());
+
+				// the result is the variable itself, same as a variable load, which saves copying the (growing) string
+				ret.Reset(Target);
+			}
+
+			IToken* CodaScriptMUPAppendConstantInstruction::Clone() const
+			{
+				return new CodaScriptMUPAppendConstantInstruction(*this);
+			}
+
+			CodaScriptMUPAppendAssignOprt::CodaScriptMUPAppendAssignOprt(const ptr_tok_type& Concatenate, const ptr_tok_type& Assign) :
+				IOprtBin(Assign->GetIdent().c_str(), Assign->AsIPrecedence()->GetPri(), Assign->AsIPrecedence()->GetAssociativity()),
+				Concatenate(Concatenate),
+				Assign(Assign)
+			{
+				SetNumArgsPresent(2);
+				SetExprPos(Assign->GetExprPos());
+				SetPure(false);
+			}
+
+			CodaScriptMUPAppendAssignOprt::~CodaScriptMUPAppendAssignOprt()
+			{
+				;//
+			}
+
+			void CodaScriptMUPAppendAssignOprt::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				SME_ASSERT(argc == 2);
+
+				Variable* Target = dynamic_cast<Variable*>(arg[0].Get());
+				const CodaScriptBackingStore* Rhs = arg[1]->GetStore();
+
+				if (Target && Target->GetStore()->GetType() == ICodaScriptDataStore::kDataType_String &&
+					Rhs->GetType() == ICodaScriptDataStore::kDataType_String)
+				{
+					Target->GetPtr()->AsValue()->AppendString(Rhs->GetString(), Rhs->GetStringLength());
+					ret.Reset(Target);
+					return;
+				}
+
+				// evaluate the original operators in sequence
+				ptr_val_type Args[2] = { arg[0], arg[1] };
+				ptr_val_type Concatenated(new CodaScriptMUPValue());
+
+				Concatenate->AsICallback()->Eval(Concatenated, Args, 2);
+				Args[1] = Concatenated;
+				Assign->AsICallback()->Eval(ret, Args, 2);
+			}
+
+			const char_type* CodaScriptMUPAppendAssignOprt::GetDesc() const
+			{
+				return _T("in-place string append");
+			}
+
+			IToken* CodaScriptMUPAppendAssignOprt::Clone() const
+			{
+				return new CodaScriptMUPAppendAssignOprt(*this);
+			}
+
+			IValue* CodaScriptMUPSuperinstructionFuser::GetVariable(const ptr_tok_type& Token)
+			{
+				if (Token->GetCode() != cmVAL)
+					return nullptr;
+
+				IValue* Value = Token->AsIValue();
+				if (Value == nullptr || Value->IsVariable() == false || dynamic_cast<Variable*>(Value) == nullptr)
+					return nullptr;
+
+				return Value;
+			}
+
+			IValue* CodaScriptMUPSuperinstructionFuser::GetConstant(const ptr_tok_type& Token, ICodaScriptDataStore::DataType Type)
+			{
+				if (Token->GetCode() != cmVAL)
+					return nullptr;
+
+				IValue* Value = Token->AsIValue();
+				if (Value == nullptr || Value->IsVariable() || Value->GetStore()->GetType() != Type)
+					return nullptr;
+
+				return Value;
+			}
+
+			bool CodaScriptMUPSuperinstructionFuser::IsSameVariable(const ptr_tok_type& Lhs, const ptr_tok_type& Rhs)
+			{
+				// variable tokens are copied for every reference
+				return GetVariable(Lhs) && GetVariable(Rhs) && Lhs->GetIdent() == Rhs->GetIdent();
+			}
+
+			bool CodaScriptMUPSuperinstructionFuser::GetStackEffect(const ptr_tok_type& Token, int& OutEffect)
+			{
+				switch (Token->GetCode())
+				{
+				case cmVAL:
+					OutEffect = 1;
+					return true;
+				case cmIC:
+					// the index operator consumes the indexed value in addition to its arguments
+					OutEffect = -Token->AsIOprtIndex()->GetArgsPresent();
+					return true;
+				case cmFUNC:
+				case cmOPRT_BIN:
+				case cmOPRT_INFIX:
+				case cmOPRT_POSTFIX:
+					OutEffect = 1 - Token->AsICallback()->GetArgsPresent();
+					return true;
+				default:
+					return false;
+				}
+			}
+
+			ICallback* CodaScriptMUPSuperinstructionFuser::MatchIncrement(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const
+			{
+				typedef CodaScriptMUPSpecializedOprt::Operation Operation;
+
+				IValue* Target = GetVariable(Tokens[Start]);
+				if (Target == nullptr)
+					return nullptr;
+
+				// v c += | v c -=
+				if (Start + 3 <= Tokens.size())
+				{
+					IValue* Constant = GetConstant(Tokens[Start + 1], ICodaScriptDataStore::kDataType_Numeric);
+					IToken* Oprt = Tokens[Start + 2].Get();
+					bool Add = dynamic_cast<OprtAssignAdd*>(Oprt) != nullptr, Sub = dynamic_cast<OprtAssignSub*>(Oprt) != nullptr;
+
+					if (Constant && (Add || Sub))
+					{
+						OutLength = 3;
+						CodaScriptNumericDataTypeT Delta = Constant->GetStore()->GetNumber();
+						return new CodaScriptMUPIncrementInstruction(token_vec_type(Tokens.begin() + Start, Tokens.begin() + Start + OutLength),
+																	 Target, Add ? Delta : -Delta);
+					}
+				}
+
+				// v v c + = | v v c - =
+				if (Start + 5 <= Tokens.size() && IsSameVariable(Tokens[Start], Tokens[Start + 1]))
+				{
+					IValue* Constant = GetConstant(Tokens[Start + 2], ICodaScriptDataStore::kDataType_Numeric);
+					Operation Op;
+
+					if (Constant && CodaScriptMUPSpecializedOprt::GetOperation(Tokens[Start + 3].Get(), Op) &&
+						(Op == Operation::Add || Op == Operation::Subtract) &&
+						dynamic_cast<OprtAssign*>(Tokens[Start + 4].Get()))
+					{
+						OutLength = 5;
+						CodaScriptNumericDataTypeT Delta = Constant->GetStore()->GetNumber();
+						return new CodaScriptMUPIncrementInstruction(token_vec_type(Tokens.begin() + Start, Tokens.begin() + Start + OutLength),
+																	 Target, Op == Operation::Add ? Delta : -Delta);
+					}
+				}
+
+				return nullptr;
+			}
+
+			ICallback* CodaScriptMUPSuperinstructionFuser::MatchAppend(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const
+			{
+				typedef CodaScriptMUPSpecializedOprt::Operation Operation;
+
+				// v v "c" // =
+				if (Start + 5 > Tokens.size() || IsSameVariable(Tokens[Start], Tokens[Start + 1]) == false)
+					return nullptr;
+
+				IValue* Constant = GetConstant(Tokens[Start + 2], ICodaScriptDataStore::kDataType_String);
+				Operation Op;
+
+				if (Constant && CodaScriptMUPSpecializedOprt::GetOperation(Tokens[Start + 3].Get(), Op) &&
+					Op == Operation::Concatenate &&
+					dynamic_cast<OprtAssign*>(Tokens[Start + 4].Get()))
+				{
+					OutLength = 5;
+					return new CodaScriptMUPAppendConstantInstruction(token_vec_type(Tokens.begin() + Start, Tokens.begin() + Start + OutLength),
+																	  GetVariable(Tokens[Start]), Constant);
+				}
+
+				return nullptr;
+			}
+
+			ICallback* CodaScriptMUPSuperinstructionFuser::MatchCompare(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const
+			{
+				typedef CodaScriptMUPSpecializedOprt::Operation Operation;
+
+				// v c <op>
+				if (Start + 3 > Tokens.size())
+					return nullptr;
+
+				IValue* Target = GetVariable(Tokens[Start]);
+				IValue* Constant = GetConstant(Tokens[Start + 1], ICodaScriptDataStore::kDataType_Numeric);
+				if (Constant == nullptr)
+					Constant = GetConstant(Tokens[Start + 1], ICodaScriptDataStore::kDataType_String);
+
+				Operation Op;
+				if (Target == nullptr || Constant == nullptr ||
+					CodaScriptMUPSpecializedOprt::GetOperation(Tokens[Start + 2].Get(), Op) == false || Op < Operation::Equal)
+				{
+					return nullptr;
+				}
+
+				OutLength = 3;
+				return new CodaScriptMUPCompareConstantInstruction(token_vec_type(Tokens.begin() + Start, Tokens.begin() + Start + OutLength),
+																   Target, Constant, Op);
+			}
+
+			CodaScriptMUPSuperinstructionFuser::CodaScriptMUPSuperinstructionFuser() :
+				FusionCount(0)
+			{
+				;//
+			}
+
+			CodaScriptMUPSuperinstructionFuser::~CodaScriptMUPSuperinstructionFuser()
+			{
+				;//
+			}
+
+			UInt32 CodaScriptMUPSuperinstructionFuser::FuseSequences(const token_vec_type& Tokens, token_vec_type& Out) const
+			{
+				UInt32 Fusions = 0;
+
+				Out.reserve(Tokens.size());
+				for (std::size_t i = 0; i < Tokens.size();)
+				{
+					std::size_t Length = 0;
+					ICallback* Fused = MatchIncrement(Tokens, i, Length);
+					if (Fused == nullptr)
+						Fused = MatchAppend(Tokens, i, Length);
+					if (Fused == nullptr)
+						Fused = MatchCompare(Tokens, i, Length);
+
+					if (Fused)
+					{
+						Out.push_back(ptr_tok_type(Fused));
+						Fusions++;
+						i += Length;
+					}
+					else
+						Out.push_back(Tokens[i++]);
+				}
+
+				return Fusions;
+			}
+
+			UInt32 CodaScriptMUPSuperinstructionFuser::FuseAppendAssignments(token_vec_type& Tokens) const
+			{
+				typedef CodaScriptMUPSpecializedOprt::Operation Operation;
+
+				// v v <expression> // = becomes v <expression> <append>
+				// matches are made against the original stream, each one is anchored to a distinct concatenation operator
+				const token_vec_type Original(Tokens);
+				std::vector<bool> Dropped(Tokens.size(), false);
+				UInt32 Fusions = 0;
+
+				for (std::size_t i = 0; i + 4 < Original.size(); i++)
+				{
+					if (Dropped[i] || IsSameVariable(Original[i], Original[i + 1]) == false)
+						continue;
+
+					// find the end of the expression that starts after the second load
+					int Depth = 0;
+					for (std::size_t j = i + 2; j + 2 < Original.size(); j++)
+					{
+						int Effect = 0;
+						if (GetStackEffect(Original[j], Effect) == false)
+							break;
+
+						Depth += Effect;
+						if (Depth < 1)
+							break;
+
+						Operation Op;
+						if (Depth == 1 &&
+							CodaScriptMUPSpecializedOprt::GetOperation(Original[j + 1].Get(), Op) && Op == Operation::Concatenate &&
+							dynamic_cast<OprtAssign*>(Original[j + 2].Get()))
+						{
+							Tokens[j + 1] = ptr_tok_type(new CodaScriptMUPAppendAssignOprt(Original[j + 1], Original[j + 2]));
+							Dropped[i + 1] = Dropped[j + 2] = true;
+							Fusions++;
+							break;
+						}
+					}
+				}
+
+				if (Fusions)
+				{
+					token_vec_type Rewritten;
+					Rewritten.reserve(Tokens.size());
+
+					for (std::size_t i = 0; i < Tokens.size(); i++)
+					{
+						if (Dropped[i] == false)
+							Rewritten.push_back(Tokens[i]);
+					}
+
+					Tokens.swap(Rewritten);
+				}
+
+				return Fusions;
+			}
+
+			bool CodaScriptMUPSuperinstructionFuser::Fuse(RPN& Code)
+			{
+				token_vec_type Rewritten;
+
+				// sequences are fused first, constant appends are cheaper as superinstructions
+				UInt32 Fusions = FuseSequences(Code.GetData(), Rewritten);
+				Fusions += FuseAppendAssignments(Rewritten);
+
+				if (Fusions == 0)
+					return false;
+
+				Code.Assign(Rewritten);
+				FusionCount += Fusions;
+				return true;
+			}
+
+			UInt32 CodaScriptMUPSuperinstructionFuser::GetFusionCount() const
+			{
+				return FusionCount;
+			}
+		}
+	}
+}
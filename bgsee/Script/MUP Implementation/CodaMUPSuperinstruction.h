@@ -0,0 +1,114 @@
+#pragma once
+#include "mpRPN.h"
+#include "mpIToken.h"
+#include "mpICallback.h"
+#include "mpIOprt.h"
+#include "CodaMUPTypeInference.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			// a fused sequence of RPN tokens, evaluated as a single zero-argument callback that pushes the sequence's result
+			// when the operands aren't of the expected types, the original sequence is replayed with the generic operators
+			class CodaScriptMUPSuperinstruction : public ICallback
+			{
+			protected:
+				token_vec_type						Sequence;		// the tokens replaced by this instruction, in RPN order
+
+				void								Replay(ptr_val_type& ret) const;
+			public:
+				CodaScriptMUPSuperinstruction(const token_vec_type& Sequence);
+				virtual ~CodaScriptMUPSuperinstruction();
+
+				virtual const char_type*			GetDesc() const;
+			};
+
+			// v = v + c, v = v - c, v += c, v -= c
+			class CodaScriptMUPIncrementInstruction : public CodaScriptMUPSuperinstruction
+			{
+			protected:
+				IValue*								Target;
+				CodaScriptNumericDataTypeT			Delta;
+			public:
+				CodaScriptMUPIncrementInstruction(const token_vec_type& Sequence, IValue* Target, CodaScriptNumericDataTypeT Delta);
+				virtual ~CodaScriptMUPIncrementInstruction();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual IToken*						Clone() const;
+			};
+
+			// v <op> c, where <op> is a relational operator
+			class CodaScriptMUPCompareConstantInstruction : public CodaScriptMUPSuperinstruction
+			{
+			protected:
+				IValue*									Target;
+				const CodaScriptBackingStore*			Constant;
+				CodaScriptMUPSpecializedOprt::Operation	Op;
+			public:
+				CodaScriptMUPCompareConstantInstruction(const token_vec_type& Sequence, IValue* Target, IValue* Constant,
+														CodaScriptMUPSpecializedOprt::Operation Op);
+				virtual ~CodaScriptMUPCompareConstantInstruction();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual IToken*						Clone() const;
+			};
+
+			// v = v // "c"
+			class CodaScriptMUPAppendConstantInstruction : public CodaScriptMUPSuperinstruction
+			{
+			protected:
+				IValue*								Target;
+				const CodaScriptBackingStore*		Constant;
+			public:
+				CodaScriptMUPAppendConstantInstruction(const token_vec_type& Sequence, IValue* Target, IValue* Constant);
+				virtual ~CodaScriptMUPAppendConstantInstruction();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual IToken*						Clone() const;
+			};
+
+			// v = v // <expression>, with the second load of the variable dropped
+			// appends the expression's value to the variable's string in place instead of copying both into a new string
+			class CodaScriptMUPAppendAssignOprt : public IOprtBin
+			{
+			protected:
+				ptr_tok_type						Concatenate;
+				ptr_tok_type						Assign;
+			public:
+				CodaScriptMUPAppendAssignOprt(const ptr_tok_type& Concatenate, const ptr_tok_type& Assign);
+				virtual ~CodaScriptMUPAppendAssignOprt();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual const char_type*			GetDesc() const;
+				virtual IToken*						Clone() const;
+			};
+
+			// peephole pass that replaces frequent token sequences in compiled RPN with superinstructions
+			class CodaScriptMUPSuperinstructionFuser
+			{
+				UInt32								FusionCount;
+
+				static IValue*						GetVariable(const ptr_tok_type& Token);
+				static IValue*						GetConstant(const ptr_tok_type& Token, ICodaScriptDataStore::DataType Type);
+				static bool							IsSameVariable(const ptr_tok_type& Lhs, const ptr_tok_type& Rhs);
+				static bool							GetStackEffect(const ptr_tok_type& Token, int& OutEffect);		// returns false for control flow tokens
+
+				ICallback*							MatchIncrement(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const;
+				ICallback*							MatchAppend(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const;
+				ICallback*							MatchCompare(const token_vec_type& Tokens, std::size_t Start, std::size_t& OutLength) const;
+
+				UInt32								FuseSequences(const token_vec_type& Tokens, token_vec_type& Out) const;
+				UInt32								FuseAppendAssignments(token_vec_type& Tokens) const;
+			public:
+				CodaScriptMUPSuperinstructionFuser();
+				~CodaScriptMUPSuperinstructionFuser();
+
+				bool								Fuse(RPN& Code);				// returns true if the token stream was rewritten
+				UInt32								GetFusionCount() const;
+			};
+		}
+	}
+}
@@ -0,0 +1,537 @@
+#include "CodaMUPTypeInference.h"
+#include "mpICallback.h"
+#include "mpIValue.h"
+#include "mpError.h"
+#include "mpOprtBinAssign.h"
+#include "mpOprtBinCommon.h"
+#include "mpOprtNonCmplx.h"
+#include "mpFuncCommon.h"
+#include "CodaMUPValue.h"
+#include "CodaMUPScriptCommand.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			void CodaScriptMUPSpecializedOprt::EvalNumeric(Operation Op, ptr_val_type& ret, CodaScriptNumericDataTypeT Lhs, CodaScriptNumericDataTypeT Rhs)
+			{
+				switch (Op)
+				{
+				case Operation::Add:
+					*ret = (float_type)(Lhs + Rhs);
+					break;
+				case Operation::Subtract:
+					*ret = (float_type)(Lhs - Rhs);
+					break;
+				case Operation::Multiply:
+					*ret = (float_type)(Lhs * Rhs);
+					break;
+				case Operation::Divide:
+					*ret = (float_type)(Lhs / Rhs);
+					break;
+				case Operation::Equal:
+					*ret = Lhs == Rhs;
+					break;
+				case Operation::NotEqual:
+					*ret = Lhs != Rhs;
+					break;
+				case Operation::Less:
+					*ret = Lhs < Rhs;
+					break;
+				case Operation::Greater:
+					*ret = Lhs > Rhs;
+					break;
+				case Operation::LessOrEqual:
+					*ret = Lhs <= Rhs;
+					break;
+				case Operation::GreaterOrEqual:
+					*ret = Lhs >= Rhs;
+					break;
+				default:
+					SME_ASSERT(false);
+				}
+			}
+
+			void CodaScriptMUPSpecializedOprt::EvalString(Operation Op, ptr_val_type& ret, const CodaScriptBackingStore* Lhs, const CodaScriptBackingStore* Rhs)
+			{
+				UInt32 LhsLength = Lhs->GetStringLength(), RhsLength = Rhs->GetStringLength();
+
+				if (Op == Operation::Concatenate)
+				{
+					// the result can alias the first operand, so the buffer is built before it's assigned
+					string_type Result;
+					Result.reserve(LhsLength + RhsLength);
+					Result.append(Lhs->GetString(), LhsLength).append(Rhs->GetString(), RhsLength);
+
+					*ret = std::move(Result);
+					return;
+				}
+
+				// same ordering as std::string::compare
+				int Comparison = memcmp(Lhs->GetString(), Rhs->GetString(), min(LhsLength, RhsLength));
+				if (Comparison == 0 && LhsLength != RhsLength)
+					Comparison = LhsLength < RhsLength ? -1 : 1;
+
+				switch (Op)
+				{
+				case Operation::Equal:
+					*ret = Comparison == 0;
+					break;
+				case Operation::NotEqual:
+					*ret = Comparison != 0;
+					break;
+				case Operation::Less:
+					*ret = Comparison < 0;
+					break;
+				case Operation::Greater:
+					*ret = Comparison > 0;
+					break;
+				case Operation::LessOrEqual:
+					*ret = Comparison <= 0;
+					break;
+				case Operation::GreaterOrEqual:
+					*ret = Comparison >= 0;
+					break;
+				default:
+					SME_ASSERT(false);
+				}
+			}
+
+			void CodaScriptMUPSpecializedOprt::EvalReference(Operation Op, ptr_val_type& ret, CodaScriptReferenceDataTypeT Lhs, CodaScriptReferenceDataTypeT Rhs)
+			{
+				switch (Op)
+				{
+				case Operation::Equal:
+					*ret = Lhs == Rhs;
+					break;
+				case Operation::NotEqual:
+					*ret = Lhs != Rhs;
+					break;
+				default:
+					SME_ASSERT(false);
+				}
+			}
+
+			CodaScriptMUPSpecializedOprt::CodaScriptMUPSpecializedOprt(const ptr_tok_type& Generic, Operation Op, ICodaScriptDataStore::DataType OperandType) :
+				IOprtBin(Generic->GetIdent().c_str(), Generic->AsIPrecedence()->GetPri(), Generic->AsIPrecedence()->GetAssociativity()),
+				Op(Op),
+				OperandType(OperandType),
+				Generic(Generic)
+			{
+				SME_ASSERT(Supports(Op, OperandType));
+
+				SetNumArgsPresent(Generic->AsICallback()->GetArgsPresent());
+				SetExprPos(Generic->GetExprPos());
+				SetPure(Generic->AsICallback()->IsPure());
+			}
+
+			CodaScriptMUPSpecializedOprt::~CodaScriptMUPSpecializedOprt()
+			{
+				;//
+			}
+
+			void CodaScriptMUPSpecializedOprt::Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+			{
+				SME_ASSERT(argc == 2);
+
+				const CodaScriptBackingStore* Lhs = arg[0]->GetStore();
+				const CodaScriptBackingStore* Rhs = arg[1]->GetStore();
+
+				if (Lhs->GetType() != OperandType || Rhs->GetType() != OperandType)
+				{
+					Generic->AsICallback()->Eval(ret, arg, argc);
+					return;
+				}
+
+				switch (OperandType)
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					EvalNumeric(Op, ret, Lhs->GetNumber(), Rhs->GetNumber());
+					break;
+				case ICodaScriptDataStore::kDataType_String:
+					EvalString(Op, ret, Lhs, Rhs);
+					break;
+				case ICodaScriptDataStore::kDataType_Reference:
+					EvalReference(Op, ret, Lhs->GetFormID(), Rhs->GetFormID());
+					break;
+				}
+			}
+
+			const char_type* CodaScriptMUPSpecializedOprt::GetDesc() const
+			{
+				return Generic->AsICallback()->GetDesc();
+			}
+
+			IToken* CodaScriptMUPSpecializedOprt::Clone() const
+			{
+				return new CodaScriptMUPSpecializedOprt(*this);
+			}
+
+			CodaScriptMUPSpecializedOprt::Operation CodaScriptMUPSpecializedOprt::GetOperation() const
+			{
+				return Op;
+			}
+
+			bool CodaScriptMUPSpecializedOprt::Supports(Operation Op, ICodaScriptDataStore::DataType OperandType)
+			{
+				switch (OperandType)
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					return Op != Operation::Concatenate;
+				case ICodaScriptDataStore::kDataType_String:
+					return Op == Operation::Concatenate || Op >= Operation::Equal;
+				case ICodaScriptDataStore::kDataType_Reference:
+					return Op == Operation::Equal || Op == Operation::NotEqual;
+				default:
+					return false;
+				}
+			}
+
+			bool CodaScriptMUPSpecializedOprt::GetOperation(IToken* Token, Operation& OutOp)
+			{
+				if (Token->GetCode() != cmOPRT_BIN)
+					return false;
+
+				CodaScriptMUPSpecializedOprt* Specialized = dynamic_cast<CodaScriptMUPSpecializedOprt*>(Token);
+				if (Specialized)
+					OutOp = Specialized->GetOperation();
+				else if (dynamic_cast<OprtAdd*>(Token))
+					OutOp = Operation::Add;
+				else if (dynamic_cast<OprtSub*>(Token))
+					OutOp = Operation::Subtract;
+				else if (dynamic_cast<OprtMul*>(Token))
+					OutOp = Operation::Multiply;
+				else if (dynamic_cast<OprtDiv*>(Token))
+					OutOp = Operation::Divide;
+				else if (dynamic_cast<OprtStrAdd*>(Token))
+					OutOp = Operation::Concatenate;
+				else if (dynamic_cast<OprtEQ*>(Token))
+					OutOp = Operation::Equal;
+				else if (dynamic_cast<OprtNEQ*>(Token))
+					OutOp = Operation::NotEqual;
+				else if (dynamic_cast<OprtLT*>(Token))
+					OutOp = Operation::Less;
+				else if (dynamic_cast<OprtGT*>(Token))
+					OutOp = Operation::Greater;
+				else if (dynamic_cast<OprtLE*>(Token))
+					OutOp = Operation::LessOrEqual;
+				else if (dynamic_cast<OprtGE*>(Token))
+					OutOp = Operation::GreaterOrEqual;
+				else
+					return false;
+
+				return true;
+			}
+
+			CodaScriptMUPTypeInference::InferredType CodaScriptMUPTypeInference::Join(InferredType Lhs, InferredType Rhs)
+			{
+				if (Lhs == InferredType::None)
+					return Rhs;
+				else if (Rhs == InferredType::None || Lhs == Rhs)
+					return Lhs;
+				else
+					return InferredType::Any;
+			}
+
+			CodaScriptMUPTypeInference::InferredType CodaScriptMUPTypeInference::FromDataType(UInt8 Type)
+			{
+				switch (Type)
+				{
+				case ICodaScriptDataStore::kDataType_Numeric:
+					return InferredType::Numeric;
+				case ICodaScriptDataStore::kDataType_String:
+					return InferredType::String;
+				case ICodaScriptDataStore::kDataType_Reference:
+					return InferredType::Reference;
+				case ICodaScriptDataStore::kDataType_Array:
+					return InferredType::Array;
+				default:
+					return InferredType::Any;
+				}
+			}
+
+			ICodaScriptDataStore::DataType CodaScriptMUPTypeInference::ToDataType(InferredType Type)
+			{
+				switch (Type)
+				{
+				case InferredType::Numeric:
+					return ICodaScriptDataStore::kDataType_Numeric;
+				case InferredType::String:
+					return ICodaScriptDataStore::kDataType_String;
+				case InferredType::Reference:
+					return ICodaScriptDataStore::kDataType_Reference;
+				case InferredType::Array:
+					return ICodaScriptDataStore::kDataType_Array;
+				default:
+					return ICodaScriptDataStore::kDataType_Invalid;
+				}
+			}
+
+			CodaScriptMUPTypeInference::InferredType CodaScriptMUPTypeInference::GetVariableType(const IToken* Variable) const
+			{
+				auto Match = Variables.find(Variable->GetIdent());
+				if (Match == Variables.end())
+					return InferredType::Any;
+				else
+					return Match->second;
+			}
+
+			void CodaScriptMUPTypeInference::Assign(const Operand& Variable, InferredType Type)
+			{
+				// assignments to anything but a variable fail at runtime
+				if (Variable.Variable == nullptr)
+					return;
+
+				auto Match = Variables.find(Variable.Variable->GetIdent());
+				if (Match == Variables.end())
+					return;
+
+				InferredType Joined = Join(Match->second, Type);
+				if (Joined != Match->second)
+				{
+					Match->second = Joined;
+					Widened = true;
+				}
+			}
+
+			CodaScriptMUPTypeInference::InferredType CodaScriptMUPTypeInference::GetResultType(ICallback* Callback, const std::vector<Operand>& Operands)
+			{
+				if (dynamic_cast<OprtAssign*>(Callback))
+				{
+					if (Operands.size() != 2)
+						return InferredType::Any;
+
+					Assign(Operands[0], Operands[1].Type);
+					return Operands[1].Type;
+				}
+				else if (dynamic_cast<OprtAssignAdd*>(Callback))
+				{
+					// appends to strings, adds to anything else
+					InferredType Type = InferredType::Any;
+					if (Operands.size() == 2 && (Operands[0].Type == InferredType::None || Operands[1].Type == InferredType::None))
+						Type = InferredType::None;
+					else if (Operands.size() == 2 && Operands[0].Type == Operands[1].Type && Operands[0].Type != InferredType::Any)
+						Type = Operands[0].Type == InferredType::String ? InferredType::String : InferredType::Numeric;
+
+					if (Operands.size())
+						Assign(Operands[0], Type);
+
+					return Type;
+				}
+				else if (dynamic_cast<OprtAssignSub*>(Callback) || dynamic_cast<OprtAssignMul*>(Callback) || dynamic_cast<OprtAssignDiv*>(Callback))
+				{
+					if (Operands.size())
+						Assign(Operands[0], InferredType::Numeric);
+
+					return InferredType::Numeric;
+				}
+				else if (dynamic_cast<OprtAdd*>(Callback) || dynamic_cast<OprtSub*>(Callback) ||
+						 dynamic_cast<OprtMul*>(Callback) || dynamic_cast<OprtDiv*>(Callback) ||
+						 dynamic_cast<OprtPow*>(Callback) || dynamic_cast<OprtSign*>(Callback) ||
+						 dynamic_cast<OprtEQ*>(Callback) || dynamic_cast<OprtNEQ*>(Callback) ||
+						 dynamic_cast<OprtLT*>(Callback) || dynamic_cast<OprtGT*>(Callback) ||
+						 dynamic_cast<OprtLE*>(Callback) || dynamic_cast<OprtGE*>(Callback) ||
+						 dynamic_cast<OprtLAnd*>(Callback) || dynamic_cast<OprtLOr*>(Callback) ||
+						 dynamic_cast<OprtAnd*>(Callback) || dynamic_cast<OprtOr*>(Callback) ||
+						 dynamic_cast<OprtShl*>(Callback) || dynamic_cast<OprtShr*>(Callback) ||
+						 dynamic_cast<OprtCastToNum*>(Callback) || dynamic_cast<OprtTypeID*>(Callback))
+				{
+					return InferredType::Numeric;
+				}
+				else if (dynamic_cast<OprtStrAdd*>(Callback) || dynamic_cast<OprtCastToStr*>(Callback) || dynamic_cast<FunParserID*>(Callback))
+					return InferredType::String;
+				else if (dynamic_cast<OprtCastToRef*>(Callback))
+					return InferredType::Reference;
+				else if (dynamic_cast<OprtCastToArray*>(Callback))
+					return InferredType::Array;
+				else if (dynamic_cast<CodaScriptMUPScriptCommand*>(Callback))
+				{
+					UInt8 ResultType = ICodaScriptDataStore::kDataType_Invalid;
+					static_cast<CodaScriptMUPScriptCommand*>(Callback)->GetCommand()->GetParameterData(nullptr, nullptr, &ResultType);
+
+					// kType_Multi maps to Any
+					return FromDataType(ResultType);
+				}
+
+				return InferredType::Any;
+			}
+
+			ptr_tok_type CodaScriptMUPTypeInference::Specialize(const ptr_tok_type& Token, const std::vector<Operand>& Operands) const
+			{
+				typedef CodaScriptMUPSpecializedOprt::Operation Operation;
+
+				if (Operands.size() != 2 || Operands[0].Type != Operands[1].Type || dynamic_cast<CodaScriptMUPSpecializedOprt*>(Token.Get()))
+					return Token;
+
+				Operation Op;
+				if (CodaScriptMUPSpecializedOprt::GetOperation(Token.Get(), Op) == false)
+					return Token;
+
+				ICodaScriptDataStore::DataType OperandType = ToDataType(Operands[0].Type);
+				if (CodaScriptMUPSpecializedOprt::Supports(Op, OperandType) == false)
+					return Token;
+
+				return ptr_tok_type(new CodaScriptMUPSpecializedOprt(Token, Op, OperandType));
+			}
+
+			bool CodaScriptMUPTypeInference::Walk(RPN& Code, bool Rewrite)
+			{
+				struct PendingTernary
+				{
+					std::size_t		Depth;			// operand stack depth at the IF token
+					InferredType	Then;
+				};
+
+				token_vec_type Tokens(Code.GetData());
+				std::vector<Operand> Stack, Arguments;
+				std::vector<PendingTernary> Ternaries;
+				UInt32 Specializations = 0;
+
+				for (auto& Itr : Tokens)
+				{
+					switch (Itr->GetCode())
+					{
+					case cmSCRIPT_NEWLINE:
+						Stack.clear();
+						break;
+					case cmVAL:
+						{
+							const IValue* Value = Itr->AsIValue();
+							if (Value == nullptr)
+								return false;
+
+							if (Value->IsVariable())
+								Stack.push_back(Operand(GetVariableType(Itr.Get()), Itr.Get()));
+							else
+								Stack.push_back(Operand(FromDataType(Value->GetStore()->GetType())));
+						}
+
+						break;
+					case cmIC:
+						{
+							// the index operator consumes the indexed value in addition to its arguments
+							IOprtIndex* Index = Itr->AsIOprtIndex();
+							if (Index == nullptr || Index->GetArgsPresent() + 1 > static_cast<int>(Stack.size()))
+								return false;
+
+							Stack.erase(Stack.end() - (Index->GetArgsPresent() + 1), Stack.end());
+							Stack.push_back(Operand(InferredType::Any));
+						}
+
+						break;
+					case cmFUNC:
+					case cmOPRT_BIN:
+					case cmOPRT_INFIX:
+					case cmOPRT_POSTFIX:
+						{
+							ICallback* Callback = Itr->AsICallback();
+							if (Callback == nullptr || Callback->GetArgsPresent() > static_cast<int>(Stack.size()))
+								return false;
+
+							Arguments.assign(Stack.end() - Callback->GetArgsPresent(), Stack.end());
+							Stack.erase(Stack.end() - Callback->GetArgsPresent(), Stack.end());
+							Stack.push_back(Operand(GetResultType(Callback, Arguments)));
+
+							if (Rewrite)
+							{
+								ptr_tok_type Specialized(Specialize(Itr, Arguments));
+								if (Specialized.Get() != Itr.Get())
+								{
+									Itr = Specialized;
+									Specializations++;
+								}
+							}
+						}
+
+						break;
+					case cmIF:
+						if (Stack.empty())
+							return false;
+
+						Stack.pop_back();
+						Ternaries.push_back(PendingTernary{ Stack.size(), InferredType::None });
+
+						break;
+					case cmELSE:
+						if (Ternaries.empty() || Stack.size() != Ternaries.back().Depth + 1)
+							return false;
+
+						Ternaries.back().Then = Stack.back().Type;
+						Stack.pop_back();
+
+						break;
+					case cmENDIF:
+						if (Ternaries.empty() || Stack.size() != Ternaries.back().Depth + 1)
+							return false;
+
+						Stack.back() = Operand(Join(Ternaries.back().Then, Stack.back().Type));
+						Ternaries.pop_back();
+
+						break;
+					default:
+						return false;
+					}
+				}
+
+				if (Specializations)
+				{
+					Code.Assign(Tokens);
+					SpecializationCount += Specializations;
+				}
+
+				return true;
+			}
+
+			CodaScriptMUPTypeInference::CodaScriptMUPTypeInference() :
+				Variables(),
+				Widened(false),
+				SpecializationCount(0)
+			{
+				;//
+			}
+
+			CodaScriptMUPTypeInference::~CodaScriptMUPTypeInference()
+			{
+				;//
+			}
+
+			void CodaScriptMUPTypeInference::RegisterVariable(const string_type& Name)
+			{
+				Variables[Name] = InferredType::None;
+			}
+
+			bool CodaScriptMUPTypeInference::Analyze(RPN& Code)
+			{
+				Widened = false;
+
+				// a stream that can't be walked could assign anything to any variable
+				if (Walk(Code, false) == false)
+				{
+					for (auto& Itr : Variables)
+					{
+						if (Itr.second != InferredType::Any)
+						{
+							Itr.second = InferredType::Any;
+							Widened = true;
+						}
+					}
+				}
+
+				return Widened;
+			}
+
+			bool CodaScriptMUPTypeInference::Specialize(RPN& Code)
+			{
+				UInt32 Count = SpecializationCount;
+				return Walk(Code, true) && SpecializationCount != Count;
+			}
+
+			UInt32 CodaScriptMUPTypeInference::GetSpecializationCount() const
+			{
+				return SpecializationCount;
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "mpRPN.h"
+#include "mpIToken.h"
+#include "mpIOprt.h"
+#include "CodaDataTypes.h"
+
+namespace bgsee
+{
+	namespace script
+	{
+		namespace mup
+		{
+			// a binary operator specialized for operands of a single data type, bypassing the generic operator's type dispatch
+			// the operands' type tags are still compared as variables start out unassigned and commands return zero when they fail,
+			// in which case the generic operator is evaluated instead
+			class CodaScriptMUPSpecializedOprt : public IOprtBin
+			{
+			public:
+				enum class Operation : UInt8
+				{
+					Add,
+					Subtract,
+					Multiply,
+					Divide,
+					Concatenate,
+					Equal,
+					NotEqual,
+					Less,
+					Greater,
+					LessOrEqual,
+					GreaterOrEqual,
+				};
+			protected:
+				Operation							Op;
+				ICodaScriptDataStore::DataType		OperandType;
+				ptr_tok_type						Generic;
+			public:
+				CodaScriptMUPSpecializedOprt(const ptr_tok_type& Generic, Operation Op, ICodaScriptDataStore::DataType OperandType);
+				virtual ~CodaScriptMUPSpecializedOprt();
+
+				virtual void						Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc);
+				virtual const char_type*			GetDesc() const;
+				virtual IToken*						Clone() const;
+
+				Operation							GetOperation() const;
+
+				static bool							Supports(Operation Op, ICodaScriptDataStore::DataType OperandType);
+				static bool							GetOperation(IToken* Token, Operation& OutOp);		// accepts both generic and specialized operators
+
+				static void							EvalNumeric(Operation Op, ptr_val_type& ret, CodaScriptNumericDataTypeT Lhs, CodaScriptNumericDataTypeT Rhs);
+				static void							EvalString(Operation Op, ptr_val_type& ret, const CodaScriptBackingStore* Lhs, const CodaScriptBackingStore* Rhs);
+				static void							EvalReference(Operation Op, ptr_val_type& ret, CodaScriptReferenceDataTypeT Lhs, CodaScriptReferenceDataTypeT Rhs);
+			};
+
+			// flow-insensitive type inference over a program's compiled RPN
+			// local variables are typed with the union of the types of every value assigned to them, expressions with the types
+			// of their literals, casts, operators and the declared result types of script commands. binary operators whose
+			// operand types are proven to match are then swapped for their specialized counterparts
+			class CodaScriptMUPTypeInference
+			{
+			public:
+				enum class InferredType : UInt8
+				{
+					None,				// nothing assigned (yet)
+					Numeric,
+					String,
+					Reference,
+					Array,
+					Any,
+				};
+			protected:
+				struct Operand
+				{
+					InferredType		Type;
+					const IToken*		Variable;		// set when the operand is a direct variable load
+
+					Operand(InferredType Type, const IToken* Variable = nullptr) : Type(Type), Variable(Variable) {}
+				};
+
+				typedef std::unordered_map<string_type, InferredType>		VariableTypeMapT;		// key = variable name, the parser hands out a copy of the variable token for every reference
+
+				VariableTypeMapT					Variables;
+				bool								Widened;
+				UInt32								SpecializationCount;
+
+				static InferredType					Join(InferredType Lhs, InferredType Rhs);
+				static InferredType					FromDataType(UInt8 Type);
+				static ICodaScriptDataStore::DataType	ToDataType(InferredType Type);
+
+				InferredType						GetVariableType(const IToken* Variable) const;
+				void								Assign(const Operand& Variable, InferredType Type);
+				InferredType						GetResultType(ICallback* Callback, const std::vector<Operand>& Operands);
+				ptr_tok_type						Specialize(const ptr_tok_type& Token, const std::vector<Operand>& Operands) const;
+				bool								Walk(RPN& Code, bool Rewrite);			// returns false if the token stream couldn't be parsed
+			public:
+				CodaScriptMUPTypeInference();
+				~CodaScriptMUPTypeInference();
+
+				void								RegisterVariable(const string_type& Name);			// variables not registered are treated as untyped
+
+				bool								Analyze(RPN& Code);					// returns true if a variable's type was widened
+				bool								Specialize(RPN& Code);				// returns true if the token stream was rewritten
+
+				UInt32								GetSpecializationCount() const;
+			};
+		}
+	}
+}
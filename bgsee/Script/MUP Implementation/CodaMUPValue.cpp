@@ -9,7 +9,7 @@ namespace bgsee
 	{
 		namespace mup
 		{
-			int			CodaScriptMUPValue::GIC = 0;
+			std::atomic<int>			CodaScriptMUPValue::GIC(0);
 
 			CodaScriptMUPValue::CodaScriptMUPValue(char_type cType) :
 				ICodaScriptDataStoreOwner(),
@@ -112,7 +112,7 @@ namespace bgsee
 				if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_String)
 				{
 					m_cType = 's';
-					m_StringBuffer = val->GetString();
+					m_StringBuffer.assign(val->GetString(), val->GetStringLength());
 				}
 				else if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_Numeric)
 					m_cType = 'f';
@@ -132,7 +132,7 @@ namespace bgsee
 				if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_String)
 				{
 					m_cType = 's';
-					m_StringBuffer = val.GetString();
+					m_StringBuffer.assign(val.GetString(), val.GetStringLength());
 				}
 				else if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_Numeric)
 					m_cType = 'f';
@@ -178,17 +178,10 @@ namespace bgsee
 			{
 				if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_Array)
 				{
-					if (nRow >= m_DataStore.GetArray()->Size())
-						throw ParserError( ErrorContext(ecINDEX_OUT_OF_BOUNDS, -1, GetIdent()) );
-
-					CodaScriptMUPArrayDataType* Array = dynamic_cast<CodaScriptMUPArrayDataType*>(m_DataStore.GetArray().get());
-					SME_ASSERT(Array);
-
-					CodaScriptMUPValue* Out = nullptr;
-					Array->At(nRow, &Out);
-					SME_ASSERT(Out);
-
-					return *Out;
+					// array elements aren't addressable, OprtIndex wraps them in a CodaScriptMUPArrayElement instead
+					ErrorContext errc(ecTYPE_CONFLICT_IDX, GetExprPos());
+					errc.Hint = _T("Array elements can only be accessed through the index operator.");
+					throw ParserError(errc);
 				}
 				else if (nRow==0 && nCol==0)
 				{
@@ -235,7 +228,7 @@ namespace bgsee
 
 			IValue& CodaScriptMUPValue::operator=( string_type a_sVal )
 			{
-				m_DataStore.SetString(a_sVal.c_str());
+				m_DataStore.SetString(a_sVal.c_str(), a_sVal.length());
 				m_StringBuffer = a_sVal;
 
 				m_cType = 's';
@@ -272,7 +265,7 @@ namespace bgsee
 			IValue& CodaScriptMUPValue::operator=( const char_type *a_szVal )
 			{
 				m_DataStore.SetString(a_szVal);
-				m_StringBuffer = a_szVal;
+				m_StringBuffer.assign(m_DataStore.GetString(), m_DataStore.GetStringLength());
 
 				m_cType = 's';
 				m_iFlags = flNONE;
@@ -286,7 +279,7 @@ namespace bgsee
 				m_cType = GetMUPType(m_DataStore.GetType());
 
 				if (m_cType == 's')
-					m_StringBuffer = m_DataStore.GetString();
+					m_StringBuffer.assign(m_DataStore.GetString(), m_DataStore.GetStringLength());
 
 				return *this;
 			}
@@ -298,6 +291,8 @@ namespace bgsee
 
 				if (m_DataStore.GetType() == Param->GetType() && m_DataStore.GetType() == ICodaScriptDataStore::kDataType_Numeric)
 					m_DataStore += *Param;
+				else if (m_DataStore.GetType() == Param->GetType() && m_DataStore.GetType() == ICodaScriptDataStore::kDataType_String)
+					AppendString(Param->GetString(), Param->GetStringLength());
 				else
 				{
 					// Type conflict
@@ -344,6 +339,15 @@ namespace bgsee
 				m_pCache = pCache;
 			}
 
+			void CodaScriptMUPValue::AppendString(const char_type* Data, UInt32 Length)
+			{
+				SME_ASSERT(m_cType == 's' && m_DataStore.GetType() == ICodaScriptDataStore::kDataType_String);
+
+				// the string buffer is updated first as the source can be a part of the data store's buffer
+				m_StringBuffer.append(Data, Length);
+				m_DataStore.AppendString(Data, Length);
+			}
+
 			CodaScriptBackingStore* CodaScriptMUPValue::GetStore( void ) const
 			{
 				return &m_DataStore;
@@ -416,7 +420,7 @@ namespace bgsee
 				if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_String)
 				{
 					m_cType = 's';
-					m_StringBuffer = a_Val.GetString();
+					m_StringBuffer.assign(a_Val.GetString(), a_Val.GetStringLength());
 				}
 				else if (m_DataStore.GetType() == ICodaScriptDataStore::kDataType_Numeric)
 					m_cType = 'f';
@@ -560,6 +564,111 @@ namespace bgsee
 			{
 				return GetBool();
 			}
+
+			CodaScriptMUPArrayElement::CodaScriptMUPArrayElement( ICodaScriptArrayDataType::SharedPtrT Array, UInt32 Index ) :
+				Variable(nullptr),
+				Array(Array),
+				Index(Index),
+				Snapshot()
+			{
+				if (Array->At(Index, Snapshot) == false)
+					throw ParserError(ErrorContext(ecINDEX_OUT_OF_BOUNDS, -1, GetIdent()));
+
+				Bind(&Snapshot);
+			}
+
+			CodaScriptMUPArrayElement::CodaScriptMUPArrayElement( const CodaScriptMUPArrayElement& rhs ) :
+				Variable(nullptr),
+				Array(rhs.Array),
+				Index(rhs.Index),
+				Snapshot(rhs.Snapshot)
+			{
+				Bind(&Snapshot);
+			}
+
+			CodaScriptMUPArrayElement::~CodaScriptMUPArrayElement()
+			{
+				Array.reset();
+			}
+
+			IValue& CodaScriptMUPArrayElement::WriteBack()
+			{
+				if (Array->Insert(Snapshot.GetStore(), Index, true) == false)
+					throw ParserError(ErrorContext(ecINDEX_OUT_OF_BOUNDS, -1, GetIdent()));
+
+				return *this;
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( const IValue &ref )
+			{
+				Variable::operator=(ref);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( const CodaScriptMUPValue &val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( const matrix_type &val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( const cmplx_type &val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( int_type val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( float_type val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( string_type val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator=( bool_type val )
+			{
+				Variable::operator=(val);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator+=( const IValue &ref )
+			{
+				Variable::operator+=(ref);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator-=( const IValue &ref )
+			{
+				Variable::operator-=(ref);
+				return WriteBack();
+			}
+
+			IValue& CodaScriptMUPArrayElement::operator*=( const IValue &val )
+			{
+				Variable::operator*=(val);
+				return WriteBack();
+			}
+
+			IToken* CodaScriptMUPArrayElement::Clone() const
+			{
+				return new CodaScriptMUPArrayElement(*this);
+			}
 		}
 	}
 }
\ No newline at end of file
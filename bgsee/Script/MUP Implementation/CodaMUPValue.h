@@ -2,6 +2,7 @@
 
 #include "mpIValue.h"
 #include "mpTypes.h"
+#include "mpVariable.h"
 #include "CodaDataTypes.h"
 
 namespace bgsee
@@ -13,7 +14,7 @@ namespace bgsee
 			// a wrapper for CodaScriptBackingStore
 			class CodaScriptMUPValue : public ICodaScriptDataStoreOwner, public IValue
 			{
-				static int									GIC;
+				static std::atomic<int>						GIC;
 			protected:
 				char_type									m_cType;				///< A byte indicating the type of the represented value
 				EFlags										m_iFlags;				///< Additional flags
@@ -75,12 +76,13 @@ namespace bgsee
 				virtual string_type							AsciiDump() const;
 				virtual CodaScriptBackingStore*				GetStore(void) const;
 				void										BindToCache(ValueCache *pCache);
+				void										AppendString(const char_type* Data, UInt32 Length);		// in-place, the value must be a string
 
 				virtual ICodaScriptDataStore*				GetDataStore();
 				virtual ICodaScriptDataStoreOwner&			operator=(const ICodaScriptDataStore& rhs);
 				virtual void								SetIdentifier(const char* Identifier);
 
-				static const int&							GetGIC() { return GIC; }
+				static int									GetGIC() { return GIC; }
 
 				// Conversion operators
 				operator int ();
@@ -88,6 +90,35 @@ namespace bgsee
 				operator float_type();
 				operator bool();
 			};
+
+			// returned by the index operator for array elements that are assigned to, elements that are only read are copied into a value instead
+			// reads are served from a copy of the element, assignments are written back through Insert() so that only writes unpack/detach the store
+			class CodaScriptMUPArrayElement : public Variable
+			{
+				ICodaScriptArrayDataType::SharedPtrT					Array;
+				UInt32													Index;
+				CodaScriptMUPValue										Snapshot;
+
+				IValue&													WriteBack();
+			public:
+				CodaScriptMUPArrayElement(ICodaScriptArrayDataType::SharedPtrT Array, UInt32 Index);
+				CodaScriptMUPArrayElement(const CodaScriptMUPArrayElement& rhs);
+				virtual ~CodaScriptMUPArrayElement();
+
+				virtual IValue&											operator=(const IValue &ref);
+				virtual IValue&											operator=(const CodaScriptMUPValue &val);
+				virtual IValue&											operator=(const matrix_type &val);
+				virtual IValue&											operator=(const cmplx_type &val);
+				virtual IValue&											operator=(int_type val);
+				virtual IValue&											operator=(float_type val);
+				virtual IValue&											operator=(string_type val);
+				virtual IValue&											operator=(bool_type val);
+				virtual IValue&											operator+=(const IValue &ref);
+				virtual IValue&											operator-=(const IValue &ref);
+				virtual IValue&											operator*=(const IValue &val);
+
+				virtual IToken*											Clone() const;
+			};
 		}
 	}
 }
\ No newline at end of file
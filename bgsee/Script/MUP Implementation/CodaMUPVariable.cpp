@@ -11,14 +11,33 @@ namespace bgsee
 		namespace mup
 		{
 
-			int CodaScriptMUPVariable::GIC = 0;
+			std::atomic<int> CodaScriptMUPVariable::GIC(0);
+			thread_local const CodaScriptMUPVariable::BindingFrame* CodaScriptMUPVariable::ActiveBindings = nullptr;
 
 			CodaScriptMUPValue* CodaScriptMUPVariable::GetCurrentValue() const
 			{
-				if (BoundValues.size() == 0)
+				// evaluations activate their own frame and compilations suspend the active one,
+				// so the active frame, if any, always belongs to the wrapper's program
+				const BindingFrame* Frame = ActiveBindings;
+				if (Frame == nullptr)
 					return nullptr;
+
+#ifdef _DEBUG
+				SME_ASSERT(Frame->Owner == Owner);
+#endif // _DEBUG
+
+				const BindingFrame::ValueArrayT& Source = Global ? Frame->Globals : Frame->Locals;
+				if (Slot < Source.size())
+					return Source[Slot];
 				else
-					return BoundValues.top();
+					return nullptr;
+			}
+
+			CodaScriptMUPValue* CodaScriptMUPVariable::GetBoundValue() const
+			{
+				CodaScriptMUPValue* Out = GetCurrentValue();
+				SME_ASSERT(Out);
+				return Out;
 			}
 
 			//-----------------------------------------------------------------------------------------------
@@ -29,9 +48,9 @@ namespace bgsee
 			  Such variable objects must be bound later in order to be of any use. The parser
 			  does NOT assume ownership over the pointer!
 			*/
-			CodaScriptMUPVariable::CodaScriptMUPVariable(const CodaScriptSourceCodeT& Name, bool RestrictedAssignment)
+			CodaScriptMUPVariable::CodaScriptMUPVariable(const CodaScriptSourceCodeT& Name, const void* Owner, bool Global, UInt32 Slot)
 				:IValue(cmVAL)
-				, Name(Name), BoundValues(), CurrentValue(nullptr), RestrictedAssignment(RestrictedAssignment)
+				, Name(Name), Owner(Owner), Global(Global), Slot(Slot), RestrictedAssignment(Global)
 			{
 				AddFlags(IToken::flVOLATILE);
 				GIC++;
@@ -40,8 +59,9 @@ namespace bgsee
 			CodaScriptMUPVariable::CodaScriptMUPVariable(const CodaScriptMUPVariable &obj)
 				:IValue(cmVAL),
 				Name(obj.Name),
-				BoundValues(obj.BoundValues),
-				CurrentValue(obj.CurrentValue),
+				Owner(obj.Owner),
+				Global(obj.Global),
+				Slot(obj.Slot),
 				RestrictedAssignment(obj.RestrictedAssignment)
 			{
 				AddFlags(IToken::flVOLATILE);
@@ -59,7 +79,7 @@ namespace bgsee
 
 			IValue& CodaScriptMUPVariable::operator=(const IValue &ref)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				ICodaScriptDataStore* Store = const_cast<IValue&>(ref).GetStore();
 				if (RestrictedAssignment && (Store->IsArray() || Store->IsReference()))
 				{
@@ -75,7 +95,7 @@ namespace bgsee
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(int_type val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				if (RestrictedAssignment)
 				{
 					char Buffer[0x100] = { 0 };
@@ -90,70 +110,70 @@ namespace bgsee
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(float_type val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(string_type val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(bool_type val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(const matrix_type &val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator=(const cmplx_type &val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator+=(const IValue &val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator+=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator-=(const IValue &val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator-=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::operator*=(const IValue &val)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->operator*=(val);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::At(int nRow, int nCol)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->At(nRow, nCol);
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			IValue& CodaScriptMUPVariable::At(const IValue &row, const IValue &col)
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				try
 				{
 					return CurrentValue->At(row, col);
@@ -178,69 +198,70 @@ namespace bgsee
 			*/
 			char_type CodaScriptMUPVariable::GetType() const
 			{
+				CodaScriptMUPValue* CurrentValue = GetCurrentValue();
 				return (CurrentValue) ? CurrentValue->GetType() : 'v';
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			int_type CodaScriptMUPVariable::GetInteger() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetInteger();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			float_type CodaScriptMUPVariable::GetFloat() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetFloat();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			float_type CodaScriptMUPVariable::GetImag() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetImag();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			const cmplx_type& CodaScriptMUPVariable::GetComplex() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetComplex();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			const string_type& CodaScriptMUPVariable::GetString() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetString();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			bool CodaScriptMUPVariable::GetBool() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetBool();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			const matrix_type& CodaScriptMUPVariable::GetArray() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetArray();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			int CodaScriptMUPVariable::GetRows() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetRows();
 			}
 
 			//-----------------------------------------------------------------------------------------------
 			int CodaScriptMUPVariable::GetCols() const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetCols();
 			}
 
@@ -259,13 +280,12 @@ namespace bgsee
 			//-----------------------------------------------------------------------------------------------
 			CodaScriptMUPValue* CodaScriptMUPVariable::AsValue()
 			{
-				SME_ASSERT(IsBound());
-				return CurrentValue;
+				return GetBoundValue();
 			}
 
 			CodaScriptBackingStore* CodaScriptMUPVariable::GetStore(void) const
 			{
-				SME_ASSERT(CurrentValue);
+				CodaScriptMUPValue* CurrentValue = GetBoundValue();
 				return CurrentValue->GetStore();
 			}
 
@@ -274,31 +294,43 @@ namespace bgsee
 				return Name;
 			}
 
-			void CodaScriptMUPVariable::Bind(const CodaScriptVariable* Var)
+			bool CodaScriptMUPVariable::IsGlobal() const
+			{
+				return Global;
+			}
+
+			UInt32 CodaScriptMUPVariable::GetSlot() const
+			{
+				return Slot;
+			}
+
+			bool CodaScriptMUPVariable::IsBound() const
+			{
+				return GetCurrentValue() != nullptr;
+			}
+
+			CodaScriptMUPValue* CodaScriptMUPVariable::Resolve(const CodaScriptVariable* Var) const
 			{
 #ifdef _DEBUG
 				bool NameMismatch = _stricmp(Var->GetName(), Name.c_str());
 				SME_ASSERT(NameMismatch == false);
 #endif // _DEBUG
 
-				CodaScriptMUPValue* NewVal = dynamic_cast<CodaScriptMUPValue*>(Var->GetStoreOwner());
-				SME_ASSERT(NewVal);
-
-				BoundValues.push(NewVal);
-				CurrentValue = GetCurrentValue();
+				CodaScriptMUPValue* Out = dynamic_cast<CodaScriptMUPValue*>(Var->GetStoreOwner());
+				SME_ASSERT(Out);
+				return Out;
 			}
 
-			void CodaScriptMUPVariable::Unbind()
+			const CodaScriptMUPVariable::BindingFrame* CodaScriptMUPVariable::SetActiveBindings(const BindingFrame* Frame)
 			{
-				SME_ASSERT(BoundValues.empty() == false);
-
-				BoundValues.pop();
-				CurrentValue = GetCurrentValue();
+				const BindingFrame* Previous = ActiveBindings;
+				ActiveBindings = Frame;
+				return Previous;
 			}
 
-			bool CodaScriptMUPVariable::IsBound() const
+			const CodaScriptMUPVariable::BindingFrame* CodaScriptMUPVariable::GetActiveBindings()
 			{
-				return CurrentValue != nullptr;
+				return ActiveBindings;
 			}
 
 		}
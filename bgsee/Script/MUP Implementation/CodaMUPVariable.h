@@ -12,20 +12,39 @@ namespace bgsee
 		{
 			// a second level of indirection b'ween a regular MUP Variable and a CodaScriptVariable
 			// allows the rebinding of variables after the bytecode has been generated
+			// the wrapper itself is stateless - its value is looked up by slot in the binding frame that's active on the calling thread,
+			// which lets multiple threads evaluate the same bytecode with different bindings
+			// only the frame of the program being evaluated is ever active, so the lookup doesn't need to search for it
 			class CodaScriptMUPVariable : public IValue
 			{
-				static int					GIC;
-			protected:
-				typedef std::stack<CodaScriptMUPValue*>			ValueStackT;
+			public:
+				// the values bound to a program's wrappers by an execution context
+				struct BindingFrame
+				{
+					typedef std::vector<CodaScriptMUPValue*>	ValueArrayT;		// index = wrapper slot
+
+					const void*					Owner;			// program whose wrappers the frame binds
+					ValueArrayT					Locals;
+					ValueArrayT					Globals;
+					const BindingFrame*			Previous;		// frame that was active when this one was, restored when the evaluation ends
 
+					BindingFrame() : Owner(nullptr), Locals(), Globals(), Previous(nullptr) {}
+				};
+			private:
+				static std::atomic<int>		GIC;
+
+				static thread_local const BindingFrame*		ActiveBindings;
+			protected:
 				CodaScriptSourceCodeT		Name;
-				ValueStackT					BoundValues;
-				CodaScriptMUPValue*			CurrentValue;					// the value on the top of the stack, if any
+				const void*					Owner;
+				bool						Global;
+				UInt32						Slot;							// index into the binding frame's locals or globals
 				bool						RestrictedAssignment;			// when true, references and arrays can't be assigned to this variable
 
-				CodaScriptMUPValue*			GetCurrentValue() const;
+				CodaScriptMUPValue*			GetCurrentValue() const;		// returns nullptr if the wrapper isn't bound on the calling thread
+				CodaScriptMUPValue*			GetBoundValue() const;
 			public:
-				CodaScriptMUPVariable(const CodaScriptSourceCodeT& Name, bool RestrictedAssignment);
+				CodaScriptMUPVariable(const CodaScriptSourceCodeT& Name, const void* Owner, bool Global, UInt32 Slot);		// globals have restricted assignment
 				CodaScriptMUPVariable(const CodaScriptMUPVariable &a_Var);
 				virtual ~CodaScriptMUPVariable();
 
@@ -64,11 +83,15 @@ namespace bgsee
 				virtual CodaScriptBackingStore*		GetStore(void) const;
 
 				const CodaScriptSourceCodeT&		GetName() const;
-				void								Bind(const CodaScriptVariable* Var);
-				void								Unbind();
+				bool								IsGlobal() const;
+				UInt32								GetSlot() const;
 				bool								IsBound() const;
+				CodaScriptMUPValue*					Resolve(const CodaScriptVariable* Var) const;		// returns the value that binds the variable to this wrapper
+
+				static const BindingFrame*			SetActiveBindings(const BindingFrame* Frame);		// returns the previously active frame, pass nullptr to suspend the bindings
+				static const BindingFrame*			GetActiveBindings();
 
-				static const int&					GetGIC() { return GIC; }
+				static int							GetGIC() { return GIC; }
 
 				typedef std::unique_ptr<CodaScriptMUPVariable>				PtrT;
 			};
@@ -39,6 +39,7 @@
 #include <intrin.h>
 #include <errno.h>
 #include <crtdefs.h>
+#include <crtdbg.h>
 
 // STL
 #include <cstdlib>
@@ -70,7 +71,11 @@
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <array>
+#include <random>
 
 // RPC
 #include <Rpc.h>